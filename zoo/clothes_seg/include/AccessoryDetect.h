@@ -22,9 +22,21 @@
 #include "tnn_sdk_sample.h"
 #include "tnn/utils/mat_utils.h"
 #include "tnn/utils/dims_vector_utils.h"
+#include "mask_stabilizer.h"
+#include "mask_buffer.h"
+#include "motion_estimator.h"
 
 namespace TNN_NS {
 
+// class ids of ClassU8 masks
+typedef enum {
+    kAccessoryBackground = 0,
+    kAccessoryHat        = 1,
+    kAccessoryUpper      = 2,
+    kAccessoryLower      = 3,
+    kAccessoryClassNum   = 4,
+} AccessoryClass;
+
 class AccessoryDetectInput : public TNNSDKInput {
 public:
     AccessoryDetectInput(std::shared_ptr<Mat> mat = nullptr) : TNNSDKInput(mat) {};
@@ -46,6 +58,13 @@ public:
     int num_thread = 1;
     // the processing mode of output mask
     int mode = 0;
+    // temporal filter of the mask, the default reproduces the original OFD
+    TNNMaskStabilizerMode ofd_mode = TNNMaskStabilizerMajority;
+    int ofd_window = 3;
+    // run the network every segment_interval frames, the frames in between get the last mask
+    // warped by the motion of the frame
+    int segment_interval = 1;
+    MotionEstimatorOption motion_option;
 };
 
 class AccessoryDetect : public TNN_NS::TNNSDKSample {
@@ -56,26 +75,47 @@ public:
     virtual MatConvertParam GetConvertParamForInput(std::string name = "");
     virtual std::shared_ptr<TNNSDKOutput> CreateSDKOutput();
     virtual Status ProcessSDKOutput(std::shared_ptr<TNNSDKOutput> output);
+    virtual Status Predict(std::shared_ptr<TNNSDKInput> input, std::shared_ptr<TNNSDKOutput> &output);
 
     void setOFDStatus(bool b) {
-        m_enable_ofd = b;
+        stabilizer.SetEnabled(b);
     }
 
-    int* maskData;
+    // drop the mask history, e.g. after a scene cut
+    void resetOFD() {
+        stabilizer.Reset();
+    }
 
-private:
-    u_char* OFD(const int size);
+    // write the mask into caller memory in the given format, a buffer without data falls back to
+    // maskData. the buffer must have the size of the input frame
+    void setMaskBuffer(const MaskBuffer &buffer) {
+        maskBuffer = buffer;
+    }
+
+    // legacy output: full frame ARGB8888, used when no MaskBuffer is set
+    int* maskData = nullptr;
+
+protected:
+    virtual Status ReuseLastOutput(std::shared_ptr<TNNSDKOutput> &output);
+    virtual void ResetTemporalState();
 
 private:
+    MaskBuffer getOutputBuffer() const;
+    // class codes of the model resolution to the caller's mask
+    Status writeMask(u_char *mask, int ow, int oh);
+
+    MaskBuffer maskBuffer;
 
     DimsVector orig_dims;
     //std::shared_ptr<Mat> input_image;
     u_char * rmaskData = nullptr;
-    u_char* p_pre_mask = nullptr;
-    u_char* p_cur_mask = nullptr;
-    u_char* p_next_mask = nullptr;
-
-    bool m_enable_ofd = true;
+    MaskStabilizer stabilizer;
+    std::vector<u_char> lastMask;
+    std::vector<u_char> warpedMask;
+    int lastMaskWidth = 0;
+    int lastMaskHeight = 0;
+    MotionEstimator motion;
+    int framesSinceSegment = 0;
 
     int srcInputWidth = 0;
     int srcInputHeight = 0;
@@ -13,6 +13,7 @@
 // specific language governing permissions and limitations under the License.
 
 #include "AccessoryDetect.h"
+#include "mask_utils.h"
 #include <sys/time.h>
 #include <cmath>
 #include <cstring>
@@ -24,20 +25,6 @@ AccessoryDetect::~AccessoryDetect() {
         free(rmaskData);
         rmaskData = nullptr;
     }
-    if(p_pre_mask!= nullptr){
-        free(p_pre_mask);
-        p_pre_mask = nullptr;
-    }
-
-    if(p_cur_mask!=nullptr){
-        free(p_cur_mask);
-        p_cur_mask = nullptr;
-    }
-
-    if(p_next_mask!=nullptr){
-        free(p_next_mask);
-        p_next_mask = nullptr;
-    }
 }
 
 MatConvertParam AccessoryDetect::GetConvertParamForInput(std::string tag) {
@@ -70,9 +57,10 @@ Status AccessoryDetect::Init(std::shared_ptr<TNNSDKOption> option_i) {
     auto size = sizeof(u_char)* input_dims[2]*input_dims[3];
 
     rmaskData = (u_char*)malloc(size);
-    p_pre_mask = (u_char*)malloc(size);
-    p_cur_mask = (u_char*)malloc(size);
-    p_next_mask = (u_char*)malloc(size);
+    status = stabilizer.Init(input_dims[2] * input_dims[3], option->ofd_mode, option->ofd_window);
+    RETURN_ON_NEQ(status, TNN_OK);
+    motion.SetOption(option->motion_option);
+    framesSinceSegment = 0;
 
     return status;
 }
@@ -81,40 +69,8 @@ std::shared_ptr<TNNSDKOutput> AccessoryDetect::CreateSDKOutput() {
     return std::make_shared<AccessoryDetectOutput>();
 }
 
-u_char* AccessoryDetect::OFD(const int size) {
-    static int count = 0;
-    if(!m_enable_ofd) {
-        count = 0;
-        return p_next_mask;
-    }
-
-    auto f = [=] {
-        auto* temp = p_pre_mask;
-        auto* temp1 = p_cur_mask;
-        p_cur_mask = p_next_mask;
-        p_pre_mask = temp1;
-        p_next_mask = temp;
-    };
-
-    ++count;
-    if(count < 3) {
-        f();
-        return p_cur_mask;
-    }
-
-    for(int i = 0; i < size; ++i) {
-        if(p_pre_mask[i] == p_next_mask[i]) {
-            p_cur_mask[i] = p_next_mask[i];
-        }
-    }
-
-    f();
-    return p_pre_mask;
-
-}
-
 std::shared_ptr<Mat> AccessoryDetect::ProcessSDKInputMat(std::shared_ptr<Mat> input_image, std::string name) {
-    RETURN_VALUE_ON_NEQ(input_image->GetMatType(), N8UC3, nullptr);
+    RETURN_VALUE_ON_NEQ(input_image->GetMatType() == N8UC3 || IsYUV420sp(input_image), true, nullptr);
     this->orig_dims = input_image->GetDims();
     // save input image mat for merging
     auto dims = input_image->GetDims();
@@ -130,17 +86,17 @@ std::shared_ptr<Mat> AccessoryDetect::ProcessSDKInputMat(std::shared_ptr<Mat> in
 
     // 强制resize
     if (target_dims.size() >= 4 && (input_height != target_dims[2] || input_width != target_dims[3])) {
-        auto target_mat = std::make_shared<TNN_NS::Mat>(input_image->GetDeviceType(), input_image->GetMatType(), target_dims);
         scaleX = (float)target_dims[3] / (float) input_width;
         scaleY = (float)target_dims[2] / (float) input_height;
-        auto status = Resize(input_image, target_mat,TNNInterpLinear);
+        MatROI roi;
+        roi.width = input_width;
+        roi.height = input_height;
+        auto target_mat = ResizeFromFrame(input_image, roi, target_dims);
         LOGE("Body Detect Resize to [%d,%d,%d,%d]\n", target_dims[0],target_dims[1],target_dims[2],target_dims[3]);
-        if (status == TNN_OK) {
-            return target_mat;
-        } else {
-            LOGE("Body Detect Resize error:%s\n", status.description().c_str());
-            return nullptr;
+        if (!target_mat) {
+            LOGE("Body Detect Resize error\n");
         }
+        return target_mat;
     }else{
         scaleX = 1;
         scaleY = 1;
@@ -180,70 +136,108 @@ Status AccessoryDetect::ProcessSDKOutput(std::shared_ptr<TNNSDKOutput> output_)
     auto p1=std::chrono::steady_clock::now();
 
     long total = ow * oh;
-    memset(p_next_mask, 0, sizeof(u_char) * total);
-
-    unsigned char color = 0;
-    int bgCount = 0;
-    int hatCount = 0;
-    int upperCount = 0;
-    for (long i = 0; i < total; ++i) {
-        float bgScore = bgData[i];
-        float hatScore = hatData[i];
-        float upperScore = upperData[i];
-        float lowerScore = lowerData[i];
-        if(bgScore >= hatScore && bgScore >= upperScore && bgScore>=lowerScore){
-            color = 0; // bg
-            bgCount++;
-        }else if(hatScore >= bgScore && hatScore >= upperScore && hatScore>=lowerScore){
-            color = 0xff; // hat
-            hatCount ++;
-        }else if(upperScore >= bgScore && upperScore >= hatScore && upperScore>=lowerScore){
-            color = 0xaf; // upperScore
-            upperCount ++;
-        }else{
-            color = 0x5f; // lowerScore
-        }
-        p_next_mask[i] = color;
-    }
-    float bgRate = bgCount/(float)total;
-    float hatRate = hatCount/(float)total;
-    float upRate = upperCount/(float)total;
+    u_char* p_next_mask = stabilizer.GetInputBuffer();
+
+    // codes of background, hat, upper and lower clothes, every byte of the mask is written
+    const float* planes[kAccessoryClassNum] = {bgData, hatData, upperData, lowerData};
+    static const uint8_t codes[kAccessoryClassNum] = {0, 0xff, 0xaf, 0x5f};
+    MaskClassStat stats[kAccessoryClassNum];
+    ArgmaxClasses(planes, kAccessoryClassNum, ow, oh, p_next_mask, codes, stats);
+    float bgRate = stats[kAccessoryBackground].count/(float)total;
+    float hatRate = stats[kAccessoryHat].count/(float)total;
+    float upRate = stats[kAccessoryUpper].count/(float)total;
     LOGE("detect output bg占比:%f hat:%f up:%f down:%f", bgRate, hatRate, upRate, 1.0f -bgRate-hatRate-upRate);
 
-    auto* mask_human = OFD(total);
+    auto* mask_human = const_cast<u_char*>(stabilizer.Process());
+    lastMask.assign(mask_human, mask_human + total);
+    lastMaskWidth = ow;
+    lastMaskHeight = oh;
+
+    status = writeMask(mask_human, ow, oh);
+    auto p2=std::chrono::steady_clock::now();
+    double p_s=std::chrono::duration<double>(p2-p1).count(); //秒
+    LOGE("Postprocess coast:%f",p_s);
+
+    return status;
+}
+
+Status AccessoryDetect::Predict(std::shared_ptr<TNNSDKInput> input, std::shared_ptr<TNNSDKOutput> &output) {
+    auto option = dynamic_cast<AccessoryDetectOption *>(option_.get());
+    if (!option || option->segment_interval <= 1 || !input || input->IsEmpty()) {
+        return TNNSDKSample::Predict(input, output);
+    }
+
+    // the motion needs every frame, segmented or not
+    auto frame = input->GetMat();
+    bool segment = motion.AddFrame(frame) != TNN_OK || lastMask.empty() ||
+                   ++framesSinceSegment >= option->segment_interval || frame->GetWidth() != srcInputWidth ||
+                   frame->GetHeight() != srcInputHeight || motion.Estimate() != TNN_OK;
+    if (segment) {
+        framesSinceSegment = 0;
+        return TNNSDKSample::Predict(input, output);
+    }
+
+    // propagate the last class codes to this frame, the network is skipped
+    output = CreateSDKOutput();
+    MatROI roi;
+    roi.width = srcInputWidth;
+    roi.height = srcInputHeight;
+    warpedMask.resize(lastMask.size());
+    auto status = motion.WarpMask(lastMask.data(), lastMaskWidth, lastMaskHeight, roi, warpedMask.data());
+    RETURN_ON_NEQ(status, TNN_OK);
+    lastMask.swap(warpedMask);
+    return writeMask(lastMask.data(), lastMaskWidth, lastMaskHeight);
+}
 
+Status AccessoryDetect::ReuseLastOutput(std::shared_ptr<TNNSDKOutput> &output) {
+    if (lastMask.empty()) {
+        return Status(TNNERR_COMMON_ERROR, "no mask to reuse");
+    }
+    output = CreateSDKOutput();
+    return writeMask(lastMask.data(), lastMaskWidth, lastMaskHeight);
+}
+
+void AccessoryDetect::ResetTemporalState() {
+    resetOFD();
+    motion.Reset();
+    framesSinceSegment = 0;
+}
+
+Status AccessoryDetect::writeMask(u_char *mask, int ow, int oh) {
+    Status status = TNN_OK;
     TNN_NS::DeviceType dt = TNN_NS::DEVICE_ARM;
     TNN_NS::DimsVector r_dims = {1, 1, oh, ow};
-    auto rMaskSize = std::make_shared<TNN_NS::Mat>(dt, TNN_NS::NGRAY, r_dims, mask_human);
+    auto rMaskSize = std::make_shared<TNN_NS::Mat>(dt, TNN_NS::NGRAY, r_dims, mask);
 
 
     TNN_NS::DimsVector target_dims = {1, 1, orig_dims[2], orig_dims[3]};
     auto target_mat = std::make_shared<TNN_NS::Mat>(dt, TNN_NS::NGRAY, target_dims);
     status = Resize(rMaskSize, target_mat,TNNInterpLinear);
     if(status == TNN_OK){
-        total = orig_dims[2] * orig_dims[3];
-        //LOGE("target_dims h:%d, w:%d total:%d",orig_dims[2],orig_dims[3],total);
+        MaskBuffer buffer = getOutputBuffer();
+        status = buffer.Validate(srcInputWidth, srcInputHeight);
+        RETURN_ON_NEQ(status, TNN_OK);
+        // the interpolated codes back to class ids, then into the caller's format
+        static const uint32_t palette[kAccessoryClassNum] = {0, 0x7f7f0000, 0x7f007f00, 0x7f00007f};
+        long total = orig_dims[2] * orig_dims[3];
         u_char * alpha = (u_char*)target_mat->GetData();
         for (long i = 0; i < total; ++i) {
-            float av = alpha[i];
-            //maskData[i] = (alpha[i]<<16) | 0x7f000000;
-            if(av>0xaf){
-                maskData[i] = 0x7f7f0000;
-            }else if(av > 0x5f){
-                maskData[i] = 0x7f007f00;
-            }else if(av >0){
-                maskData[i] = 0x7f00007f;
-            }
-            // maskData[i] = 0x3fff0000;
+            u_char av = alpha[i];
+            alpha[i] = av > 0xaf ? kAccessoryHat : (av > 0x5f ? kAccessoryUpper : (av > 0 ? kAccessoryLower : 0));
         }
+        status = WriteClassRegion(buffer, 0, 0, alpha, orig_dims[3], orig_dims[2], orig_dims[3], palette,
+                                  kAccessoryClassNum);
     }else{
         LOGE("detect output resize error!");
     }
-    auto p2=std::chrono::steady_clock::now();
-    double p_s=std::chrono::duration<double>(p2-p1).count(); //秒
-    LOGE("Postprocess coast:%f",p_s);
-
     return status;
 }
 
+MaskBuffer AccessoryDetect::getOutputBuffer() const {
+    if (maskBuffer.data) {
+        return maskBuffer;
+    }
+    return MaskBuffer(TNNMaskFormatARGB8888, maskData, srcInputWidth, srcInputHeight);
+}
+
 }
@@ -23,6 +23,12 @@
 #include "tnn_sdk_sample.h"
 #include "tnn/utils/mat_utils.h"
 #include "tnn/utils/dims_vector_utils.h"
+#include "mask_stabilizer.h"
+#include "mask_upsampler.h"
+#include "guided_upsampler.h"
+#include "roi_controller.h"
+#include "mask_buffer.h"
+#include "motion_estimator.h"
 
 namespace TNN_NS {
 
@@ -49,6 +55,59 @@ public:
     int num_thread = 1;
     // the processing mode of output mask
     int mode = 0;
+    // temporal filter of the mask, the default reproduces the original OFD
+    TNNMaskStabilizerMode ofd_mode = TNNMaskStabilizerMajority;
+    int ofd_window = 3;
+    // filter the confidence (ema + hysteresis band around the threshold) instead of the mask
+    bool ofd_confidence = false;
+    float ofd_alpha = 0.5f;
+    float ofd_band = 0.05f;
+    // threads of the mask upsampling, rows are split into bands
+    int upsample_threads = 1;
+    // refine the mask with a guided filter on the luma of the input, keeps the edges sharp
+    // when the model runs at a lower resolution (see TNNSDKOption::input_shapes)
+    bool guided_upsample = false;
+    int guided_radius = 2;
+    float guided_eps = 1e-3f;
+    // crop to a smoothed person roi fed by setPersonBoxes or the bounding box of the last mask,
+    // otherwise the caller sets humRect*
+    bool roi_tracking = false;
+    RoiControllerOption roi_option;
+    // run the network every segment_interval frames, the frames in between get the last mask
+    // warped by the motion of the frame
+    int segment_interval = 1;
+    MotionEstimatorOption motion_option;
+    // re-segment only the tiles of the human rect that changed since they were last segmented,
+    // the network runs on their bounding box plus context at a smaller input shape. that shape
+    // is 1/2, 3/4 or all of the full input per side, the instance reshapes only when it changes
+    bool tile_update = false;
+    // tiles per side of the rect
+    int tile_grid = 4;
+    // mean absolute luma difference of a changed tile
+    float tile_threshold = 4.0f;
+    // context around the changed tiles as a fraction of the tile size
+    float tile_padding = 0.25f;
+    // width of the seam blend in mask pixels
+    int tile_blend = 8;
+    // sizes of the partial input are multiples of tile_align
+    int tile_align = 16;
+    // above this fraction of changed tiles the whole rect is segmented
+    float tile_max_changed = 0.5f;
+};
+
+struct BodyTileStat {
+    int64_t frames = 0;
+    int64_t full = 0;
+    int64_t partial = 0;
+    // no tile changed, the last mask was written again
+    int64_t reused = 0;
+    int64_t tiles_changed = 0;
+    int64_t tiles_total = 0;
+    // network input pixels of the partial runs against full runs in their place
+    int64_t pixels_inferred = 0;
+    int64_t pixels_full = 0;
+    // instance reshapes between the tile shapes and back to the full shape
+    int64_t reshapes = 0;
 };
 
 class BodyDetect : public TNN_NS::TNNSDKSample {
@@ -59,39 +118,112 @@ public:
     virtual MatConvertParam GetConvertParamForInput(std::string name = "");
     virtual std::shared_ptr<TNNSDKOutput> CreateSDKOutput();
     virtual Status ProcessSDKOutput(std::shared_ptr<TNNSDKOutput> output);
+    virtual Status Predict(std::shared_ptr<TNNSDKInput> input, std::shared_ptr<TNNSDKOutput> &output);
 
     void setOFDStatus(bool b) {
-        m_enable_ofd = b;
+        stabilizer.SetEnabled(b);
+        confStabilizer.SetEnabled(b);
+    }
+
+    // drop the mask history, e.g. after a scene cut
+    void resetOFD() {
+        stabilizer.Reset();
+        confStabilizer.Reset();
     }
 
     void setThreshold(float thres) {
         m_thres = thres;
+        auto option = dynamic_cast<BodyDetectOption *>(option_.get());
+        confStabilizer.SetThreshold(1.0f - thres, option ? option->ofd_band : 0.05f);
     }
 
-    int humRectLeft;
-    int humRectTop;
-    int humRectWidth;
-    int humRectHeight;
-    int* maskData;
+    // person boxes of the coming frame in frame coordinates, e.g. from HumanDetect
+    void setPersonBoxes(const std::vector<ObjectInfo> &boxes) {
+        roiController.Update(boxes);
+        personBoxFed = true;
+    }
 
-private:
-    u_char* OFD(const int size);
+    void resetROI() {
+        roiController.Reset();
+    }
+
+    // pixels cropped against the full frames since the last resetROI
+    RoiStat getROIStats() const {
+        return roiController.GetStat();
+    }
+
+    // counters of tile_update
+    BodyTileStat getTileUpdateStats() const {
+        return tileStat;
+    }
+
+    // write the mask into caller memory in the given format, a buffer without data falls back to
+    // maskData. the buffer must have the size of the input frame
+    void setMaskBuffer(const MaskBuffer &buffer) {
+        maskBuffer = buffer;
+    }
+
+    // write the mask of the last frame with a body again, at the human rect of that frame, e.g.
+    // when a scheduler skips the network for this frame
+    Status writeLastMask();
+
+    int humRectLeft = 0;
+    int humRectTop = 0;
+    int humRectWidth = 0;
+    int humRectHeight = 0;
+    // legacy output: full frame ARGB8888, used when no MaskBuffer is set
+    int* maskData = nullptr;
+
+protected:
+    virtual Status ReuseLastOutput(std::shared_ptr<TNNSDKOutput> &output);
+    virtual void ResetTemporalState();
 
-    // float* OFDV1(const int size);
 private:
+    MaskBuffer getOutputBuffer() const;
+    // the network on the frame, tile_update decides between all of the rect and its changed tiles
+    Status segment(std::shared_ptr<TNNSDKInput> input, std::shared_ptr<TNNSDKOutput> &output);
+    // partial is false if the whole rect has to be segmented
+    Status updateTiles(std::shared_ptr<Mat> frame, std::shared_ptr<TNNSDKOutput> &output, bool &partial);
+    // reshapes the instance to the size of region unless it already has it
+    Status reshapeTile(const MatROI &region);
+    // runs the network on region (mask pixels of lastMaskRoi) and blends the result into lastMask
+    Status segmentRegion(std::shared_ptr<Mat> frame, const MatROI &region, std::shared_ptr<TNNSDKOutput> &output);
+    // mask is ow x oh and covers rect of the frame, guided upsampling uses guideImage
+    Status writeMask(const u_char *mask, int ow, int oh, const MatROI &rect, bool guided);
 
     DimsVector orig_dims;
     u_char * rmaskData = NULL;
 
-    u_char* p_pre_mask = nullptr;
-    u_char* p_cur_mask = nullptr;
-    u_char* p_next_mask = nullptr;
-
-    // float* p_pre_conf = nullptr;
-    // float* p_cur_conf = nullptr;
-    // float* p_next_conf = nullptr;
-
-    bool m_enable_ofd = true;
+    MaskStabilizer stabilizer;
+    ConfidenceStabilizer confStabilizer;
+    MaskUpsampler upsampler;
+    GuidedUpsampler guidedUpsampler;
+    std::vector<u_char> lastMask;
+    int lastMaskWidth = 0;
+    int lastMaskHeight = 0;
+    MatROI lastMaskRoi;
+    std::vector<u_char> warpedMask;
+    MotionEstimator motion;
+    int framesSinceSegment = 0;
+    // luma of the frame the tiles were last segmented on and of the current frame
+    std::vector<uint8_t> tileReference;
+    std::vector<uint8_t> tileLuma;
+    int tileLumaFactor = 1;
+    // humRect* as requested for the last full segmentation
+    MatROI tileRequest;
+    DimsVector fullShape;
+    // the input shape of the last partial run, the instance is off fullShape while tileReshaped
+    DimsVector tileShape;
+    bool tileReshaped = false;
+    std::vector<u_char> regionMask;
+    BodyTileStat tileStat;
+    // the (cropped) input frame, guide of the guided upsampling
+    std::shared_ptr<Mat> guideImage;
+    RoiController roiController;
+    MaskBuffer maskBuffer;
+    // roi sized scratch for the formats the upsamplers can not write directly
+    std::vector<uint8_t> roiMask;
+    bool personBoxFed = false;
 
     int srcInputWidth = 0;
     int srcInputHeight = 0;
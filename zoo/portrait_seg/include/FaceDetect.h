@@ -22,6 +22,8 @@
 #include "tnn_sdk_sample.h"
 #include "tnn/utils/mat_utils.h"
 #include "tnn/utils/dims_vector_utils.h"
+#include "PriorBoxCache.h"
+#include "object_tracker.h"
 
 
 namespace TNN_NS {
@@ -38,6 +40,15 @@ public:
     virtual ~FaceDetectOutput() {};
 };
 
+typedef enum {
+    // highest score first
+    FaceRankByScore    = 0,
+    // largest box first
+    FaceRankByArea     = 1,
+    // nearest to the image centre first
+    FaceRankByDistance = 2,
+} FaceRankKey;
+
 class FaceDetectOption : public TNNSDKOption {
 public:
     FaceDetectOption() {}
@@ -47,6 +58,17 @@ public:
     int num_thread = 1;
     // the processing mode of output mask
     int mode = 0;
+    // keep at most max_faces faces ranked by rank_key, <= 0 keeps all of them
+    int max_faces = 3;
+    FaceRankKey rank_key = FaceRankByScore;
+    // run the network every detect_interval frames and serve tracked faces in between,
+    // 1 runs it on every frame and disables the tracker
+    int detect_interval = 1;
+    // force a detection when the weakest track falls below this confidence
+    float min_track_confidence = 0.5f;
+    ObjectTrackerOption tracker_option;
+    // fraction of the person box height searched in roi mode, see FaceDetect::setDetectROI
+    float roi_upper_ratio = 0.6f;
 };
 
 #define hard_nms 1
@@ -65,9 +87,32 @@ typedef struct FaceInfo {
 } FaceInfo;
 
 
+// tiled detection of high resolution still images, see FaceDetect::detectTiled
+struct FaceTileOption {
+    // pyramid levels relative to the full resolution, every level is covered by model sized tiles
+    std::vector<float> scales = {1.0f, 0.5f};
+    // overlap of neighbouring tiles as a fraction of the tile size
+    float overlap = 0.25f;
+    // add one letterboxed pass over the whole image for faces larger than any tile
+    bool full_frame = true;
+};
+
+struct FaceTileStat {
+    float scale = 1.0f;
+    // tile rect in source image coordinates
+    int left = 0;
+    int top = 0;
+    int width = 0;
+    int height = 0;
+    int faces = 0;
+    // preprocess + forward + decode, in ms
+    float time = 0;
+};
+
 class FaceDetect : public TNN_NS::TNNSDKSample {
 public:
 
+    // head squares around the faces: x1..y2 is the whole square, l, t, w, h its part inside the frame
     std::vector<FaceInfo> faceList;
 
     ~FaceDetect();
@@ -76,6 +121,32 @@ public:
     virtual MatConvertParam GetConvertParamForInput(std::string name = "");
     virtual std::shared_ptr<TNNSDKOutput> CreateSDKOutput();
     virtual Status ProcessSDKOutput(std::shared_ptr<TNNSDKOutput> output);
+    virtual Status Predict(std::shared_ptr<TNNSDKInput> input, std::shared_ptr<TNNSDKOutput> &output);
+
+    // drop all tracks, the next Predict runs the network
+    void resetTracker();
+
+    /**
+     * Restrict detection to the upper part of a person box in source image coordinates,
+     * e.g. HumanDetect::cropX/cropY/cropWidth/cropHeight. The roi gets the whole model
+     * input, so small faces keep more pixels. Empty boxes fall back to the full frame.
+     */
+    void setDetectROI(float left, float top, float width, float height);
+    void clearDetectROI();
+
+    /**
+     * Detect faces of a large still image by covering it with overlapping model sized tiles
+     * on every pyramid level of tile_option, the detections of all tiles are merged by nms.
+     * Fills faceList like Predict, per tile timing is available from getTileStats.
+     */
+    Status detectTiled(std::shared_ptr<Mat> image, const FaceTileOption &tile_option = FaceTileOption());
+    const std::vector<FaceTileStat> &getTileStats() const {
+        return tileStats;
+    }
+
+protected:
+    virtual Status ReuseLastOutput(std::shared_ptr<TNNSDKOutput> &output);
+    virtual void ResetTemporalState();
 
 private:
 
@@ -88,16 +159,40 @@ private:
     int dy = 0;
     float scale = 1;
 
+    // person box set by setDetectROI and the offset of the searched roi in the frame
+    float roiLeft = 0;
+    float roiTop = 0;
+    float roiWidth = 0;
+    float roiHeight = 0;
+    int roiX = 0;
+    int roiY = 0;
+    static const int kMinROISize = 16;
+
     int inputWidth = 0;
     int inputHeight = 0;
 
-    std::vector<std::vector<float>> priors = {};
+    // shared with every other detector of the same input shape, see PriorBoxCache.h
+    std::shared_ptr<const PriorBoxTable> priors = nullptr;
 
     int calcPriorWidth = -1;
     int calcPriorHeight = -1;
 
     void calcPriors();
-    void nms(std::vector<FaceInfo> &input, std::vector<FaceInfo> &output, int type);
+    void nms(std::vector<FaceInfo> &input, std::vector<FaceInfo> &output, int type, int max_output = -1);
+    // (cx, cy) is the image centre in the coordinates of faces
+    void rankFaces(std::vector<FaceInfo> &faces, FaceRankKey key, int max_faces, float cx, float cy);
+    void decodeFaces(FaceDetectOutput *output, std::vector<FaceInfo> &bbox_collection);
+    Status buildFaceList(const std::vector<FaceInfo> &infoList);
+    ObjectInfo faceToObject(const FaceInfo &face);
+    FaceInfo objectToFace(const ObjectInfo &object);
+    void trackedFaces(const std::vector<ObjectInfo> &objects, std::vector<FaceInfo> &infoList);
+
+    // detect in the roi of image and append the faces in image coordinates
+    Status detectTile(std::shared_ptr<Mat> image, const MatROI &roi, std::vector<FaceInfo> &faces);
+
+    ObjectTracker tracker;
+    int framesSinceDetect = 0;
+    std::vector<FaceTileStat> tileStats;
 
     const float score_threshold = 0.7;
     const float iou_threshold = 0.3;
@@ -23,6 +23,9 @@
 #include "tnn/utils/mat_utils.h"
 #include "tnn/utils/dims_vector_utils.h"
 #include "FaceDetect.h"
+#include "mask_buffer.h"
+#include "mask_upsampler.h"
+#include "affine_utils.h"
 
 namespace TNN_NS {
 
@@ -52,12 +55,18 @@ public:
 };
 
 
+/**
+ * Head segmentation of the faces in faceList. The input is the full frame, every face gets its
+ * own batch slot warped from the head square, the masks are mapped back with the inverse warp.
+ * Predict runs the model once per HEAD_INPUT_BATCH faces until every face is composited.
+ */
 class HeadDetect : public TNN_NS::TNNSDKSample {
 public:
 
     int srcInputWidth = 0; // 最初的输入大小
     int srcInputHeight = 0;
-    int* maskData;
+    // legacy output: full frame ARGB8888, used when no MaskBuffer is set
+    int* maskData = nullptr;
     bool isDetectedBody = false;
     std::vector<tnn::FaceInfo> faceList;
 
@@ -70,8 +79,32 @@ public:
     virtual MatConvertParam GetConvertParamForInput(std::string name = "");
     virtual std::shared_ptr<TNNSDKOutput> CreateSDKOutput();
     virtual Status ProcessSDKOutput(std::shared_ptr<TNNSDKOutput> output);
+    virtual Status Predict(std::shared_ptr<TNNSDKInput> input, std::shared_ptr<TNNSDKOutput> &output);
+
+    // write the mask into caller memory in the given format, a buffer without data falls back to
+    // maskData. heads are class kHeadClassId in ClassU8 masks
+    void setMaskBuffer(const MaskBuffer &buffer) {
+        maskBuffer = buffer;
+    }
+
+    static const uint8_t kHeadClassId = 2;
 
 private:
+    MaskBuffer getOutputBuffer() const;
+
+    MaskBuffer maskBuffer;
+    MaskUpsampler upsampler;
+
+    // the head square to model input transform of one batch slot and its inverse
+    struct HeadWarp {
+        float transform[2][3];
+        float inverse[2][3];
+    };
+    std::vector<HeadWarp> headWarps;
+    // index in faceList of the first face of the current run
+    int faceOffset = 0;
+    bool maskCleared = false;
+    std::shared_ptr<Mat> headInput = nullptr;
 
 
     DimsVector orig_dims;
@@ -22,6 +22,7 @@
 #include "tnn_sdk_sample.h"
 #include "tnn/utils/mat_utils.h"
 #include "tnn/utils/dims_vector_utils.h"
+#include "heatmap_decoder.h"
 
 
 namespace TNN_NS {
@@ -49,11 +50,19 @@ public:
     int num_thread = 1;
     // the processing mode of output mask
     int mode = 0;
+    // output blobs of the centre heatmap, the centre offset and the box size, see ProcessSDKOutput
+    std::string heatmap_name = "739";
+    std::string offset_name = "743";
+    std::string size_name = "747";
+    float score_threshold = 0.5f;
+    // at most max_humans people per frame, strongest first
+    int max_humans = 5;
 };
 
 
 class HumanDetect : public TNN_NS::TNNSDKSample {
 public:
+    // the square crop around the strongest person, empty if nobody was found
     float cropX = 0;
     float cropY = 0;
     float cropWidth = 0;
@@ -65,6 +74,9 @@ public:
     int modelInputWidth = 0;
     int modelInputHeight = 0;
 
+    // square crops around all people found in the frame, strongest first
+    std::vector<ObjectInfo> humanList;
+
     ~HumanDetect();
     virtual Status Init(std::shared_ptr<TNNSDKOption> option);
     virtual std::shared_ptr<Mat> ProcessSDKInputMat(std::shared_ptr<Mat> mat, std::string name = kTNNSDKDefaultName);
@@ -72,6 +84,9 @@ public:
     virtual std::shared_ptr<TNNSDKOutput> CreateSDKOutput();
     virtual Status ProcessSDKOutput(std::shared_ptr<TNNSDKOutput> output);
 
+protected:
+    virtual Status ReuseLastOutput(std::shared_ptr<TNNSDKOutput> &output);
+
 private:
 
     DimsVector orig_dims;
@@ -83,6 +98,9 @@ private:
 
     int inputWidth = 0;
     int inputHeight = 0;
+
+    // the heatmap channels merged into one person plane
+    std::vector<float> personHeatmap;
 };
 
 }
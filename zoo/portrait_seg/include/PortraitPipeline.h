@@ -0,0 +1,80 @@
+// Tencent is pleased to support the open source community by making TNN available.
+//
+// Copyright (C) 2020 THL A29 Limited, a Tencent company. All rights reserved.
+//
+// Licensed under the BSD 3-Clause License (the "License"); you may not use this file except
+// in compliance with the License. You may obtain a copy of the License at
+//
+// https://opensource.org/licenses/BSD-3-Clause
+//
+// Unless required by applicable law or agreed to in writing, software distributed
+// under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+// CONDITIONS OF ANY KIND, either express or implied. See the License for the
+// specific language governing permissions and limitations under the License.
+
+
+#ifndef TNN_PORTRAIT_PIPELINE_H_
+#define TNN_PORTRAIT_PIPELINE_H_
+
+#include <memory>
+#include <vector>
+#include "tnn_sdk_sample.h"
+#include "frame_pyramid.h"
+#include "frame_scheduler.h"
+#include "mask_buffer.h"
+#include "HumanDetect.h"
+#include "BodyDetect.h"
+#include "FaceDetect.h"
+#include "HeadDetect.h"
+
+namespace TNN_NS {
+
+/**
+ * The portrait cascade as a stage graph: human -> body and face -> head. Face detection does
+ * not wait for the people, body and head run concurrently with the other branch when
+ * SetNumThreads allows it, head only orders itself after body since both write the mask.
+ * All detectors share one FramePyramid so the frame is resized once per size.
+ *
+ * With a FrameScheduler human, face and body are reusable stages: a skipped human or face stage
+ * keeps its last boxes (FaceDetect tracks them on its own), a skipped body stage writes its
+ * last mask again. A dropped frame leaves the mask buffer as it is, see isFrameDropped.
+ */
+class PortraitPipeline : public TNNSDKComposeSample {
+public:
+    virtual ~PortraitPipeline() {}
+    Status Init(std::shared_ptr<HumanDetect> human, std::shared_ptr<BodyDetect> body,
+                std::shared_ptr<FaceDetect> face, std::shared_ptr<HeadDetect> head);
+    // the mask of body and head, see BodyDetect::setMaskBuffer
+    void setMaskBuffer(const MaskBuffer &buffer);
+    virtual Status Predict(std::shared_ptr<TNNSDKInput> input, std::shared_ptr<TNNSDKOutput> &output);
+
+    // after Init, stages "human", "body", "face" and "head", nullptr runs every stage on every frame
+    Status setScheduler(std::shared_ptr<FrameScheduler> scheduler);
+    std::shared_ptr<FrameScheduler> getScheduler() const {
+        return scheduler;
+    }
+    // the scheduler dropped the last frame passed to Predict
+    bool isFrameDropped() const {
+        return frameDropped;
+    }
+
+    FramePyramidStat getPyramidStats() const {
+        return pyramid ? pyramid->GetStat() : FramePyramidStat();
+    }
+
+private:
+    bool shouldRun(const std::string &stage) const;
+
+    std::shared_ptr<HumanDetect> human;
+    std::shared_ptr<BodyDetect> body;
+    std::shared_ptr<FaceDetect> face;
+    std::shared_ptr<HeadDetect> head;
+    std::shared_ptr<FramePyramid> pyramid;
+    std::shared_ptr<FrameScheduler> scheduler;
+    MaskBuffer maskBuffer;
+    bool bodyFound = false;
+    bool frameDropped = false;
+};
+
+}
+#endif //TNN_PORTRAIT_PIPELINE_H_
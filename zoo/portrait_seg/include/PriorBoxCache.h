@@ -0,0 +1,77 @@
+// Tencent is pleased to support the open source community by making TNN available.
+//
+// Copyright (C) 2020 THL A29 Limited, a Tencent company. All rights reserved.
+//
+// Licensed under the BSD 3-Clause License (the "License"); you may not use this file except
+// in compliance with the License. You may obtain a copy of the License at
+//
+// https://opensource.org/licenses/BSD-3-Clause
+//
+// Unless required by applicable law or agreed to in writing, software distributed
+// under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+// CONDITIONS OF ANY KIND, either express or implied. See the License for the
+// specific language governing permissions and limitations under the License.
+
+#ifndef TNN_PRIOR_BOX_CACHE_H_
+#define TNN_PRIOR_BOX_CACHE_H_
+
+#include <memory>
+#include <vector>
+#include "tnn/core/macro.h"
+
+namespace TNN_NS {
+
+// one ssd anchor, all values are normalized to [0, 1]
+struct PriorBox {
+    float cx;
+    float cy;
+    float w;
+    float h;
+};
+
+// anchor generation parameters, min_boxes[i] are the anchor sizes of the i-th feature map
+struct PriorBoxSpec {
+    int input_width  = 0;
+    int input_height = 0;
+    std::vector<float> strides = {};
+    std::vector<std::vector<float>> min_boxes = {};
+
+    bool operator<(const PriorBoxSpec &other) const;
+};
+
+// immutable anchor table, either backed by a compile-time array or by its own storage
+class PriorBoxTable {
+public:
+    PriorBoxTable(const PriorBox *boxes, size_t count) : boxes_(boxes), count_(count) {}
+    explicit PriorBoxTable(std::vector<PriorBox> boxes)
+        : storage_(std::move(boxes)), boxes_(storage_.data()), count_(storage_.size()) {}
+
+    const PriorBox &operator[](size_t i) const {
+        return boxes_[i];
+    }
+    size_t size() const {
+        return count_;
+    }
+
+private:
+    PriorBoxTable(const PriorBoxTable &) = delete;
+    PriorBoxTable &operator=(const PriorBoxTable &) = delete;
+
+    std::vector<PriorBox> storage_ = {};
+    const PriorBox *boxes_ = nullptr;
+    size_t count_ = 0;
+};
+
+// the anchor layout of the ultra-light face detector (RFB / slim)
+PriorBoxSpec UltraFacePriorBoxSpec(int input_width, int input_height);
+
+/**
+ * Process-wide anchor cache. Tables are generated once per spec and shared by every caller,
+ * the shapes shipped with the face model are served from tables built at compile time.
+ * Thread safe.
+ */
+std::shared_ptr<const PriorBoxTable> GetPriorBoxTable(const PriorBoxSpec &spec);
+
+}  // namespace TNN_NS
+
+#endif  // TNN_PRIOR_BOX_CACHE_H_
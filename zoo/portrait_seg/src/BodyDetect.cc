@@ -13,10 +13,12 @@
 // specific language governing permissions and limitations under the License.
 
 #include "BodyDetect.h"
+#include "mask_utils.h"
 #include <sys/time.h>
 #include <cmath>
 #include <cstring>
 #include <chrono>
+#include <climits>
 
 
 namespace TNN_NS {
@@ -26,36 +28,6 @@ BodyDetect::~BodyDetect() {
         free(rmaskData);
         rmaskData = nullptr;
     }
-
-    if(p_pre_mask!= nullptr){
-        free(p_pre_mask);
-        p_pre_mask = nullptr;
-    }
-
-    if(p_cur_mask!=nullptr){
-        free(p_cur_mask);
-        p_cur_mask = nullptr;
-    }
-
-    if(p_next_mask!=nullptr){
-        free(p_next_mask);
-        p_next_mask = nullptr;
-    }
-
-    // if(p_pre_conf!= nullptr){
-    //     free(p_pre_conf);
-    //     p_pre_conf = nullptr;
-    // }
-
-    // if(p_cur_conf!=nullptr){
-    //     free(p_cur_conf);
-    //     p_cur_conf = nullptr;
-    // }
-
-    // if(p_next_conf!=nullptr){
-    //     free(p_next_conf);
-    //     p_next_conf = nullptr;
-    // }
 }
 
 MatConvertParam BodyDetect::GetConvertParamForInput(std::string tag) {
@@ -82,14 +54,13 @@ Status BodyDetect::Init(std::shared_ptr<TNNSDKOption> option_i) {
     LOGE("input w:%d, h:%d",input_dims[2], input_dims[3]);
     auto size = sizeof(u_char)* input_dims[2]*input_dims[3];
     rmaskData = (u_char*)malloc(size);
-    p_pre_mask = (u_char*)malloc(size);
-    p_cur_mask = (u_char*)malloc(size);
-    p_next_mask = (u_char*)malloc(size);
-
-    // size = sizeof(float) * input_dims[2] * input_dims[3];
-    // p_pre_conf = (float*)malloc(size);
-    // p_cur_conf = (float*)malloc(size);
-    // p_next_conf = (float*)malloc(size);
+    status = stabilizer.Init(input_dims[2] * input_dims[3], option->ofd_mode, option->ofd_window);
+    RETURN_ON_NEQ(status, TNN_OK);
+    // the model outputs the background probability, foreground confidence is 1 - output
+    status = confStabilizer.Init(input_dims[2] * input_dims[3], option->ofd_alpha, 1.0f - m_thres, option->ofd_band);
+    RETURN_ON_NEQ(status, TNN_OK);
+    motion.SetOption(option->motion_option);
+    framesSinceSegment = 0;
 
     return status;
 }
@@ -99,7 +70,7 @@ std::shared_ptr<TNNSDKOutput> BodyDetect::CreateSDKOutput() {
 }
 
 std::shared_ptr<Mat> BodyDetect::ProcessSDKInputMat(std::shared_ptr<Mat> input_image, std::string name) {
-    RETURN_VALUE_ON_NEQ(input_image->GetMatType(), N8UC3, nullptr);
+    RETURN_VALUE_ON_NEQ(input_image->GetMatType() == N8UC3 || IsYUV420sp(input_image), true, nullptr);
     this->orig_dims = input_image->GetDims();
     // save input image mat for merging
     auto dims = input_image->GetDims();
@@ -113,35 +84,61 @@ std::shared_ptr<Mat> BodyDetect::ProcessSDKInputMat(std::shared_ptr<Mat> input_i
     srcInputWidth = input_width;
     srcInputHeight = input_height;
 
-    if(fabs(input_width - humRectWidth)>5 || fabs(input_height - humRectHeight)>5){
-        LOGE("Crop input image to detect human rect!");
-        TNN_NS::DimsVector crop_dims = {1, dims[1], humRectHeight, humRectWidth}; // 转成3通道的
-        auto crop_mat = std::make_shared<TNN_NS::Mat>(input_image->GetDeviceType(), input_image->GetMatType(), crop_dims);
-        Crop(input_image, crop_mat, humRectLeft, humRectTop);
-        input_image = crop_mat;
-        input_width = humRectWidth;
-        input_height = humRectHeight;
-        this->orig_dims[2] = humRectHeight;
-        this->orig_dims[3] = humRectWidth;
-    }else{ // 微小差距就不调节了
+    auto option = dynamic_cast<BodyDetectOption *>(option_.get());
+    if (option && option->roi_tracking) {
+        roiController.SetOption(option->roi_option);
+        roiController.SetFrameSize(input_width, input_height);
+        if (target_dims.size() >= 4) {
+            roiController.SetSnapSize(target_dims[3], target_dims[2]);
+        }
+        roiController.GetRoi(humRectLeft, humRectTop, humRectWidth, humRectHeight);
+    }
+
+    bool validRect = humRectWidth > 0 && humRectHeight > 0 && humRectLeft >= 0 && humRectTop >= 0 &&
+                     humRectLeft + humRectWidth <= input_width && humRectTop + humRectHeight <= input_height;
+    bool cropRect = validRect && (fabs(input_width - humRectWidth)>5 || fabs(input_height - humRectHeight)>5);
+    if(!cropRect){ // 微小差距就不调节了
         humRectTop = 0;
         humRectLeft = 0;
         humRectWidth = srcInputWidth;
         humRectHeight = srcInputHeight;
     }
+    this->orig_dims[2] = humRectHeight;
+    this->orig_dims[3] = humRectWidth;
+    bool resize = target_dims.size() >= 4 && (humRectHeight != target_dims[2] || humRectWidth != target_dims[3]);
 
-    // 强制Resize到256*256
-    if (target_dims.size() >= 4 && (input_height != target_dims[2] || input_width != target_dims[3])) {
-        auto target_mat = std::make_shared<TNN_NS::Mat>(input_image->GetDeviceType(), input_image->GetMatType(), target_dims);
-        scaleX = (float)target_dims[3] / (float) input_width;
-        scaleY = (float)target_dims[2] / (float) input_height;
-        auto status = Resize(input_image, target_mat,TNNInterpLinear);
-        if (status == TNN_OK) {
-            return target_mat;
-        } else {
-            LOGE("Body Detect Resize error:%s\n", status.description().c_str());
+    // the guided filter needs the human rect at full resolution, otherwise crop and resize are one pass
+    if (cropRect && (!resize || (option && option->guided_upsample))) {
+        LOGE("Crop input image to detect human rect!");
+        TNN_NS::DimsVector crop_dims = {1, 3, humRectHeight, humRectWidth}; // 转成3通道的
+        // Crop converts camera frames to N8UC3 while it samples them
+        auto crop_type = IsYUV420sp(input_image) ? N8UC3 : input_image->GetMatType();
+        auto crop_mat = std::make_shared<TNN_NS::Mat>(input_image->GetDeviceType(), crop_type, crop_dims);
+        auto status = Crop(input_image, crop_mat, humRectLeft, humRectTop);
+        if (status != TNN_OK) {
+            LOGE("BodyDetect crop error:%s\n", status.description().c_str());
             return nullptr;
         }
+        input_image = crop_mat;
+        cropRect = false;
+    }
+    guideImage = input_image;
+
+    // 强制Resize到256*256
+    if (resize) {
+        scaleX = (float)target_dims[3] / (float) humRectWidth;
+        scaleY = (float)target_dims[2] / (float) humRectHeight;
+        // the human rect of the frame, or all of the already cropped image
+        MatROI roi;
+        roi.left = cropRect ? humRectLeft : 0;
+        roi.top = cropRect ? humRectTop : 0;
+        roi.width = humRectWidth;
+        roi.height = humRectHeight;
+        auto target_mat = ResizeFromFrame(input_image, roi, target_dims);
+        if (!target_mat) {
+            LOGE("Body Detect Resize error\n");
+        }
+        return target_mat;
     }else{
         scaleX = 1;
         scaleY = 1;
@@ -149,93 +146,6 @@ std::shared_ptr<Mat> BodyDetect::ProcessSDKInputMat(std::shared_ptr<Mat> input_i
     return input_image;
 }
 
-u_char* BodyDetect::OFD(const int size) {
-    static int count = 0;
-    if(!m_enable_ofd) {
-        count = 0;
-        return p_next_mask;
-    }
-
-    auto f = [=] {
-        auto* temp = p_pre_mask;
-        auto* temp1 = p_cur_mask;
-        p_cur_mask = p_next_mask;
-        p_pre_mask = temp1;
-        p_next_mask = temp;
-    };
-
-    ++count;
-    if(count < 3) {
-        f();
-        return p_cur_mask;
-    }
-
-    for(int i = 0; i < size; ++i) {
-        if(p_pre_mask[i] == p_next_mask[i]) {
-            p_cur_mask[i] = p_next_mask[i];
-        }
-    }
-
-    f();
-    return p_pre_mask;
-}
-
-// float* BodyDetect::OFDV1(const int size) {
-//     static int count = 0;
-//     if(!m_enable_ofd) {
-//         count = 0;
-//         return p_next_conf;
-//     }
-
-//     auto f = [=] {
-//         auto* temp = p_pre_conf;
-//         auto* temp1 = p_cur_conf;
-//         p_cur_conf = p_next_conf;
-//         p_pre_conf = temp1;
-//         p_next_conf = temp;
-//     };
-
-//     ++count;
-//     if(count < 3) {
-//         f();
-//         return p_cur_conf;
-//     }
-
-//     for(int i = 0; i < size; ++i) {
-//         if((p_pre_conf[i] >= m_thres && p_next_conf[i] < m_thres) || (p_pre_conf[i] < m_thres && p_next_conf[i] >= m_thres)) {
-//             continue;
-//         }
-
-//         auto mean = (p_pre_conf[i] + p_next_conf[i]) / 2.f;
-//         // if(p_pre_mask[i] == p_next_mask[i]) {
-//         //     p_cur_mask[i] = p_next_mask[i];
-//         // }
-
-//         if((mean >= m_thres && p_cur_conf[i] >= m_thres) || (mean < m_thres && p_cur_conf[i] < m_thres)) {
-//             continue;
-//         }
-
-//         auto cur = p_cur_conf[i];
-//         if(mean >= m_thres && cur < m_thres) {
-//             auto neg = 1 - m_thres;
-//             if(mean > neg) {
-//                 p_cur_conf[i] = mean;
-//             }
-//         }
-
-//         if(mean < m_thres && cur >= m_thres) {
-//             auto neg = 1 - mean;
-//             if(neg > cur) {
-//                 p_cur_conf[i] = mean;
-//             }
-//         }
-
-//     }
-
-//     f();
-//     return p_pre_conf;
-// }
-
 Status BodyDetect::ProcessSDKOutput(std::shared_ptr<TNNSDKOutput> output_) {
     Status status = TNN_OK;
     auto option = dynamic_cast<BodyDetectOption *>(option_.get());
@@ -252,44 +162,384 @@ Status BodyDetect::ProcessSDKOutput(std::shared_ptr<TNNSDKOutput> output_) {
     LOGE("output w:%d, h:%d", ow, oh);
 
     bool hasFound = false;
-    memset(p_next_mask, 0, sizeof(u_char) * total);
-    for (int i = 0; i < total; ++i) {
-        if (outData[i] < m_thres) { // 阈值
-            hasFound = true;
-            p_next_mask[i] = 0xff;// alpha
+    u_char* mask_human = nullptr;
+    if (option->ofd_confidence) {
+        size_t foreground = 0;
+        confStabilizer.Quantize(outData, true);
+        mask_human = const_cast<u_char*>(confStabilizer.Process(&foreground));
+        hasFound = foreground > 0;
+    } else {
+        // the output is the background probability, foreground below the threshold
+        hasFound = ThresholdToMask(outData, total, m_thres, true, stabilizer.GetInputBuffer()) > 0;
+        mask_human = const_cast<u_char*>(stabilizer.Process());
+    }
+
+    LOGE("isFound human:%d",hasFound?1:0);
+    if (option->roi_tracking && !personBoxFed) {
+        // without external boxes the mask of this frame positions the roi of the next one
+        int x1, y1, x2, y2;
+        if (hasFound && MaskBoundingBox(mask_human, ow, oh, ow, x1, y1, x2, y2)) {
+            ObjectInfo box;
+            box.x1 = humRectLeft + x1 * (float)humRectWidth / ow;
+            box.y1 = humRectTop + y1 * (float)humRectHeight / oh;
+            box.x2 = humRectLeft + x2 * (float)humRectWidth / ow;
+            box.y2 = humRectTop + y2 * (float)humRectHeight / oh;
+            roiController.Update({box});
+        } else {
+            roiController.Lost();
         }
     }
+    personBoxFed = false;
 
-    auto* mask_human = OFD(total);
+    if (!hasFound) {
+        lastMask.clear();
+        return Status(TNNERR_NO_RESULT, "Not Found Body!");
+    }
+    lastMask.assign(mask_human, mask_human + total);
+    lastMaskWidth = ow;
+    lastMaskHeight = oh;
+    lastMaskRoi.left = humRectLeft;
+    lastMaskRoi.top = humRectTop;
+    lastMaskRoi.width = orig_dims[3];
+    lastMaskRoi.height = orig_dims[2];
+
+    // the smoothed confidence carries more edge information than the binary mask
+    const u_char *conf = option->ofd_confidence ? confStabilizer.GetConfidence() : mask_human;
+    bool guided = option->guided_upsample && guideImage && guideImage->GetMatType() == N8UC3 &&
+                  guideImage->GetHeight() == orig_dims[2] && guideImage->GetWidth() == orig_dims[3];
+    status = writeMask(guided ? conf : mask_human, ow, oh, lastMaskRoi, guided);
+    guideImage = nullptr;
+    return status;
+}
 
-    LOGE("isFound human:%d",hasFound?1:0);
-    if (hasFound) {
-        // 强制Resize到输入的大小
-        TNN_NS::DeviceType dt = TNN_NS::DEVICE_ARM;
-        TNN_NS::DimsVector r_dims = {1, 1, oh, ow}; // 转成3通道的
-        auto rMaskSize = std::make_shared<TNN_NS::Mat>(dt, TNN_NS::NGRAY, r_dims, mask_human);
-
-        TNN_NS::DimsVector target_dims = {1, 1, orig_dims[2], orig_dims[3]}; // 转成3通道的
-        auto target_mat = std::make_shared<TNN_NS::Mat>(dt, TNN_NS::NGRAY, target_dims);
-        auto status = Resize(rMaskSize, target_mat, TNNInterpLinear);
-        if (status == TNN_OK) {
-            total = orig_dims[2] * orig_dims[3];
-            int height = orig_dims[2];
-            int width = orig_dims[3];
-            u_char *alpha = (u_char *) target_mat->GetData();
-            for (int j = 0; j < height; ++j) {
-                for (int i = 0; i < width; ++i) {
-                    int index = (j + humRectTop) * srcInputWidth + (i + humRectLeft);
-                    maskData[index] = (alpha[j * width + i] << 24) | 0xffffff;
-                }
+Status BodyDetect::Predict(std::shared_ptr<TNNSDKInput> input, std::shared_ptr<TNNSDKOutput> &output) {
+    auto option = dynamic_cast<BodyDetectOption *>(option_.get());
+    if (!option || !input || input->IsEmpty()) {
+        return TNNSDKSample::Predict(input, output);
+    }
+    if (option->segment_interval <= 1) {
+        return segment(input, output);
+    }
+
+    // the motion needs every frame, segmented or not
+    auto frame = input->GetMat();
+    bool segment = motion.AddFrame(frame) != TNN_OK || lastMask.empty() ||
+                   ++framesSinceSegment >= option->segment_interval || frame->GetWidth() != srcInputWidth ||
+                   frame->GetHeight() != srcInputHeight || motion.Estimate() != TNN_OK;
+    if (segment) {
+        framesSinceSegment = 0;
+        return this->segment(input, output);
+    }
+
+    // propagate the last mask to this frame, the network is skipped
+    output = CreateSDKOutput();
+    warpedMask.resize(lastMask.size());
+    auto status = motion.WarpMask(lastMask.data(), lastMaskWidth, lastMaskHeight, lastMaskRoi, warpedMask.data());
+    RETURN_ON_NEQ(status, TNN_OK);
+    lastMask.swap(warpedMask);
+    return writeLastMask();
+}
+
+Status BodyDetect::segment(std::shared_ptr<TNNSDKInput> input, std::shared_ptr<TNNSDKOutput> &output) {
+    auto option = dynamic_cast<BodyDetectOption *>(option_.get());
+    if (!option || !option->tile_update) {
+        return TNNSDKSample::Predict(input, output);
+    }
+
+    bool partial = false;
+    auto frame = input->GetMat();
+    auto status = updateTiles(frame, output, partial);
+    if (partial) {
+        return status;
+    }
+
+    if (tileReshaped) {
+        status = instance_->Reshape({{GetInputNames()[0], fullShape}});
+        RETURN_ON_NEQ(status, TNN_OK);
+        tileReshaped = false;
+        tileShape.clear();
+        tileStat.reshapes++;
+    }
+    tileRequest.left = humRectLeft;
+    tileRequest.top = humRectTop;
+    tileRequest.width = humRectWidth;
+    tileRequest.height = humRectHeight;
+    tileStat.full++;
+    status = TNNSDKSample::Predict(input, output);
+    // every tile is fresh now
+    tileReference.swap(tileLuma);
+    return status;
+}
+
+Status BodyDetect::updateTiles(std::shared_ptr<Mat> frame, std::shared_ptr<TNNSDKOutput> &output, bool &partial) {
+    auto option = dynamic_cast<BodyDetectOption *>(option_.get());
+    partial = false;
+    tileStat.frames++;
+    int lw = 0, lh = 0;
+    tileLumaFactor = std::max(1, frame->GetWidth() / 160);
+    if (DownsampleLuma(frame, tileLumaFactor, tileLuma, lw, lh) != TNN_OK) {
+        tileLuma.clear();
+        return TNN_OK;
+    }
+    auto sameRect = [&](const MatROI &rect) {
+        return humRectLeft == rect.left && humRectTop == rect.top && humRectWidth == rect.width &&
+               humRectHeight == rect.height;
+    };
+    if (lastMask.empty() || tileReference.size() != tileLuma.size() || frame->GetWidth() != srcInputWidth ||
+        frame->GetHeight() != srcInputHeight || !(sameRect(tileRequest) || sameRect(lastMaskRoi))) {
+        return TNN_OK;
+    }
+
+    // a tile is a 1 / grid of the rect, in luma pixels for the difference and in mask pixels for the merge
+    const int grid = std::max(option->tile_grid, 1);
+    const MatROI &roi = lastMaskRoi;
+    auto luma_rect = [&](int t, MatROI &rect) {
+        int tx = t % grid, ty = t / grid;
+        int x1 = (roi.left + tx * roi.width / grid) / tileLumaFactor;
+        int y1 = (roi.top + ty * roi.height / grid) / tileLumaFactor;
+        int x2 = std::min((roi.left + (tx + 1) * roi.width / grid) / tileLumaFactor, lw);
+        int y2 = std::min((roi.top + (ty + 1) * roi.height / grid) / tileLumaFactor, lh);
+        rect.left = x1;
+        rect.top = y1;
+        rect.width = x2 - x1;
+        rect.height = y2 - y1;
+        return rect.width > 0 && rect.height > 0;
+    };
+    std::vector<int> changed;
+    for (int t = 0; t < grid * grid; ++t) {
+        MatROI rect;
+        if (!luma_rect(t, rect)) {
+            continue;
+        }
+        size_t offset = static_cast<size_t>(rect.top) * lw + rect.left;
+        uint32_t sad = BlockSad(tileLuma.data() + offset, lw, tileReference.data() + offset, lw, rect.width,
+                                rect.height);
+        if (sad > option->tile_threshold * rect.width * rect.height) {
+            changed.push_back(t);
+        }
+    }
+    tileStat.tiles_total += grid * grid;
+    tileStat.tiles_changed += changed.size();
+    if (changed.size() > option->tile_max_changed * grid * grid) {
+        return TNN_OK;
+    }
+    if (changed.empty()) {
+        partial = true;
+        tileStat.reused++;
+        output = CreateSDKOutput();
+        return writeLastMask();
+    }
+
+    // bounding box of the changed tiles in mask pixels plus context, grown to one of the few tile
+    // shapes: every new input shape costs the instance a reshape
+    const int ow = lastMaskWidth, oh = lastMaskHeight;
+    int x1 = ow, y1 = oh, x2 = 0, y2 = 0;
+    for (int t : changed) {
+        int tx = t % grid, ty = t / grid;
+        x1 = std::min(x1, tx * ow / grid);
+        y1 = std::min(y1, ty * oh / grid);
+        x2 = std::max(x2, (tx + 1) * ow / grid);
+        y2 = std::max(y2, (ty + 1) * oh / grid);
+    }
+    const int pad_x = static_cast<int>(option->tile_padding * ow / grid);
+    const int pad_y = static_cast<int>(option->tile_padding * oh / grid);
+    const int align = std::max(option->tile_align, 1);
+    auto tile_size = [&](int needed, int full) {
+        for (int quarters = 2; quarters <= 3; ++quarters) {
+            int size = std::min(full, (full * quarters / 4 + align - 1) / align * align);
+            if (size >= needed) {
+                return size;
             }
-        } else {
-            return Status(TNNERR_NO_RESULT, "Not Found Body! Resize Failure!");
         }
-    } else {
+        return full;
+    };
+    MatROI region;
+    region.width = tile_size(x2 - x1 + 2 * pad_x, ow);
+    region.height = tile_size(y2 - y1 + 2 * pad_y, oh);
+    region.left = std::max(0, std::min(x1 - pad_x, ow - region.width));
+    region.top = std::max(0, std::min(y1 - pad_y, oh - region.height));
+    if (region.width >= ow && region.height >= oh) {
+        return TNN_OK;
+    }
+
+    auto status = reshapeTile(region);
+    if (status != TNN_OK) {
+        LOGE("Body tile reshape error:%s, segment the whole rect\n", status.description().c_str());
+        return TNN_OK;
+    }
+    partial = true;
+    tileStat.partial++;
+    tileStat.pixels_inferred += region.width * region.height;
+    tileStat.pixels_full += ow * oh;
+    status = segmentRegion(frame, region, output);
+    RETURN_ON_NEQ(status, TNN_OK);
+
+    // the re-segmented tiles are the new reference, the others keep accumulating their drift
+    for (int t : changed) {
+        MatROI rect;
+        luma_rect(t, rect);
+        for (int y = rect.top; y < rect.top + rect.height; ++y) {
+            size_t offset = static_cast<size_t>(y) * lw + rect.left;
+            memcpy(tileReference.data() + offset, tileLuma.data() + offset, rect.width);
+        }
+    }
+
+    int bx1, by1, bx2, by2;
+    if (!MaskBoundingBox(lastMask.data(), ow, oh, ow, bx1, by1, bx2, by2)) {
+        lastMask.clear();
         return Status(TNNERR_NO_RESULT, "Not Found Body!");
     }
+    return writeLastMask();
+}
+
+Status BodyDetect::reshapeTile(const MatROI &region) {
+    auto input_name = GetInputNames()[0];
+    if (!tileReshaped) {
+        fullShape = GetInputShape(input_name);
+    }
+    DimsVector shape = {1, fullShape[1], region.height, region.width};
+    if (tileReshaped && shape == tileShape) {
+        return TNN_OK;
+    }
+    // even a failed reshape may leave the instance off its full shape, the next full run restores it
+    tileReshaped = true;
+    tileShape.clear();
+    tileStat.reshapes++;
+    auto status = instance_->Reshape({{input_name, shape}});
+    RETURN_ON_NEQ(status, TNN_OK);
+    tileShape = shape;
+    return TNN_OK;
+}
+
+Status BodyDetect::segmentRegion(std::shared_ptr<Mat> frame, const MatROI &region,
+                                 std::shared_ptr<TNNSDKOutput> &output) {
+    auto option = dynamic_cast<BodyDetectOption *>(option_.get());
+    const DimsVector &shape = tileShape;
+
+    // the region of the frame at the scale of the full rect
+    const float sx = (float)lastMaskRoi.width / lastMaskWidth;
+    const float sy = (float)lastMaskRoi.height / lastMaskHeight;
+    MatROI frameRoi;
+    frameRoi.left = lastMaskRoi.left + (int)std::round(region.left * sx);
+    frameRoi.top = lastMaskRoi.top + (int)std::round(region.top * sy);
+    frameRoi.width = std::max(1, (int)std::round(region.width * sx));
+    frameRoi.height = std::max(1, (int)std::round(region.height * sy));
+    auto input_mat = ResizeFromFrame(frame, frameRoi, shape);
+    RETURN_VALUE_ON_NEQ(!input_mat, false, Status(TNNERR_PARAM_ERR, "Body tile resize error"));
+    auto status = SetInstanceInput(input_mat, GetConvertParamForInput());
+    RETURN_ON_NEQ(status, TNN_OK);
+    status = instance_->ForwardAsync(nullptr);
+    RETURN_ON_NEQ(status, TNN_OK);
+
+    output = CreateSDKOutput();
+    for (auto name : GetOutputNames()) {
+        std::shared_ptr<TNN_NS::Mat> output_mat = nullptr;
+        status = instance_->GetOutputMat(output_mat, GetConvertParamForOutput(name), name);
+        RETURN_ON_NEQ(status, TNN_OK);
+        output->AddMat(output_mat, name);
+    }
+    auto out = output->GetMat("human");
+    RETURN_VALUE_ON_NEQ(!out || out->GetWidth() != region.width || out->GetHeight() != region.height, false,
+                        Status(TNNERR_PARAM_ERR, "Body tile output has an unexpected shape"));
+    regionMask.resize(region.width * region.height);
+    ThresholdToMask((const float *)out->GetData(), regionMask.size(), m_thres, true, regionMask.data());
+
+    // linear seam towards the region edges inside the mask, the context there saw less of the image
+    const int blend = option->tile_blend;
+    const int x2 = region.left + region.width, y2 = region.top + region.height;
+    for (int y = 0; y < region.height; ++y) {
+        const int gy = region.top + y;
+        // the region edges on the mask border have no seam
+        int dy = INT_MAX;
+        if (region.top > 0) {
+            dy = std::min(dy, y);
+        }
+        if (y2 < lastMaskHeight) {
+            dy = std::min(dy, region.height - 1 - y);
+        }
+        u_char *dst = lastMask.data() + gy * lastMaskWidth + region.left;
+        const u_char *src = regionMask.data() + y * region.width;
+        for (int x = 0; x < region.width; ++x) {
+            int d = dy;
+            if (region.left > 0) {
+                d = std::min(d, x);
+            }
+            if (x2 < lastMaskWidth) {
+                d = std::min(d, region.width - 1 - x);
+            }
+            int w = (blend <= 0 || d >= blend) ? 256 : (d * 2 + 1) * 128 / blend;
+            dst[x] = (u_char)((src[x] * w + dst[x] * (256 - w)) >> 8);
+        }
+    }
+    return TNN_OK;
+}
+
+Status BodyDetect::ReuseLastOutput(std::shared_ptr<TNNSDKOutput> &output) {
+    output = CreateSDKOutput();
+    return writeLastMask();
+}
+
+void BodyDetect::ResetTemporalState() {
+    resetOFD();
+    motion.Reset();
+    framesSinceSegment = 0;
+}
+
+Status BodyDetect::writeLastMask() {
+    if (lastMask.empty()) {
+        return Status(TNNERR_NO_RESULT, "Not Found Body!");
+    }
+    return writeMask(lastMask.data(), lastMaskWidth, lastMaskHeight, lastMaskRoi, false);
+}
+
+Status BodyDetect::writeMask(const u_char *mask, int ow, int oh, const MatROI &rect, bool guided) {
+    auto option = dynamic_cast<BodyDetectOption *>(option_.get());
+    RETURN_VALUE_ON_NEQ(!option, false, Status(TNNERR_PARAM_ERR, "Body TNNOption is invalid"));
+
+    MaskBuffer buffer = getOutputBuffer();
+    Status status = buffer.Validate(srcInputWidth, srcInputHeight);
+    RETURN_ON_NEQ(status, TNN_OK);
+
+    // upsample straight into the human rect of the caller's mask, A8 and ARGB8888 without a copy
+    const uint32_t color = 0xffffff;
+    int height = rect.height;
+    int width = rect.width;
+    bool direct = buffer.format == TNNMaskFormatA8 || buffer.format == TNNMaskFormatARGB8888;
+    if (!direct) {
+        roiMask.resize(width * height);
+    }
+    uint8_t *roi = direct ? buffer.Row(rect.top) + rect.left * MaskBuffer::BytesPerRow(buffer.format, 1)
+                          : roiMask.data();
+    int roiStride = direct ? buffer.GetStride() / MaskBuffer::BytesPerRow(buffer.format, 1) : width;
+    bool argb = buffer.format == TNNMaskFormatARGB8888;
+
+    if (guided) {
+        const uint8_t *guide = (const uint8_t *)guideImage->GetData();
+        status = guidedUpsampler.Init(ow, oh, width, height, option->guided_radius, option->guided_eps);
+        RETURN_ON_NEQ(status, TNN_OK);
+        status = argb ? guidedUpsampler.ProcessToARGB(mask, guide, width * 3, (uint32_t *)roi, roiStride, color)
+                      : guidedUpsampler.Process(mask, guide, width * 3, roi, roiStride);
+    } else {
+        status = upsampler.Init(ow, oh, width, height);
+        RETURN_ON_NEQ(status, TNN_OK);
+        upsampler.SetNumThreads(option->upsample_threads);
+        status = argb ? upsampler.UpsampleToARGB(mask, (uint32_t *)roi, roiStride, color)
+                      : upsampler.Upsample(mask, roi, roiStride);
+    }
+    if (status != TNN_OK) {
+        return Status(TNNERR_NO_RESULT, "Not Found Body! Resize Failure!");
+    }
+    if (!direct) {
+        status = WriteAlphaRegion(buffer, rect.left, rect.top, roiMask.data(), width, height, width, color);
+    }
 
     return status;
 }
+MaskBuffer BodyDetect::getOutputBuffer() const {
+    if (maskBuffer.data) {
+        return maskBuffer;
+    }
+    return MaskBuffer(TNNMaskFormatARGB8888, maskData, srcInputWidth, srcInputHeight);
+}
+
 }
@@ -16,6 +16,7 @@
 #include <sys/time.h>
 #include <cmath>
 #include <cstring>
+#include <chrono>
 
 
 namespace TNN_NS {
@@ -36,6 +37,9 @@ namespace TNN_NS {
         auto option = dynamic_cast<FaceDetectOption *>(option_i.get());
         RETURN_VALUE_ON_NEQ(!option, false, Status(TNNERR_PARAM_ERR, "TNNSDKOption is invalid"));
 
+        tracker.SetOption(option->tracker_option);
+        resetTracker();
+
         status = TNNSDKSample::Init(option_i);
         RETURN_ON_NEQ(status, TNN_OK);
 
@@ -56,7 +60,7 @@ namespace TNN_NS {
 
     std::shared_ptr<Mat>
     FaceDetect::ProcessSDKInputMat(std::shared_ptr<Mat> input_image, std::string name) {
-        RETURN_VALUE_ON_NEQ(input_image->GetMatType(), N8UC3, nullptr);
+        RETURN_VALUE_ON_NEQ(input_image->GetMatType() == N8UC3 || IsYUV420sp(input_image), true, nullptr);
 
         this->orig_dims = input_image->GetDims();
         auto dims = input_image->GetDims();
@@ -67,34 +71,45 @@ namespace TNN_NS {
         inputWidth = input_width;
         inputHeight = input_height;
 
-        if (target_dims.size() >= 4 &&
-            (input_height != target_dims[2] || input_width != target_dims[3])) {
-            auto target_mat = std::make_shared<TNN_NS::Mat>(input_image->GetDeviceType(),
-                                                            input_image->GetMatType(), target_dims);
-
-            int ow = target_dims[3];
-            int oh = target_dims[2];
-            int iw = dims[3];
-            int ih = dims[2];
-            int nw = ow;
-            int nh = nw * ih / iw;
-            scale = ow * 1.0 / static_cast<float>(iw);
-            if (nh > oh) {
-                nh = oh;
-                nw = nh * iw / ih;
-                scale = oh * 1.0 / static_cast<float>(ih);
+        // only look at the upper part of the person box, faces are mapped back with roiX/roiY
+        roiX = 0;
+        roiY = 0;
+        if (roiWidth > 0 && roiHeight > 0) {
+            auto option = dynamic_cast<FaceDetectOption *>(option_.get());
+            float upper_ratio = option ? option->roi_upper_ratio : 1.0f;
+            int x1 = MAX((int)roiLeft, 0);
+            int y1 = MAX((int)roiTop, 0);
+            int x2 = MIN((int)(roiLeft + roiWidth), input_width);
+            int y2 = MIN((int)(roiTop + roiHeight * upper_ratio), input_height);
+            // tiny or full frame rois are not worth the crop
+            if (x2 - x1 >= kMinROISize && y2 - y1 >= kMinROISize &&
+                (x2 - x1 < input_width || y2 - y1 < input_height) && target_dims.size() >= 4) {
+                // crop and letterbox in one warp straight from the frame
+                MatROI roi;
+                roi.left = x1;
+                roi.top = y1;
+                roi.width = x2 - x1;
+                roi.height = y2 - y1;
+                auto target_mat = LetterboxFromFrame(input_image, roi, target_dims, scale, dx, dy);
+                if (target_mat) {
+                    roiX = x1;
+                    roiY = y1;
+                    return target_mat;
+                }
+                LOGE("FaceDetect roi crop error\n");
             }
-            dx = (ow - nw) / 2;
-            dy = (oh - nh) / 2;
-
+        }
 
-            auto status = ResizeAndMakeBorder(input_image, target_mat);
-            if (status == TNN_OK) {
-                return target_mat;
-            } else {
-                LOGE("ResizeAndMakeBorder error:%s\n", status.description().c_str());
-                return nullptr;
+        if (target_dims.size() >= 4 &&
+            (input_height != target_dims[2] || input_width != target_dims[3])) {
+            MatROI roi;
+            roi.width = input_width;
+            roi.height = input_height;
+            auto target_mat = LetterboxFromFrame(input_image, roi, target_dims, scale, dx, dy);
+            if (!target_mat) {
+                LOGE("ResizeAndMakeBorder error\n");
             }
+            return target_mat;
         } else {
             scale = 1;
             dx = 0;
@@ -109,50 +124,10 @@ namespace TNN_NS {
 
 
     void FaceDetect::calcPriors() {
-        priors.clear();
-
-        std::vector<int> w_h_list = {calcPriorWidth, calcPriorHeight};
-        const std::vector<float> strides = {8.0, 16.0, 32.0, 64.0};
-        const int num_featuremap = 4;
-        std::vector<std::vector<float>> featuremap_size;
-        std::vector<std::vector<float>> shrinkage_size;
-        const std::vector<std::vector<float>> min_boxes = {
-                {10.0f,  16.0f,  24.0f},
-                {32.0f,  48.0f},
-                {64.0f,  96.0f},
-                {128.0f, 192.0f, 256.0f}};
-        for (auto size : w_h_list) {
-            std::vector<float> fm_item;
-            for (float stride : strides) {
-                fm_item.push_back(ceil(size / stride));
-            }
-            featuremap_size.push_back(fm_item);
-        }
-
-        for (auto size : w_h_list) {
-            shrinkage_size.push_back(strides);
-        }
-        /* generate prior anchors */
-        for (int index = 0; index < num_featuremap; index++) {
-            float scale_w = calcPriorWidth / shrinkage_size[0][index];
-            float scale_h = calcPriorHeight / shrinkage_size[1][index];
-            for (int j = 0; j < featuremap_size[1][index]; j++) {
-                for (int i = 0; i < featuremap_size[0][index]; i++) {
-                    float x_center = (i + 0.5) / scale_w;
-                    float y_center = (j + 0.5) / scale_h;
-
-                    for (float k : min_boxes[index]) {
-                        float w = k / calcPriorWidth;
-                        float h = k / calcPriorHeight;
-                        priors.push_back(
-                                {clip(x_center, 1), clip(y_center, 1), clip(w, 1), clip(h, 1)});
-                    }
-                }
-            }
-        }
+        priors = GetPriorBoxTable(UltraFacePriorBoxSpec(calcPriorWidth, calcPriorHeight));
     }
 
-    void FaceDetect::nms(std::vector<FaceInfo> &input, std::vector<FaceInfo> &output, int type) {
+    void FaceDetect::nms(std::vector<FaceInfo> &input, std::vector<FaceInfo> &output, int type, int max_output) {
         std::sort(input.begin(), input.end(),
                   [](const FaceInfo &a, const FaceInfo &b) { return a.score > b.score; });
 
@@ -161,6 +136,8 @@ namespace TNN_NS {
         std::vector<int> merged(box_num, 0);
 
         for (int i = 0; i < box_num; i++) {
+            if (max_output > 0 && (int)output.size() >= max_output)
+                break;
             if (merged[i])
                 continue;
             std::vector<FaceInfo> buf;
@@ -236,48 +213,48 @@ namespace TNN_NS {
         }
     }
 
-    const std::string EMPTY_RESULT = "";
-
-    Status FaceDetect::ProcessSDKOutput(std::shared_ptr<TNNSDKOutput> output_) {
-        Status status = TNN_OK;
-        //LOGE("FaceDetect ProcessSDKOutput !!! ");
-        auto option = dynamic_cast<FaceDetectOption *>(option_.get());
-        RETURN_VALUE_ON_NEQ(!option, false, Status(TNNERR_PARAM_ERR, "TNNOption is invalid"));
+    void FaceDetect::rankFaces(std::vector<FaceInfo> &faces, FaceRankKey key, int max_faces, float cx, float cy) {
+        auto rank = [&](const FaceInfo &face) -> float {
+            switch (key) {
+                case FaceRankByArea:
+                    return (face.x2 - face.x1) * (face.y2 - face.y1);
+                case FaceRankByDistance: {
+                    float dx = (face.x1 + face.x2) / 2.0f - cx;
+                    float dy = (face.y1 + face.y2) / 2.0f - cy;
+                    return -(dx * dx + dy * dy);
+                }
+                default:
+                    return face.score;
+            }
+        };
+        auto middle = faces.begin() + std::min<size_t>(max_faces, faces.size());
+        std::partial_sort(faces.begin(), middle, faces.end(),
+                          [&](const FaceInfo &a, const FaceInfo &b) { return rank(a) > rank(b); });
+        faces.erase(middle, faces.end());
+    }
 
-        auto output = dynamic_cast<FaceDetectOutput *>(output_.get());
-        RETURN_VALUE_ON_NEQ(!output, false, Status(TNNERR_PARAM_ERR, "TNNSDKOutput is invalid"));
+    const std::string EMPTY_RESULT = "";
 
+    void FaceDetect::decodeFaces(FaceDetectOutput *output, std::vector<FaceInfo> &bbox_collection) {
         auto output0 = output->GetMat("boxes"); // [1,4420,4,1]
         auto output1 = output->GetMat("scores"); // [1,4420,2,1]
         float *boxes = (float *) output0->GetData();
         float *scores = (float *) output1->GetData();
 
-        int ow = output0->GetWidth();
-        int oh = output0->GetHeight();
-        int oc = output0->GetChannel();
-
-
-        int num_anchors = oc; // 4420
+        int num_anchors = MIN(output0->GetChannel(), (int)priors->size()); // 4420
 
         const float center_variance = 0.1;
         const float size_variance = 0.2;
 
-        /* generate prior anchors finished */
-        //int num_anchors = priors.size();
-        //LOGE("num_anchors:%d",num_anchors); // num_anchors:4420
-        //------------------------------------------------------------------
-
-        bool isFound = false;
-        std::vector<FaceInfo> bbox_collection;
         for (int i = 0; i < num_anchors; i++) {
             float score = scores[i * 2 + 1];
             if (score > score_threshold) {
-                isFound = true;
                 FaceInfo rects;
-                float x_center = boxes[i * 4] * center_variance * priors[i][2] + priors[i][0];
-                float y_center = boxes[i * 4 + 1] * center_variance * priors[i][3] + priors[i][1];
-                float w = exp(boxes[i * 4 + 2] * size_variance) * priors[i][2];
-                float h = exp(boxes[i * 4 + 3] * size_variance) * priors[i][3];
+                const PriorBox &prior = (*priors)[i];
+                float x_center = boxes[i * 4] * center_variance * prior.w + prior.cx;
+                float y_center = boxes[i * 4 + 1] * center_variance * prior.h + prior.cy;
+                float w = exp(boxes[i * 4 + 2] * size_variance) * prior.w;
+                float h = exp(boxes[i * 4 + 3] * size_variance) * prior.h;
 
                 rects.x1 = clip(x_center - w / 2.0, 1) * calcPriorWidth;
                 rects.y1 = clip(y_center - h / 2.0, 1) * calcPriorHeight;
@@ -287,123 +264,314 @@ namespace TNN_NS {
                 bbox_collection.push_back(rects);
             }
         }
+    }
+
+    Status FaceDetect::ProcessSDKOutput(std::shared_ptr<TNNSDKOutput> output_) {
+        //LOGE("FaceDetect ProcessSDKOutput !!! ");
+        auto option = dynamic_cast<FaceDetectOption *>(option_.get());
+        RETURN_VALUE_ON_NEQ(!option, false, Status(TNNERR_PARAM_ERR, "TNNOption is invalid"));
+
+        auto output = dynamic_cast<FaceDetectOutput *>(output_.get());
+        RETURN_VALUE_ON_NEQ(!output, false, Status(TNNERR_PARAM_ERR, "TNNSDKOutput is invalid"));
+        RETURN_VALUE_ON_NEQ(!priors || (int)priors->size() < output->GetMat("boxes")->GetChannel(), false,
+                            Status(TNNERR_PARAM_ERR, "prior boxes do not match the model output"));
+
+        std::vector<FaceInfo> bbox_collection;
+        decodeFaces(output, bbox_collection);
 
         std::vector<FaceInfo> infoList;
-        faceList.clear();
-        if (isFound) {
-            isFound = false;
-//            FaceInfo maxScoreRect;
+        if (!bbox_collection.empty()) {
+            const int max_faces = option->max_faces > 0 ? option->max_faces : (int)bbox_collection.size();
             if (bbox_collection.size() > 1) {
-                //nms(bbox_collection, infoList, blending_nms);
-                nms(bbox_collection, infoList, blending_nms);
-                if(infoList.size()>3) {
-                    // 找最大的3张人脸图
-                    int box_num = infoList.size();
-                    FaceInfo tmpFace;
-                    FaceInfo face1 = infoList.at(0);
-                    FaceInfo face2 = infoList.at(1);
-                    FaceInfo face3 = infoList.at(2);
-                    if(face1.score > face2.score){
-                        tmpFace = face1;
-                        face1 = face2;
-                        face2 = tmpFace;
-                    }
-                    if(face3.score < face1.score){
-                        tmpFace = face3;
-                        face3 = face2;
-                        face2 = face1;
-                        face1 = tmpFace;
-                    }else if(face3.score < face2.score){
-                        tmpFace = face3;
-                        face3 = face2;
-                        face2 = tmpFace;
-                    }
-                    for (int i = 3; i < box_num; i++) {
-                        FaceInfo rect = infoList[i];
-                        if (rect.score >= face3.score) {
-                            face1 = face2;
-                            face2 = face3;
-                            face3 = rect;
-                        }else if(rect.score >= face2.score){
-                            face1 = face2;
-                            face2 = rect;
-                        }else if(rect.score >= face1.score){
-                            face1 = rect;
-                        }
-                    }
-                    infoList.clear();
-                    infoList.push_back(face3);
-                    infoList.push_back(face2);
-                    infoList.push_back(face1);
+                // nms emits faces in score order, so for score ranking it can stop after max_faces
+                nms(bbox_collection, infoList, blending_nms,
+                    option->rank_key == FaceRankByScore ? max_faces : -1);
+                if ((int)infoList.size() > max_faces) {
+                    rankFaces(infoList, option->rank_key, max_faces, calcPriorWidth / 2.0f, calcPriorHeight / 2.0f);
                 }
             } else {
-                //isFound = true;
-                //maxScoreRect = bbox_collection.at(0);
-                infoList.push_back(bbox_collection.at(0));
+                infoList.push_back(std::move(bbox_collection.at(0)));
             }
-            //LOGE("Found infoList size:%d", infoList.size());
-
-            // 裁切出脸的图片
-            if (infoList.size()>0) {
-                int box_num = infoList.size();
-                //LOGE("Found faceList size:%d", box_num);
-                scale = 1.0f / scale;
-
-                float top_shift = 0;
-                float amplifier = 2.5;
-                for (int k = 0; k < box_num; k++) {
-                    FaceInfo rect = infoList[k];
-                    // 还原比例
-                    //LOGE("Face %d x1:%f, y1:%f, x2:%f, y2:%f dx:%d dy:%d scale:%f", k, rect.x1, rect.y1, rect.x2, rect.y2, dx, dy, scale);
-                    int x1 = (int)((rect.x1 - dx) * scale);
-                    int y1 = (int)((rect.y1 - dy) * scale);
-                    int x2 = (int)((rect.x2 - dx) * scale);
-                    int y2 = (int)((rect.y2 - dy) * scale);
-
-                    // 裁剪出脸部的最大边框
-                    int w = x2 - x1;
-                    int h = y2 - y1;
-                    if (w < h) {
-                        w = h;
-                    }
-//                    w = (int) (1.5 * w); // 扩大
-//                    h = w;
+        }
 
-                    int cx = (x2 + x1) / 2;
-                    int cy = (y2 + y1) / 2;
-//                    cy = (int) (0.8 * cy); //向上偏移
-                    cy = y1 + (h / 2 * (1 + top_shift));
-                    w = MAX(w, h) * amplifier;
-                    h = w;
+        // 还原比例
+        const float inv_scale = 1.0f / scale;
+        for (auto &rect : infoList) {
+            rect.x1 = (rect.x1 - dx) * inv_scale + roiX;
+            rect.y1 = (rect.y1 - dy) * inv_scale + roiY;
+            rect.x2 = (rect.x2 - dx) * inv_scale + roiX;
+            rect.y2 = (rect.y2 - dy) * inv_scale + roiY;
+        }
 
+        if (option->detect_interval > 1) {
+            std::vector<ObjectInfo> detections;
+            for (const auto &rect : infoList) {
+                detections.push_back(faceToObject(rect));
+            }
+            trackedFaces(tracker.Update(detections), infoList);
+        }
+        return buildFaceList(infoList);
+    }
 
-                    x1 = MAX(cx - w / 2, 0);
-                    y1 = MAX(cy - h / 2, 0);
+    Status FaceDetect::buildFaceList(const std::vector<FaceInfo> &infoList) {
+        faceList.clear();
+        // 裁切出脸的图片
+        float top_shift = 0;
+        float amplifier = 2.5;
+        for (const auto &info : infoList) {
+            FaceInfo rect = info;
+            int x1 = (int)rect.x1;
+            int y1 = (int)rect.y1;
+            int x2 = (int)rect.x2;
+            int y2 = (int)rect.y2;
+
+            // 裁剪出脸部的最大边框
+            int w = x2 - x1;
+            int h = y2 - y1;
+            if (w < h) {
+                w = h;
+            }
 
-                    if (x1 + w > inputWidth) {
-                        w = inputWidth - x1;
-                    }
-                    if (y1 + h > inputHeight) {
-                        h = inputHeight - y1;
+            int cx = (x2 + x1) / 2;
+            int cy = y1 + (h / 2 * (1 + top_shift));
+            w = MAX(w, h) * amplifier;
+            h = w;
+
+            // the whole head square, it may extend beyond the frame
+            rect.x1 = cx - w / 2;
+            rect.y1 = cy - h / 2;
+            rect.x2 = rect.x1 + w;
+            rect.y2 = rect.y1 + h;
+
+            x1 = MAX(cx - w / 2, 0);
+            y1 = MAX(cy - h / 2, 0);
+            x2 = MIN(cx - w / 2 + w, inputWidth);
+            y2 = MIN(cy - h / 2 + h, inputHeight);
+            w = x2 - x1;
+            h = y2 - y1;
+            if (w <= 0 || h <= 0) {
+                continue;
+            }
+            rect.l = x1;
+            rect.t = y1;
+            rect.w = w;
+            rect.h = h;
+            faceList.push_back(rect);
+        }
+        if (faceList.empty()) {
+            return Status(TNNERR_NO_RESULT, "Not Found Face!");
+        }
+        return TNN_OK;
+    }
+
+    ObjectInfo FaceDetect::faceToObject(const FaceInfo &face) {
+        ObjectInfo object;
+        object.image_width = inputWidth;
+        object.image_height = inputHeight;
+        object.x1 = face.x1;
+        object.y1 = face.y1;
+        object.x2 = face.x2;
+        object.y2 = face.y2;
+        object.score = face.score;
+        return object;
+    }
+
+    FaceInfo FaceDetect::objectToFace(const ObjectInfo &object) {
+        FaceInfo face;
+        memset(&face, 0, sizeof(face));
+        face.x1 = MAX(object.x1, 0);
+        face.y1 = MAX(object.y1, 0);
+        face.x2 = MIN(object.x2, inputWidth);
+        face.y2 = MIN(object.y2, inputHeight);
+        face.score = object.score;
+        return face;
+    }
+
+    void FaceDetect::trackedFaces(const std::vector<ObjectInfo> &objects, std::vector<FaceInfo> &infoList) {
+        auto option = dynamic_cast<FaceDetectOption *>(option_.get());
+        infoList.clear();
+        for (const auto &object : objects) {
+            infoList.push_back(objectToFace(object));
+        }
+        // tracks carry their own order, select the top faces again like the detector does
+        if (option && option->max_faces > 0 && (int)infoList.size() > option->max_faces) {
+            rankFaces(infoList, option->rank_key, option->max_faces, inputWidth / 2.0f, inputHeight / 2.0f);
+        }
+    }
+
+    Status FaceDetect::Predict(std::shared_ptr<TNNSDKInput> input, std::shared_ptr<TNNSDKOutput> &output) {
+        auto option = dynamic_cast<FaceDetectOption *>(option_.get());
+        if (!option || option->detect_interval <= 1) {
+            return TNNSDKSample::Predict(input, output);
+        }
+
+        tracker.Predict();
+        framesSinceDetect++;
+        bool detect = framesSinceDetect >= option->detect_interval || tracker.IsEmpty() ||
+                      tracker.GetConfidence() < option->min_track_confidence;
+        if (detect || !input || input->IsEmpty()) {
+            framesSinceDetect = 0;
+            return TNNSDKSample::Predict(input, output);
+        }
+
+        // serve the tracked boxes, the network is skipped on this frame
+        auto input_mat = input->GetMat();
+        inputWidth = input_mat->GetWidth();
+        inputHeight = input_mat->GetHeight();
+        output = CreateSDKOutput();
+
+        std::vector<FaceInfo> infoList;
+        trackedFaces(tracker.GetConfirmedObjects(), infoList);
+        return buildFaceList(infoList);
+    }
+
+    void FaceDetect::setDetectROI(float left, float top, float width, float height) {
+        roiLeft = left;
+        roiTop = top;
+        roiWidth = width;
+        roiHeight = height;
+    }
+
+    void FaceDetect::clearDetectROI() {
+        setDetectROI(0, 0, 0, 0);
+    }
+
+    Status FaceDetect::detectTile(std::shared_ptr<Mat> image, const MatROI &roi, std::vector<FaceInfo> &faces) {
+        // a tile is cropped and letterboxed in one warp straight from the frame, the full frame
+        // takes the regular preprocess
+        std::shared_ptr<Mat> input_mat = nullptr;
+        if (roi.width != image->GetWidth() || roi.height != image->GetHeight()) {
+            input_mat = LetterboxFromFrame(image, roi, GetInputShape(), scale, dx, dy);
+        } else {
+            input_mat = ProcessSDKInputMat(image);
+        }
+        RETURN_VALUE_ON_NEQ(!input_mat, false, Status(TNNERR_PARAM_ERR, "FaceDetect tile preprocess failed"));
+
+        auto status = instance_->SetInputMat(input_mat, GetConvertParamForInput());
+        RETURN_ON_NEQ(status, TNN_OK);
+        status = instance_->ForwardAsync(nullptr);
+        RETURN_ON_NEQ(status, TNN_OK);
+
+        auto output = std::make_shared<FaceDetectOutput>();
+        for (auto name : GetOutputNames()) {
+            std::shared_ptr<TNN_NS::Mat> output_mat = nullptr;
+            status = instance_->GetOutputMat(output_mat, GetConvertParamForOutput(name), name);
+            RETURN_ON_NEQ(status, TNN_OK);
+            output->AddMat(output_mat, name);
+        }
+        RETURN_VALUE_ON_NEQ(!output->GetMat("boxes") || (int)priors->size() < output->GetMat("boxes")->GetChannel(),
+                            false, Status(TNNERR_PARAM_ERR, "prior boxes do not match the model output"));
+
+        std::vector<FaceInfo> tile_faces;
+        decodeFaces(output.get(), tile_faces);
+        const float inv_scale = 1.0f / scale;
+        for (auto &rect : tile_faces) {
+            rect.x1 = (rect.x1 - dx) * inv_scale + roi.left;
+            rect.y1 = (rect.y1 - dy) * inv_scale + roi.top;
+            rect.x2 = (rect.x2 - dx) * inv_scale + roi.left;
+            rect.y2 = (rect.y2 - dy) * inv_scale + roi.top;
+            faces.push_back(rect);
+        }
+        return TNN_OK;
+    }
+
+    Status FaceDetect::detectTiled(std::shared_ptr<Mat> image, const FaceTileOption &tile_option) {
+        auto option = dynamic_cast<FaceDetectOption *>(option_.get());
+        RETURN_VALUE_ON_NEQ(!option || !instance_, false, Status(TNNERR_PARAM_ERR, "FaceDetect is not initialized"));
+        RETURN_VALUE_ON_NEQ(!image || image->GetMatType() != N8UC3, false,
+                            Status(TNNERR_PARAM_ERR, "detectTiled expects a N8UC3 image"));
+
+        const int image_width = image->GetWidth();
+        const int image_height = image->GetHeight();
+        const int model_width = calcPriorWidth;
+        const int model_height = calcPriorHeight;
+
+        // tiles carry their own roi, the person roi must not apply on top of them
+        float saved_roi[4] = {roiLeft, roiTop, roiWidth, roiHeight};
+        clearDetectROI();
+        tileStats.clear();
+
+        std::vector<FaceInfo> candidates;
+        Status status = TNN_OK;
+        auto run_tile = [&](float level, int left, int top, int width, int height) {
+            auto t1 = std::chrono::steady_clock::now();
+            size_t found = candidates.size();
+            MatROI roi;
+            roi.left = left;
+            roi.top = top;
+            roi.width = width;
+            roi.height = height;
+            status = detectTile(image, roi, candidates);
+            auto t2 = std::chrono::steady_clock::now();
+
+            FaceTileStat stat;
+            stat.scale = level;
+            stat.left = left;
+            stat.top = top;
+            stat.width = width;
+            stat.height = height;
+            stat.faces = static_cast<int>(candidates.size() - found);
+            stat.time = std::chrono::duration<float, std::milli>(t2 - t1).count();
+            tileStats.push_back(stat);
+        };
+
+        for (float level : tile_option.scales) {
+            if (level <= 0 || status != TNN_OK) {
+                continue;
+            }
+            // a tile covers the model input at this level
+            int tile_w = MIN((int)(model_width / level), image_width);
+            int tile_h = MIN((int)(model_height / level), image_height);
+            if (tile_w == image_width && tile_h == image_height && tile_option.full_frame) {
+                continue;
+            }
+            int step_x = MAX((int)(tile_w * (1.0f - tile_option.overlap)), 1);
+            int step_y = MAX((int)(tile_h * (1.0f - tile_option.overlap)), 1);
+            for (int top = 0; status == TNN_OK; top += step_y) {
+                int y = MIN(top, image_height - tile_h);
+                for (int left = 0; status == TNN_OK; left += step_x) {
+                    int x = MIN(left, image_width - tile_w);
+                    run_tile(level, x, y, tile_w, tile_h);
+                    if (x + tile_w >= image_width) {
+                        break;
                     }
-                    rect.x1 = x1;
-                    rect.y1 = y1;
-                    rect.x2 = x1 + w;
-                    rect.y2 = x1 + h;
-                    rect.l = x1;
-                    rect.t = y1;
-                    rect.w = w;
-                    rect.h = h;
-                    faceList.push_back(rect);
-                    //LOGE("2 Face %d x1:%f, y1:%f, x2:%f, y2:%f dx:%d dy:%d scale:%f", k, rect.x1, rect.y1, rect.x2, rect.y2, dx, dy, scale);
-                    //LOGE("2 Face %d l:%d, t:%d, w:%d, h:%d dx:%d dy:%d scale:%f", k, rect.l, rect.t, rect.w, rect.h, dx, dy, scale);
                 }
-            }else{
-                return Status(TNNERR_NO_RESULT, "Not Found Face!");
+                if (y + tile_h >= image_height) {
+                    break;
+                }
             }
-        }else{
-            return Status(TNNERR_NO_RESULT, "Not Found Face!");
         }
-        return status;
+        if (tile_option.full_frame && status == TNN_OK) {
+            run_tile(MIN(model_width / (float)image_width, model_height / (float)image_height),
+                     0, 0, image_width, image_height);
+        }
+        setDetectROI(saved_roi[0], saved_roi[1], saved_roi[2], saved_roi[3]);
+        RETURN_ON_NEQ(status, TNN_OK);
+
+        inputWidth = image_width;
+        inputHeight = image_height;
+        std::vector<FaceInfo> infoList;
+        if (!candidates.empty()) {
+            const int max_faces = option->max_faces > 0 ? option->max_faces : (int)candidates.size();
+            nms(candidates, infoList, blending_nms, option->rank_key == FaceRankByScore ? max_faces : -1);
+            if ((int)infoList.size() > max_faces) {
+                rankFaces(infoList, option->rank_key, max_faces, image_width / 2.0f, image_height / 2.0f);
+            }
+        }
+        return buildFaceList(infoList);
+    }
+
+    void FaceDetect::resetTracker() {
+        tracker.Reset();
+        framesSinceDetect = 0;
+    }
+
+    Status FaceDetect::ReuseLastOutput(std::shared_ptr<TNNSDKOutput> &output) {
+        output = CreateSDKOutput();
+        return faceList.empty() ? Status(TNNERR_NO_RESULT, "Not Found Face!") : Status(TNN_OK);
+    }
+
+    void FaceDetect::ResetTemporalState() {
+        resetTracker();
     }
-}
\ No newline at end of file
+}
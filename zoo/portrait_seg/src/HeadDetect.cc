@@ -13,6 +13,7 @@
 // specific language governing permissions and limitations under the License.
 
 #include "HeadDetect.h"
+#include "mask_utils.h"
 #include <sys/time.h>
 #include <cmath>
 #include <cstring>
@@ -56,38 +57,53 @@ Status HeadDetect::Init(std::shared_ptr<TNNSDKOption> option_i) {
 
 
 std::shared_ptr<Mat> HeadDetect::ProcessSDKInputMat(std::shared_ptr<Mat> input_image, std::string name) {
-    RETURN_VALUE_ON_NEQ(input_image->GetMatType(), N8UC3, nullptr);
+    RETURN_VALUE_ON_NEQ(input_image->GetMatType() == N8UC3 || IsYUV420sp(input_image), true, nullptr);
     this->orig_dims = input_image->GetDims();
-//    // save input image mat for merging
-//    auto dims = input_image->GetDims();
-//
-//    auto status = TNN_OK;
-//
-//    auto target_dims = GetInputShape(name);
-//    auto input_height = input_image->GetHeight();
-//    auto input_width = input_image->GetWidth();
-//
-//    // 强制Resize到256*256
-//    if (target_dims.size() >= 4 && (input_height != target_dims[2] || input_width != target_dims[3])) {
-//
-//        auto target_mat = std::make_shared<TNN_NS::Mat>(input_image->GetDeviceType(), input_image->GetMatType(), target_dims);
-//
-//        scaleX = (float)target_dims[3] / (float) input_width;
-//        scaleY = (float)target_dims[2] / (float) input_height;
-//
-//        auto status = Resize(input_image, target_mat,TNNInterpLinear);
-//
-//        if (status == TNN_OK) {
-//            return target_mat;
-//        } else {
-//            LOGE("Body Detect Resize error:%s\n", status.description().c_str());
-//            return nullptr;
-//        }
-//    }else{
-//        scaleX = 1;
-//        scaleY = 1;
-//    }
-    return input_image;
+    srcInputWidth = input_image->GetWidth();
+    srcInputHeight = input_image->GetHeight();
+
+    auto target_dims = GetInputShape(name);
+    if (target_dims.size() < 4 || faceList.empty()) {
+        LOGE("HeadDetect needs the model input shape and at least one face\n");
+        return nullptr;
+    }
+    // one batch slot per face, each filled by a single warp of the full frame: crop, scale and
+    // border in one resampling pass
+    const int slots = target_dims[0];
+    const int width = target_dims[3];
+    const int height = target_dims[2];
+    DimsVector input_dims = {slots, 3, height, width};
+    if (!headInput || headInput->GetDims() != input_dims) {
+        headInput = std::make_shared<TNN_NS::Mat>(input_image->GetDeviceType(), N8UC3, input_dims);
+    }
+    uint8_t *data = (uint8_t *)headInput->GetData();
+    const size_t plane = (size_t)width * height * 3;
+
+    const int batch = std::min({(int)faceList.size() - faceOffset, slots, HEAD_INPUT_BATCH});
+    if (batch <= 0) {
+        LOGE("HeadDetect has no face left at offset %d\n", faceOffset);
+        return nullptr;
+    }
+    headWarps.resize(batch);
+    for (int i = 0; i < batch; i++) {
+        const FaceInfo &faceInfo = faceList[faceOffset + i];
+        HeadWarp &warp = headWarps[i];
+        LetterboxTransform(faceInfo.x1, faceInfo.y1, faceInfo.x2 - faceInfo.x1, faceInfo.y2 - faceInfo.y1, width,
+                           height, warp.transform);
+        InvertAffine(warp.transform, warp.inverse);
+
+        DimsVector slot_dims = {1, 3, height, width};
+        auto slot = std::make_shared<TNN_NS::Mat>(headInput->GetDeviceType(), N8UC3, slot_dims, data + i * plane);
+        auto status = WarpAffine(input_image, slot, TNNInterpLinear, TNNBorderConstant, warp.transform);
+        if (status != TNN_OK) {
+            LOGE("HeadDetect warp error:%s\n", status.description().c_str());
+            return nullptr;
+        }
+    }
+    if (batch < slots) {
+        memset(data + batch * plane, 0, (slots - batch) * plane);
+    }
+    return headInput;
 }
 
 std::shared_ptr<TNNSDKOutput> HeadDetect::CreateSDKOutput() {
@@ -123,90 +139,55 @@ Status HeadDetect::ProcessSDKOutput(std::shared_ptr<TNNSDKOutput> output_) {
     int oc = output0->GetChannel();
     int outBatch = output0->GetBatch();
     // LOGE("Detect batch:%d",outBatch);
-    int batch = faceList.size();
+    int batch = std::min(std::min((int)headWarps.size(), outBatch), HEAD_INPUT_BATCH);
     long total = ow * oh;
-    //u_char * rmask = (u_char*)malloc(sizeof(u_char)* total);
-    //u_char* rmask = new u_char[total];
-    memset(rmaskData, 0, HEAD_INPUT_BATCH*modelInputHeight*modelInputWidth);
-    if(HEAD_INPUT_BATCH==1){
-        batch = 1;
-    }
     long allTotal = batch * total;
-    bool hasFound = false;
     float threshold = a_sigmoid(0.5);
     // LOGE("Detect threshold:%f allTotal:%d",threshold,allTotal);
-    for (int i = 0; i < allTotal; ++i) {
-        if(outData[i] > threshold){ // 阈值
-            hasFound = true;
-            rmaskData[i] = 0xff;
-        }
-    }
+    bool hasFound = ThresholdToMask(outData, allTotal, threshold, false, rmaskData) > 0;
     if(hasFound) {
-        void * command_queue = nullptr;
-        status = GetCommandQueue(&command_queue);
-        if (status != TNN_NS::TNN_OK) {
-            LOGE("HeadDetect output process getCommandQueue failed with:%s\n", status.description().c_str());
-            return status;
-        }
-        if(HEAD_INPUT_BATCH==1){
-            batch = 1;
-        }
+        MaskBuffer buffer = getOutputBuffer();
+        status = buffer.Validate(srcInputWidth, srcInputHeight);
+        RETURN_ON_NEQ(status, TNN_OK);
         auto t1=std::chrono::steady_clock::now();
-        int total2 = srcInputHeight * srcInputWidth;
+        // half transparent green over the body mask, or alone if no body was found. the frame is
+        // cleared once, then every face is upsampled and or-ed into its own rect only
+        if (!isDetectedBody && !maskCleared) {
+            status = ClearMask(buffer);
+            RETURN_ON_NEQ(status, TNN_OK);
+            maskCleared = true;
+        }
         for (int i = 0; i < batch; i++) {
-            FaceInfo faceInfo = faceList[i];
-            // 先resize到原始的大小
-            TNN_NS::DeviceType dt = TNN_NS::DEVICE_ARM;
-            TNN_NS::DimsVector r_dims = {1, 1, oh, ow}; // 转成3通道的
-            auto rMaskSize = std::make_shared<TNN_NS::Mat>(dt, TNN_NS::NGRAY, r_dims, rmaskData + i*total); // + i*total
-
-//            LOGE("Detect total:%d",total);
-//            TNN_NS::DimsVector resize_dims = {1, 1, srcInputHeight, srcInputWidth};
-//            auto resize_mat = std::make_shared<TNN_NS::Mat>(dt, TNN_NS::NGRAY, resize_dims);
-//            auto status = Resize(rMaskSize, resize_mat, TNNInterpLinear);
-//            if (status == TNN_OK) {
-//                u_char *alpha = (u_char *) resize_mat->GetData();
-//                for (int i = 0; i < total2; ++i) {
-//                    //maskData[i] = (alpha[i] << 24) | 0x00ff00;
-//                    maskData[i] = maskData[i] | ((alpha[i]>>1) << 24) | alpha[i] << 8;
-//                }
-//            }
-
-            TNN_NS::DimsVector resize_dims = {1, 1, faceInfo.h, faceInfo.w};
-            auto resize_mat = std::make_shared<TNN_NS::Mat>(dt, TNN_NS::NGRAY, resize_dims);
-            auto status = Resize(rMaskSize, resize_mat, TNNInterpLinear);
-            if (status == TNN_OK) {
-                // 填充到原始大小
-                CopyMakeBorderParam param1;
-                param1.border_type = BORDER_TYPE_CONSTANT;
-                param1.border_val = 0;
-                param1.left = faceInfo.l;
-                param1.top = faceInfo.t;
-                param1.right = srcInputWidth - faceInfo.l - faceInfo.w;
-                param1.bottom = srcInputHeight - faceInfo.t - faceInfo.h;
-
-                TNN_NS::DimsVector dst_dims = {1, 1, srcInputHeight, srcInputWidth}; // 转成3通道的
-                auto dst_mat = std::make_shared<TNN_NS::Mat>(dt, TNN_NS::NGRAY, dst_dims);
-
-                status = MatUtils::CopyMakeBorder(*(resize_mat.get()), *(dst_mat.get()), param1, command_queue);
-                if (status != TNN_NS::TNN_OK){
-                    LOGE("Resize to Src Input Size failed with:%s\n", status.description().c_str());
-                }
-
-                u_char *alpha = (u_char *) dst_mat->GetData();
-                if(isDetectedBody){
-                    for (int i = 0; i < total2; ++i) {
-                        maskData[i] = maskData[i] | ((alpha[i]>>1) << 24) | alpha[i] << 8; // alpha-> alpha[i]>>1    alpha = alpha[i]/2 ~ 7f
-                        //if(alpha[i]>0)maskData[i] = (alpha[i] << 24) | 0x00ff00;
-                    }
-                }else {
-                    for (int i = 0; i < total2; ++i) {
-                        maskData[i] = ((alpha[i]>>1) << 24) | 0x00ff00;
-                    }
-                }
-                //memcpy(target_mat->GetData(), maskData, sizeof(u_int) * orig_dims[2] * orig_dims[3]); // copy到mask
-            } else {
-                //free(rmask);
+            // the model input in frame coordinates, clipped to the frame
+            const HeadWarp &warp = headWarps[i];
+            float x1, y1, x2, y2;
+            ApplyAffine(warp.inverse, 0, 0, x1, y1);
+            ApplyAffine(warp.inverse, modelInputWidth, modelInputHeight, x2, y2);
+            int left = std::max((int)std::floor(x1), 0);
+            int top = std::max((int)std::floor(y1), 0);
+            int right = std::min((int)std::ceil(x2), srcInputWidth);
+            int bottom = std::min((int)std::ceil(y2), srcInputHeight);
+            if (right <= left || bottom <= top) {
+                LOGE("HeadDetect skip head outside of the frame:%f,%f,%f,%f\n", x1, y1, x2, y2);
+                continue;
+            }
+            // halve the alpha at model resolution, it is much smaller than the face rect
+            u_char *alpha = rmaskData + i * total;
+            for (long k = 0; k < total; ++k) {
+                alpha[k] >>= 1;
+            }
+            // frame pixel X is input pixel s * X + t, the same point of the mask as the warp saw it
+            const float rx = (float)ow / modelInputWidth;
+            const float ry = (float)oh / modelInputHeight;
+            const float sx = warp.transform[0][0];
+            const float sy = warp.transform[1][1];
+            status = upsampler.InitMapped(ow, oh, right - left, bottom - top, sx * rx,
+                                          (sx * left + warp.transform[0][2] + 0.5f) * rx - 0.5f * sx * rx, sy * ry,
+                                          (sy * top + warp.transform[1][2] + 0.5f) * ry - 0.5f * sy * ry);
+            RETURN_ON_NEQ(status, TNN_OK);
+            status = upsampler.UpsampleToMask(alpha, buffer, left, top, 0x00ff00, TNNMaskBlendOr, kHeadClassId,
+                                              0x40);
+            if (status != TNN_OK) {
                 return Status(TNNERR_NO_RESULT, "Not Found Body! Resize Failure!");
             }
         }
@@ -217,4 +198,25 @@ Status HeadDetect::ProcessSDKOutput(std::shared_ptr<TNNSDKOutput> output_) {
     return status;
 }
 
+Status HeadDetect::Predict(std::shared_ptr<TNNSDKInput> input, std::shared_ptr<TNNSDKOutput> &output) {
+    // a run fills at most HEAD_INPUT_BATCH slots, the remaining faces take further runs on the
+    // same frame and are or-ed into the same mask
+    faceOffset = 0;
+    maskCleared = false;
+    Status status = TNN_OK;
+    do {
+        status = TNNSDKSample::Predict(input, output);
+        RETURN_ON_NEQ(status, TNN_OK);
+        faceOffset += (int)headWarps.size();
+    } while (!headWarps.empty() && faceOffset < (int)faceList.size());
+    return status;
+}
+
+MaskBuffer HeadDetect::getOutputBuffer() const {
+    if (maskBuffer.data) {
+        return maskBuffer;
+    }
+    return MaskBuffer(TNNMaskFormatARGB8888, maskData, srcInputWidth, srcInputHeight);
+}
+
 }
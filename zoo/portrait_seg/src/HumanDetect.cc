@@ -53,7 +53,7 @@ Status HumanDetect::Init(std::shared_ptr<TNNSDKOption> option_i) {
 }
 
 std::shared_ptr<Mat> HumanDetect::ProcessSDKInputMat(std::shared_ptr<Mat> input_image, std::string name) {
-    RETURN_VALUE_ON_NEQ(input_image->GetMatType(), N8UC3, nullptr);
+    RETURN_VALUE_ON_NEQ(input_image->GetMatType() == N8UC3 || IsYUV420sp(input_image), true, nullptr);
     this->orig_dims = input_image->GetDims();
     // save input image mat for merging
     auto dims = input_image->GetDims();
@@ -67,19 +67,17 @@ std::shared_ptr<Mat> HumanDetect::ProcessSDKInputMat(std::shared_ptr<Mat> input_
     // 强制Resize到128*128
     if (target_dims.size() >= 4 && (input_height != target_dims[2] || input_width != target_dims[3])) {
 
-        auto target_mat = std::make_shared<TNN_NS::Mat>(input_image->GetDeviceType(), input_image->GetMatType(), target_dims);
-
         scaleX = (float)target_dims[3] / (float) input_width;
         scaleY = (float)target_dims[2] / (float) input_height;
 
-        auto status = Resize(input_image, target_mat,TNNInterpLinear);
-
-        if (status == TNN_OK) {
-            return target_mat;
-        } else {
-            LOGE("Body Detect Resize error:%s\n", status.description().c_str());
-            return nullptr;
+        MatROI roi;
+        roi.width = input_width;
+        roi.height = input_height;
+        auto target_mat = ResizeFromFrame(input_image, roi, target_dims);
+        if (!target_mat) {
+            LOGE("Human Detect Resize error\n");
         }
+        return target_mat;
     }else{
         scaleX = 1;
         scaleY = 1;
@@ -91,6 +89,12 @@ std::shared_ptr<TNNSDKOutput> HumanDetect::CreateSDKOutput() {
     return std::make_shared<HumanDetectOutput>();
 }
 
+// humanList and the crop of the last inferred frame stay
+Status HumanDetect::ReuseLastOutput(std::shared_ptr<TNNSDKOutput> &output) {
+    output = CreateSDKOutput();
+    return TNN_OK;
+}
+
 Status HumanDetect::ProcessSDKOutput(std::shared_ptr<TNNSDKOutput> output_) {
     Status status = TNN_OK;
     // LOGE("HeadDetect ProcessSDKOutput !!! ");
@@ -101,7 +105,8 @@ Status HumanDetect::ProcessSDKOutput(std::shared_ptr<TNNSDKOutput> output_) {
     RETURN_VALUE_ON_NEQ(!output, false, Status(TNNERR_PARAM_ERR, "TNNSDKOutput is invalid"));
 
 
-    auto centerPos = output->GetMat("739"); // [1,2,32,32]
+    auto centerPos = output->GetMat(option->heatmap_name); // [1,2,32,32]
+    RETURN_VALUE_ON_NEQ(!centerPos, false, Status(TNNERR_PARAM_ERR, "HumanDetect heatmap output is missing"));
     float* centerPosData = (float *)centerPos->GetData();
 
     int ow = centerPos->GetWidth();
@@ -109,70 +114,64 @@ Status HumanDetect::ProcessSDKOutput(std::shared_ptr<TNNSDKOutput> output_) {
     int oc = centerPos->GetChannel();
     int outBatch = centerPos->GetBatch();
 
-    int x = -1;
-    int y = -1;
-    float maxScore = 0;
-    int total = ow * oh;
-    for(int i=0;i<oh;i++){
-        for (int j = 0; j < ow; ++j) {
-            float score = centerPosData[i*ow+j];
-            if(score > 0.5 && score > maxScore){ //
-                maxScore = score;
-                x = j;
-                y = i;
+    // every channel of the heatmap is a person class, all of them share offset and size. one
+    // person may peak in several channels, so the peaks are taken on their maximum
+    std::vector<HeatmapPeak> peaks;
+    if (oc > 1) {
+        personHeatmap.resize(ow * oh);
+        MaxHeatmapChannels(centerPosData, ow * oh, oc, personHeatmap.data());
+        centerPosData = personHeatmap.data();
+    }
+    FindHeatmapPeaks(centerPosData, ow, oh, 1, option->score_threshold, option->max_humans, peaks);
+    LOGE("Found human:%d maxScore:%f", (int)peaks.size(), peaks.empty() ? 0.0f : peaks[0].score);
+
+    humanList.clear();
+    cropX = 0;
+    cropY = 0;
+    cropWidth = 0;
+    cropHeight = 0;
+    if (!peaks.empty()) {
+        auto offset = output->GetMat(option->offset_name); // [1,2,32,32]
+        auto size = output->GetMat(option->size_name); // [1,2,32,32]
+        RETURN_VALUE_ON_NEQ(!offset || !size, false, Status(TNNERR_PARAM_ERR, "HumanDetect box outputs are missing"));
+
+        std::vector<ObjectInfo> boxes;
+        DecodeCenterBoxes(peaks, (float *)offset->GetData(), (float *)size->GetData(), ow, oh, boxes);
+        for (auto &box : boxes) {
+            // a square 1.1 times the longer side from the top left corner, clipped to the grid
+            float x = box.x1;
+            float y = box.y1;
+            float w = MAX(box.x2 - box.x1, box.y2 - box.y1) * 1.1f;
+            float h = w;
+            if (x < 0) {
+                w = w + x;
+                x = 0;
             }
-            score = centerPosData[i*ow+j + total];
-            if(score > 0.5 && score > maxScore){ // score > 0.5 &&
-                maxScore = score;
-                x = j;
-                y = i;
+            if (y < 0) {
+                h = h + y;
+                y = 0;
             }
+            w = MIN(w, ow - x);
+            h = MIN(h, oh - y);
+            if (w <= 0 || h <= 0) {
+                continue;
+            }
+            box.image_width = srcInputWidth;
+            box.image_height = srcInputHeight;
+            box.x1 = x / ow * srcInputWidth;
+            box.y1 = y / oh * srcInputHeight;
+            box.x2 = (x + w) / ow * srcInputWidth;
+            box.y2 = (y + h) / oh * srcInputHeight;
+            humanList.push_back(box);
         }
-    }
-    LOGE("Found human maxScore:%f", maxScore);
-
-    if(maxScore>0.5){
-        //找到
-        auto offset = output->GetMat("743"); // [1,2,32,32]
-        float* offsetData = (float *)offset->GetData();
-
-
-        auto size = output->GetMat("747"); // [1,2,32,32]
-        float* sizeData = (float *)size->GetData();
-
-        cropWidth = sizeData[y*ow + x];
-        cropHeight = sizeData[y*ow + x + total];
-        cropX = x + offsetData[y*ow + x] - cropWidth/2.0f;
-        cropY = y + offsetData[y*ow + x + total] - cropHeight/2.0f;
-
-        cropWidth = MAX(cropWidth, cropHeight) * 1.1f;
-        cropHeight = cropWidth;
-
-        if(cropX < 0){
-            cropWidth = cropWidth + cropX;
-            cropX = 0;
-        }
-        if(cropY < 0){
-            cropHeight = cropHeight + cropY;
-            cropY = 0;
-        }
-        float resizeSize = 32.0f;
-        if(cropX + cropWidth > resizeSize){
-            cropWidth = resizeSize - cropX;
-        }
-        if(cropY + cropHeight > resizeSize){
-            cropHeight = resizeSize - cropY;
+        if (!humanList.empty()) {
+            const ObjectInfo &best = humanList[0];
+            cropX = best.x1;
+            cropY = best.y1;
+            cropWidth = best.x2 - best.x1;
+            cropHeight = best.y2 - best.y1;
+            LOGE("Find Human at (%f,%f,%f,%f)",cropX, cropY, cropWidth, cropHeight);
         }
-        cropX = cropX / resizeSize * srcInputWidth;
-        cropY = cropY / resizeSize * srcInputHeight;
-        cropWidth = cropWidth / resizeSize * srcInputWidth;
-        cropHeight = cropHeight / resizeSize * srcInputHeight;
-        LOGE("Find Human at (%f,%f,%f,%f)",cropX, cropY, cropWidth, cropHeight);
-    }else{
-        cropX = 0;
-        cropY = 0;
-        cropWidth = 0;
-        cropHeight = 0;
     }
     LOGE("ow:%d oh:%d oc:%d batch:%d",ow,oh,oc,outBatch);
     return status;
@@ -0,0 +1,161 @@
+// Tencent is pleased to support the open source community by making TNN available.
+//
+// Copyright (C) 2020 THL A29 Limited, a Tencent company. All rights reserved.
+//
+// Licensed under the BSD 3-Clause License (the "License"); you may not use this file except
+// in compliance with the License. You may obtain a copy of the License at
+//
+// https://opensource.org/licenses/BSD-3-Clause
+//
+// Unless required by applicable law or agreed to in writing, software distributed
+// under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+// CONDITIONS OF ANY KIND, either express or implied. See the License for the
+// specific language governing permissions and limitations under the License.
+
+
+#include "PortraitPipeline.h"
+#include <chrono>
+
+namespace TNN_NS {
+
+Status PortraitPipeline::Init(std::shared_ptr<HumanDetect> human, std::shared_ptr<BodyDetect> body,
+                              std::shared_ptr<FaceDetect> face, std::shared_ptr<HeadDetect> head) {
+    RETURN_VALUE_ON_NEQ(human && body && face && head, true,
+                        Status(TNNERR_PARAM_ERR, "PortraitPipeline needs all four detectors"));
+    auto status = TNNSDKComposeSample::Init({human, body, face, head});
+    RETURN_ON_NEQ(status, TNN_OK);
+    this->human = human;
+    this->body = body;
+    this->face = face;
+    this->head = head;
+
+    pyramid = std::make_shared<FramePyramid>();
+    for (auto &sdk : sdks_) {
+        sdk->SetFramePyramid(pyramid);
+    }
+    stages_.clear();
+
+    TNNSDKStage stage;
+    stage.name = "human";
+    stage.run = [this](std::shared_ptr<TNNSDKInput> input) {
+        if (!shouldRun("human")) {
+            return this->human->humanList.empty() ? Status(TNNERR_NO_RESULT, "Not Found Human!") : Status(TNN_OK);
+        }
+        std::shared_ptr<TNNSDKOutput> output;
+        auto status = this->human->Predict(input, output);
+        RETURN_ON_NEQ(status, TNN_OK);
+        return this->human->humanList.empty() ? Status(TNNERR_NO_RESULT, "Not Found Human!") : Status(TNN_OK);
+    };
+    status = AddStage(stage);
+    RETURN_ON_NEQ(status, TNN_OK);
+
+    stage.name = "body";
+    stage.inputs = {"human"};
+    stage.run = [this](std::shared_ptr<TNNSDKInput> input) {
+        if (!shouldRun("body")) {
+            auto status = this->body->writeLastMask();
+            bodyFound = status == TNN_OK;
+            return status;
+        }
+        // the rect is used as is, with roi_tracking the boxes position the smoothed roi instead
+        this->body->setPersonBoxes(this->human->humanList);
+        this->body->humRectLeft = static_cast<int>(this->human->cropX);
+        this->body->humRectTop = static_cast<int>(this->human->cropY);
+        this->body->humRectWidth = static_cast<int>(this->human->cropWidth);
+        this->body->humRectHeight = static_cast<int>(this->human->cropHeight);
+        std::shared_ptr<TNNSDKOutput> output;
+        auto status = this->body->Predict(input, output);
+        bodyFound = status == TNN_OK;
+        return status;
+    };
+    status = AddStage(stage);
+    RETURN_ON_NEQ(status, TNN_OK);
+
+    stage.name = "face";
+    stage.inputs = {};
+    stage.run = [this](std::shared_ptr<TNNSDKInput> input) {
+        if (!shouldRun("face")) {
+            return this->face->faceList.empty() ? Status(TNNERR_NO_RESULT, "Not Found Face!") : Status(TNN_OK);
+        }
+        std::shared_ptr<TNNSDKOutput> output;
+        auto status = this->face->Predict(input, output);
+        RETURN_ON_NEQ(status, TNN_OK);
+        return this->face->faceList.empty() ? Status(TNNERR_NO_RESULT, "Not Found Face!") : Status(TNN_OK);
+    };
+    status = AddStage(stage);
+    RETURN_ON_NEQ(status, TNN_OK);
+
+    // reads the faces, waits for body only because the head mask is merged into the body mask
+    stage.name = "head";
+    stage.inputs = {"face"};
+    stage.after = {"body"};
+    stage.run = [this](std::shared_ptr<TNNSDKInput> input) {
+        this->head->faceList = this->face->faceList;
+        this->head->isDetectedBody = bodyFound;
+        std::shared_ptr<TNNSDKOutput> output;
+        return this->head->Predict(input, output);
+    };
+    return AddStage(stage);
+}
+
+Status PortraitPipeline::setScheduler(std::shared_ptr<FrameScheduler> scheduler) {
+    if (scheduler) {
+        for (const auto &stage : stages_) {
+            auto status = scheduler->AddStage(stage.name, stage.name != "head");
+            RETURN_ON_NEQ(status, TNN_OK);
+        }
+    }
+    this->scheduler = scheduler;
+    return TNN_OK;
+}
+
+bool PortraitPipeline::shouldRun(const std::string &stage) const {
+    return !scheduler || scheduler->ShouldRun(stage);
+}
+
+void PortraitPipeline::setMaskBuffer(const MaskBuffer &buffer) {
+    maskBuffer = buffer;
+    if (body) {
+        body->setMaskBuffer(buffer);
+    }
+    if (head) {
+        head->setMaskBuffer(buffer);
+    }
+}
+
+Status PortraitPipeline::Predict(std::shared_ptr<TNNSDKInput> input, std::shared_ptr<TNNSDKOutput> &output) {
+    if (!input || input->IsEmpty()) {
+        return Status(TNNERR_PARAM_ERR, "input image is empty ,please check!");
+    }
+    if (!pyramid) {
+        return Status(TNNERR_PARAM_ERR, "PortraitPipeline is not initialized");
+    }
+    // the stages write the masks into the mask buffer, the output carries no mat
+    output = CreateSDKOutput();
+    frameDropped = scheduler && !scheduler->BeginFrame();
+    if (frameDropped) {
+        return TNN_OK;
+    }
+    auto begin = std::chrono::steady_clock::now();
+    pyramid->SetFrame(input->GetMat());
+    bodyFound = false;
+    auto status = RunStages(input);
+    if (scheduler) {
+        scheduler->AddStageTimes(GetStageStats());
+        scheduler->EndFrame(std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - begin).count());
+    }
+    RETURN_ON_NEQ(status, TNN_OK);
+
+    // head clears the mask itself when it runs without a body, nothing wrote it otherwise
+    bool headRan = false;
+    for (const auto &stat : GetStageStats()) {
+        headRan = headRan || (stat.name == "head" && !stat.skipped);
+    }
+    if (!bodyFound && !headRan && maskBuffer.data) {
+        status = ClearMask(maskBuffer);
+        RETURN_ON_NEQ(status, TNN_OK);
+    }
+    return (bodyFound || headRan) ? Status(TNN_OK) : Status(TNNERR_NO_RESULT, "Not Found Portrait!");
+}
+
+}
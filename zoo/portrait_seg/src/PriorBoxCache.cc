@@ -0,0 +1,147 @@
+// Tencent is pleased to support the open source community by making TNN available.
+//
+// Copyright (C) 2020 THL A29 Limited, a Tencent company. All rights reserved.
+//
+// Licensed under the BSD 3-Clause License (the "License"); you may not use this file except
+// in compliance with the License. You may obtain a copy of the License at
+//
+// https://opensource.org/licenses/BSD-3-Clause
+//
+// Unless required by applicable law or agreed to in writing, software distributed
+// under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+// CONDITIONS OF ANY KIND, either express or implied. See the License for the
+// specific language governing permissions and limitations under the License.
+
+#include "PriorBoxCache.h"
+#include <algorithm>
+#include <cmath>
+#include <map>
+#include <mutex>
+#include <tuple>
+
+namespace TNN_NS {
+
+namespace {
+
+constexpr int kUltraFaceNumFeatureMap = 4;
+constexpr float kUltraFaceStrides[kUltraFaceNumFeatureMap] = {8.0f, 16.0f, 32.0f, 64.0f};
+constexpr int kUltraFaceNumMinBoxes[kUltraFaceNumFeatureMap] = {3, 2, 2, 3};
+constexpr float kUltraFaceMinBoxes[kUltraFaceNumFeatureMap][3] = {
+        {10.0f,  16.0f,  24.0f},
+        {32.0f,  48.0f,  0.0f},
+        {64.0f,  96.0f,  0.0f},
+        {128.0f, 192.0f, 256.0f}};
+
+constexpr float ClipUnit(float x) {
+    return x < 0 ? 0.0f : (x > 1 ? 1.0f : x);
+}
+
+// ceil(size / stride) for the integral strides used by ssd heads
+constexpr int FeatureMapSize(int size, float stride) {
+    return (size + static_cast<int>(stride) - 1) / static_cast<int>(stride);
+}
+
+// shared by the compile-time and the runtime generator so both produce bit-identical tables
+constexpr PriorBox MakePriorBox(int i, int j, float scale_w, float scale_h, float min_box,
+                                int input_width, int input_height) {
+    return PriorBox{ClipUnit(static_cast<float>((i + 0.5) / scale_w)),
+                    ClipUnit(static_cast<float>((j + 0.5) / scale_h)),
+                    ClipUnit(min_box / input_width),
+                    ClipUnit(min_box / input_height)};
+}
+
+constexpr size_t UltraFacePriorCount(int input_width, int input_height) {
+    size_t count = 0;
+    for (int index = 0; index < kUltraFaceNumFeatureMap; index++) {
+        count += static_cast<size_t>(FeatureMapSize(input_width, kUltraFaceStrides[index])) *
+                 FeatureMapSize(input_height, kUltraFaceStrides[index]) * kUltraFaceNumMinBoxes[index];
+    }
+    return count;
+}
+
+template <size_t N>
+struct PriorBoxArray {
+    PriorBox boxes[N];
+};
+
+template <int W, int H>
+constexpr PriorBoxArray<UltraFacePriorCount(W, H)> MakeUltraFacePriors() {
+    PriorBoxArray<UltraFacePriorCount(W, H)> table = {};
+    size_t n = 0;
+    for (int index = 0; index < kUltraFaceNumFeatureMap; index++) {
+        const float stride  = kUltraFaceStrides[index];
+        const float scale_w = W / stride;
+        const float scale_h = H / stride;
+        for (int j = 0; j < FeatureMapSize(H, stride); j++) {
+            for (int i = 0; i < FeatureMapSize(W, stride); i++) {
+                for (int k = 0; k < kUltraFaceNumMinBoxes[index]; k++) {
+                    table.boxes[n++] = MakePriorBox(i, j, scale_w, scale_h, kUltraFaceMinBoxes[index][k], W, H);
+                }
+            }
+        }
+    }
+    return table;
+}
+
+// the input shape of the face model we ship, 4420 anchors
+constexpr auto kUltraFacePriors320x240 = MakeUltraFacePriors<320, 240>();
+
+std::vector<PriorBox> GeneratePriorBoxes(const PriorBoxSpec &spec) {
+    std::vector<PriorBox> priors;
+    const int num_featuremap = static_cast<int>(std::min(spec.strides.size(), spec.min_boxes.size()));
+    for (int index = 0; index < num_featuremap; index++) {
+        const float stride  = spec.strides[index];
+        const float scale_w = spec.input_width / stride;
+        const float scale_h = spec.input_height / stride;
+        const int fm_w      = static_cast<int>(std::ceil(spec.input_width / stride));
+        const int fm_h      = static_cast<int>(std::ceil(spec.input_height / stride));
+        for (int j = 0; j < fm_h; j++) {
+            for (int i = 0; i < fm_w; i++) {
+                for (float k : spec.min_boxes[index]) {
+                    priors.push_back(MakePriorBox(i, j, scale_w, scale_h, k, spec.input_width, spec.input_height));
+                }
+            }
+        }
+    }
+    return priors;
+}
+
+}  // namespace
+
+bool PriorBoxSpec::operator<(const PriorBoxSpec &other) const {
+    return std::tie(input_width, input_height, strides, min_boxes) <
+           std::tie(other.input_width, other.input_height, other.strides, other.min_boxes);
+}
+
+PriorBoxSpec UltraFacePriorBoxSpec(int input_width, int input_height) {
+    PriorBoxSpec spec;
+    spec.input_width  = input_width;
+    spec.input_height = input_height;
+    for (int index = 0; index < kUltraFaceNumFeatureMap; index++) {
+        spec.strides.push_back(kUltraFaceStrides[index]);
+        spec.min_boxes.emplace_back(kUltraFaceMinBoxes[index], kUltraFaceMinBoxes[index] + kUltraFaceNumMinBoxes[index]);
+    }
+    return spec;
+}
+
+std::shared_ptr<const PriorBoxTable> GetPriorBoxTable(const PriorBoxSpec &spec) {
+    static std::mutex cache_mutex;
+    static std::map<PriorBoxSpec, std::shared_ptr<const PriorBoxTable>> cache;
+
+    std::lock_guard<std::mutex> lock(cache_mutex);
+    auto iter = cache.find(spec);
+    if (iter != cache.end()) {
+        return iter->second;
+    }
+
+    std::shared_ptr<const PriorBoxTable> table;
+    if (!(spec < UltraFacePriorBoxSpec(320, 240)) && !(UltraFacePriorBoxSpec(320, 240) < spec)) {
+        table = std::make_shared<PriorBoxTable>(kUltraFacePriors320x240.boxes, UltraFacePriorCount(320, 240));
+    } else {
+        table = std::make_shared<PriorBoxTable>(GeneratePriorBoxes(spec));
+    }
+    cache[spec] = table;
+    return table;
+}
+
+}  // namespace TNN_NS
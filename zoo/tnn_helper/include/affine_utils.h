@@ -0,0 +1,43 @@
+// Tencent is pleased to support the open source community by making TNN available.
+//
+// Copyright (C) 2020 THL A29 Limited, a Tencent company. All rights reserved.
+//
+// Licensed under the BSD 3-Clause License (the "License"); you may not use this file except
+// in compliance with the License. You may obtain a copy of the License at
+//
+// https://opensource.org/licenses/BSD-3-Clause
+//
+// Unless required by applicable law or agreed to in writing, software distributed
+// under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+// CONDITIONS OF ANY KIND, either express or implied. See the License for the
+// specific language governing permissions and limitations under the License.
+
+#ifndef TNN_EXAMPLES_BASE_AFFINE_UTILS_H_
+#define TNN_EXAMPLES_BASE_AFFINE_UTILS_H_
+
+#include "tnn/core/macro.h"
+
+namespace TNN_NS {
+
+// 2x3 affine matrices in the layout of WarpAffineParam::transform, a source point (x, y) maps
+// to (m[0][0] * x + m[0][1] * y + m[0][2], m[1][0] * x + m[1][1] * y + m[1][2]) in dst.
+
+/**
+ * Similarity transform that fits the rect (x, y, width, height) into dst_width x dst_height
+ * with one uniform scale and centres it, the uncovered part of dst is border. The rect may
+ * extend beyond the source image. Returns the scale.
+ */
+float LetterboxTransform(float x, float y, float width, float height, int dst_width, int dst_height,
+                         float m[2][3]);
+
+// returns false and leaves inv untouched if m is singular
+bool InvertAffine(const float m[2][3], float inv[2][3]);
+
+inline void ApplyAffine(const float m[2][3], float x, float y, float &out_x, float &out_y) {
+    out_x = m[0][0] * x + m[0][1] * y + m[0][2];
+    out_y = m[1][0] * x + m[1][1] * y + m[1][2];
+}
+
+}  // namespace TNN_NS
+
+#endif  // TNN_EXAMPLES_BASE_AFFINE_UTILS_H_
@@ -0,0 +1,103 @@
+// Tencent is pleased to support the open source community by making TNN available.
+//
+// Copyright (C) 2020 THL A29 Limited, a Tencent company. All rights reserved.
+//
+// Licensed under the BSD 3-Clause License (the "License"); you may not use this file except
+// in compliance with the License. You may obtain a copy of the License at
+//
+// https://opensource.org/licenses/BSD-3-Clause
+//
+// Unless required by applicable law or agreed to in writing, software distributed
+// under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+// CONDITIONS OF ANY KIND, either express or implied. See the License for the
+// specific language governing permissions and limitations under the License.
+
+
+#ifndef TNN_EXAMPLES_BASE_FRAME_GATE_H_
+#define TNN_EXAMPLES_BASE_FRAME_GATE_H_
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+#include "tnn/core/mat.h"
+#include "tnn/core/status.h"
+
+namespace TNN_NS {
+
+struct FrameGateOption {
+    // off by default, every frame runs the network
+    bool enabled = false;
+    // width of the luma signature and its block size
+    int width = 64;
+    int block = 8;
+    // mean absolute luma difference of the most changed block, below it the last output is reused
+    float skip_threshold = 3.0f;
+    // mean absolute luma difference of the whole frame, above it the temporal state is reset
+    float scene_threshold = 40.0f;
+    // consecutive reused frames at most
+    int max_skip = 30;
+};
+
+typedef enum {
+    TNNFrameGateInfer       = 0,
+    TNNFrameGateReuse       = 1,
+    TNNFrameGateSceneChange = 2,
+} TNNFrameGateDecision;
+
+struct FrameGateStat {
+    int64_t frames = 0;
+    int64_t reused = 0;
+    int64_t scene_changes = 0;
+    // inferred only because of max_skip
+    int64_t forced = 0;
+    // the accuracy cost: difference of the reused frames to the frame their output comes from
+    double reused_diff_sum = 0;
+    float reused_diff_max  = 0;
+    // block difference of the last frame
+    float last_diff = 0;
+
+    float GetSkipRate() const {
+        return frames > 0 ? static_cast<float>(reused) / frames : 0.0f;
+    }
+    float GetMeanReusedDiff() const {
+        return reused > 0 ? static_cast<float>(reused_diff_sum / reused) : 0.0f;
+    }
+};
+
+/**
+ * Decides per frame whether the network has to run. A small luma signature of the frame is
+ * compared block by block with the signature of the last inferred frame, so slow drift adds up
+ * until the network runs again and a small moving part is not averaged away.
+ */
+class FrameChangeGate {
+public:
+    FrameChangeGate(FrameGateOption option = FrameGateOption());
+
+    void SetOption(FrameGateOption option);
+    // the next frame is inferred, clears the counters
+    void Reset();
+
+    // N8UC3 or NV21 / NV12 frames, others are always inferred
+    TNNFrameGateDecision Check(std::shared_ptr<Mat> frame);
+    // the last TNNFrameGateReuse could not be served, the frame counts as inferred
+    void Reject();
+
+    FrameGateStat GetStat() const {
+        return stat_;
+    }
+
+private:
+    FrameGateOption option_;
+    FrameGateStat stat_;
+    std::vector<uint8_t> reference_;
+    std::vector<uint8_t> current_;
+    int width_  = 0;
+    int height_ = 0;
+    bool has_reference_ = false;
+    int skipped_ = 0;
+    bool last_reused_ = false;
+};
+
+}  // namespace TNN_NS
+
+#endif  // TNN_EXAMPLES_BASE_FRAME_GATE_H_
@@ -0,0 +1,98 @@
+// Tencent is pleased to support the open source community by making TNN available.
+//
+// Copyright (C) 2020 THL A29 Limited, a Tencent company. All rights reserved.
+//
+// Licensed under the BSD 3-Clause License (the "License"); you may not use this file except
+// in compliance with the License. You may obtain a copy of the License at
+//
+// https://opensource.org/licenses/BSD-3-Clause
+//
+// Unless required by applicable law or agreed to in writing, software distributed
+// under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+// CONDITIONS OF ANY KIND, either express or implied. See the License for the
+// specific language governing permissions and limitations under the License.
+
+#ifndef TNN_EXAMPLES_BASE_FRAME_PYRAMID_H_
+#define TNN_EXAMPLES_BASE_FRAME_PYRAMID_H_
+
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <vector>
+#include "tnn_sdk_sample.h"
+
+namespace TNN_NS {
+
+struct FramePyramidStat {
+    int hits = 0;
+    int misses = 0;
+};
+
+/**
+ * Per frame cache of the resized model inputs, shared by every detector that runs on the
+ * frame, see TNNSDKSample::SetFramePyramid. A level is the frame (or a roi of it) resized or
+ * letterboxed to a size, built on the first request with the requesting detector's operators.
+ * Levels are built outside the lock, so detectors on other threads only wait for the levels
+ * they share.
+ * A level requested again with the same MatConvertParam also caches its float NCHW input for
+ * the later detectors, a level with a single consumer is left to the blob converter. The
+ * returned Mats are views into the cache and must not be written.
+ */
+class FramePyramid {
+public:
+    // a new frame drops all levels of the previous one
+    void SetFrame(std::shared_ptr<Mat> frame);
+    std::shared_ptr<Mat> GetFrame() const {
+        return frame_;
+    }
+    bool IsFrame(std::shared_ptr<Mat> mat) const {
+        return frame_ && mat == frame_;
+    }
+
+    // the roi of the frame resized to width x height, see TNNSDKSample::CropAndResize
+    Status GetResized(TNNSDKSample &sample, const MatROI &roi, int width, int height, std::shared_ptr<Mat> &level);
+    // the roi letterboxed into width x height, see TNNSDKSample::CropAndLetterbox
+    Status GetLetterboxed(TNNSDKSample &sample, const MatROI &roi, int width, int height, std::shared_ptr<Mat> &level,
+                          float &scale, int &dx, int &dy);
+
+    // level normalized like the blob converter would with param, nullptr if level is not cached here
+    // or param was not requested for it before
+    std::shared_ptr<Mat> GetNormalized(std::shared_ptr<Mat> level, const MatConvertParam &param);
+
+    FramePyramidStat GetStat() const;
+
+private:
+    struct Normalized {
+        MatConvertParam param;
+        // built on the second request only
+        std::shared_ptr<Mat> mat;
+    };
+    struct Level {
+        bool letterbox = false;
+        MatROI roi;
+        int width = 0;
+        int height = 0;
+        float scale = 1;
+        int dx = 0;
+        int dy = 0;
+        std::shared_ptr<Mat> mat;
+        std::vector<Normalized> normalized;
+        // set once the first requester has built mat, the others wait for it on cond_
+        bool ready = false;
+        Status status = TNN_OK;
+    };
+
+    Status GetLevel(TNNSDKSample &sample, bool letterbox, const MatROI &roi, int width, int height,
+                    std::shared_ptr<Level> &level);
+
+    std::shared_ptr<Mat> frame_ = nullptr;
+    // a handful per frame, searched linearly
+    std::vector<std::shared_ptr<Level>> levels_;
+    FramePyramidStat stat_;
+    mutable std::mutex mutex_;
+    std::condition_variable cond_;
+};
+
+}  // namespace TNN_NS
+
+#endif  // TNN_EXAMPLES_BASE_FRAME_PYRAMID_H_
@@ -0,0 +1,126 @@
+// Tencent is pleased to support the open source community by making TNN available.
+//
+// Copyright (C) 2020 THL A29 Limited, a Tencent company. All rights reserved.
+//
+// Licensed under the BSD 3-Clause License (the "License"); you may not use this file except
+// in compliance with the License. You may obtain a copy of the License at
+//
+// https://opensource.org/licenses/BSD-3-Clause
+//
+// Unless required by applicable law or agreed to in writing, software distributed
+// under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+// CONDITIONS OF ANY KIND, either express or implied. See the License for the
+// specific language governing permissions and limitations under the License.
+
+
+#ifndef TNN_EXAMPLES_BASE_FRAME_SCHEDULER_H_
+#define TNN_EXAMPLES_BASE_FRAME_SCHEDULER_H_
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "tnn_sdk_sample.h"
+
+namespace TNN_NS {
+
+typedef enum {
+    // run everything, only keep the counters
+    TNNSchedulePolicyNone = 0,
+    // lower the rate of the reusable stages, drop frames once they are all at max_interval
+    TNNSchedulePolicyAdaptive = 1,
+    // drop whole frames only
+    TNNSchedulePolicyDropFrames = 2,
+} TNNSchedulePolicy;
+
+struct FrameSchedulerOption {
+    TNNSchedulePolicy policy = TNNSchedulePolicyAdaptive;
+    float budget_ms = 33.0f;
+    // weight of the newest sample in the cost emas
+    float alpha = 0.2f;
+    // a reusable stage runs at least every max_interval frames
+    int max_interval = 4;
+    // frames between two rate changes, lets the ema settle
+    int hold_frames = 5;
+    // the rate goes up again below budget_ms * recover_ratio
+    float recover_ratio = 0.75f;
+    // consecutive dropped frames at most
+    int max_drop = 1;
+};
+
+struct FrameSchedulerStageStat {
+    std::string name;
+    bool reusable = false;
+    // ema of the time of the runs in ms
+    float cost = 0;
+    int interval = 1;
+    int64_t runs = 0;
+    int64_t reused = 0;
+};
+
+struct FrameSchedulerStat {
+    int64_t frames = 0;
+    int64_t dropped = 0;
+    int64_t over_budget = 0;
+    // rate changes of the reusable stages
+    int64_t slowdowns = 0;
+    int64_t speedups = 0;
+    // ema of the frame time in ms
+    float frame_time = 0;
+    std::vector<FrameSchedulerStageStat> stages;
+};
+
+/**
+ * Keeps a stage cascade within a frame time budget. Every frame BeginFrame decides whether the
+ * frame is dropped and which stages run, reusable stages (their last result stays valid for a
+ * few frames) may run only every interval frames. Stage costs come from AddStageTime, e.g.
+ * TNNSDKStageStat or BenchResult, the frame time from EndFrame. Over budget the most expensive
+ * reusable stage is slowed down, below budget * recover_ratio the cheapest one speeds up again,
+ * frames are dropped when the time over budget adds up to a whole budget.
+ */
+class FrameScheduler {
+public:
+    FrameScheduler(FrameSchedulerOption option = FrameSchedulerOption());
+
+    void SetOption(FrameSchedulerOption option);
+    Status AddStage(const std::string &name, bool reusable);
+    // back to every stage on every frame, clears the counters
+    void Reset();
+
+    // false if the frame should be dropped
+    bool BeginFrame();
+    // the plan of the current frame, unknown stages always run
+    bool ShouldRun(const std::string &name) const;
+    // ignored for stages that were not planned to run
+    void AddStageTime(const std::string &name, float time_ms);
+    void AddStageTimes(const std::vector<TNNSDKStageStat> &stats);
+    void EndFrame(float frame_ms);
+
+    FrameSchedulerStat GetStat() const {
+        return stat_;
+    }
+
+private:
+    struct Stage {
+        std::string name;
+        bool reusable = false;
+        bool has_cost = false;
+        int interval = 1;
+        int since_run = 0;
+        bool planned = true;
+    };
+    int FindStage(const std::string &name) const;
+    void Adapt();
+
+    FrameSchedulerOption option_;
+    std::vector<Stage> stages_;
+    FrameSchedulerStat stat_;
+    // time over budget not paid back by dropped frames yet
+    float debt_ = 0;
+    int drops_ = 0;
+    int hold_ = 0;
+    bool in_frame_ = false;
+};
+
+}  // namespace TNN_NS
+
+#endif  // TNN_EXAMPLES_BASE_FRAME_SCHEDULER_H_
@@ -0,0 +1,82 @@
+// Tencent is pleased to support the open source community by making TNN available.
+//
+// Copyright (C) 2020 THL A29 Limited, a Tencent company. All rights reserved.
+//
+// Licensed under the BSD 3-Clause License (the "License"); you may not use this file except
+// in compliance with the License. You may obtain a copy of the License at
+//
+// https://opensource.org/licenses/BSD-3-Clause
+//
+// Unless required by applicable law or agreed to in writing, software distributed
+// under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+// CONDITIONS OF ANY KIND, either express or implied. See the License for the
+// specific language governing permissions and limitations under the License.
+
+#ifndef TNN_EXAMPLES_BASE_GUIDED_UPSAMPLER_H_
+#define TNN_EXAMPLES_BASE_GUIDED_UPSAMPLER_H_
+
+#include <cstdint>
+#include <vector>
+#include "tnn/core/status.h"
+
+namespace TNN_NS {
+
+/**
+ * Fast guided filter upsampling: refines a low resolution u8 confidence map into a full
+ * resolution alpha that follows the edges of the luma of the full resolution image.
+ * The linear model alpha = a * luma + b is fitted at the resolution of the confidence with
+ * O(1) running sum box filters, a and b are then upsampled bilinearly and applied per pixel.
+ */
+class GuidedUpsampler {
+public:
+    GuidedUpsampler();
+    ~GuidedUpsampler();
+
+    // src: size of the confidence map, dst: size of the guide image and output.
+    // radius in confidence pixels, eps regularises flat regions (confidence and luma in [0, 1])
+    Status Init(int src_width, int src_height, int dst_width, int dst_height, int radius = 2, float eps = 1e-3f);
+
+    // guide: 3 channel u8 image of the dst size, guide_stride in bytes. dst_stride in pixels
+    Status Process(const uint8_t *conf, const uint8_t *guide, int guide_stride, uint8_t *dst, int dst_stride);
+    // writes (alpha << 24) | rgb
+    Status ProcessToARGB(const uint8_t *conf, const uint8_t *guide, int guide_stride, uint32_t *dst, int dst_stride,
+                         uint32_t rgb);
+
+private:
+    Status Run(const uint8_t *conf, const uint8_t *guide, int guide_stride, void *dst, int dst_stride, bool argb,
+               uint32_t rgb);
+    // luma_ at full resolution and its block average at the confidence resolution
+    void ComputeGuide(const uint8_t *guide, int guide_stride);
+    // a_ and b_ of the linear model, already box filtered
+    void ComputeCoefficients(const uint8_t *conf);
+    void BoxFilter(const float *src, float *dst);
+
+    int src_width_  = 0;
+    int src_height_ = 0;
+    int dst_width_  = 0;
+    int dst_height_ = 0;
+    int radius_     = 2;
+    float eps_      = 1e-3f;
+
+    // bilinear taps from dst to src, and the src block of every dst column / row
+    std::vector<int> x0_     = {};
+    std::vector<int> x1_     = {};
+    std::vector<float> wx_   = {};
+    std::vector<int> y0_     = {};
+    std::vector<int> y1_     = {};
+    std::vector<float> wy_   = {};
+    std::vector<int> xbin_   = {};
+    std::vector<int> ybin_   = {};
+
+    std::vector<uint8_t> luma_    = {};
+    std::vector<float> guide_low_ = {};
+    std::vector<float> a_         = {};
+    std::vector<float> b_         = {};
+    // box filter scratch: 4 inputs, 4 means and the column sums
+    std::vector<float> planes_[8] = {};
+    std::vector<float> column_    = {};
+};
+
+}  // namespace TNN_NS
+
+#endif  // TNN_EXAMPLES_BASE_GUIDED_UPSAMPLER_H_
@@ -0,0 +1,55 @@
+// Tencent is pleased to support the open source community by making TNN available.
+//
+// Copyright (C) 2020 THL A29 Limited, a Tencent company. All rights reserved.
+//
+// Licensed under the BSD 3-Clause License (the "License"); you may not use this file except
+// in compliance with the License. You may obtain a copy of the License at
+//
+// https://opensource.org/licenses/BSD-3-Clause
+//
+// Unless required by applicable law or agreed to in writing, software distributed
+// under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+// CONDITIONS OF ANY KIND, either express or implied. See the License for the
+// specific language governing permissions and limitations under the License.
+
+#ifndef TNN_EXAMPLES_BASE_HEATMAP_DECODER_H_
+#define TNN_EXAMPLES_BASE_HEATMAP_DECODER_H_
+
+#include <vector>
+#include "tnn_sdk_sample.h"
+
+namespace TNN_NS {
+
+struct HeatmapPeak {
+    int x = 0;
+    int y = 0;
+    int channel = 0;
+    float score = 0;
+};
+
+/**
+ * CenterNet style peak extraction: a cell is a peak if it is the maximum of its 3x3
+ * neighbourhood in its own channel and above threshold. heatmap holds channels planes of
+ * width * height floats, e.g. one per class. At most top_k peaks are kept, strongest first,
+ * top_k <= 0 keeps all of them.
+ */
+void FindHeatmapPeaks(const float *heatmap, int width, int height, int channels, float threshold, int top_k,
+                      std::vector<HeatmapPeak> &peaks);
+
+/**
+ * dst[i] = the maximum of heatmap[c * size + i] over the channels. Run FindHeatmapPeaks on dst
+ * when the channels are one class, so a centre that fires in several channels is one peak.
+ */
+void MaxHeatmapChannels(const float *heatmap, int size, int channels, float *dst);
+
+/**
+ * Boxes of the peaks in grid units: the centre is the peak cell plus offset, the size is read
+ * from size. offset and size hold an x and a y plane of width * height floats each, either
+ * may be null for zero offsets or empty boxes. class_id is the channel of the peak.
+ */
+void DecodeCenterBoxes(const std::vector<HeatmapPeak> &peaks, const float *offset, const float *size, int width,
+                       int height, std::vector<ObjectInfo> &boxes);
+
+}  // namespace TNN_NS
+
+#endif  // TNN_EXAMPLES_BASE_HEATMAP_DECODER_H_
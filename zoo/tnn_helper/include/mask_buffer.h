@@ -0,0 +1,88 @@
+// Tencent is pleased to support the open source community by making TNN available.
+//
+// Copyright (C) 2020 THL A29 Limited, a Tencent company. All rights reserved.
+//
+// Licensed under the BSD 3-Clause License (the "License"); you may not use this file except
+// in compliance with the License. You may obtain a copy of the License at
+//
+// https://opensource.org/licenses/BSD-3-Clause
+//
+// Unless required by applicable law or agreed to in writing, software distributed
+// under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+// CONDITIONS OF ANY KIND, either express or implied. See the License for the
+// specific language governing permissions and limitations under the License.
+
+#ifndef TNN_EXAMPLES_BASE_MASK_BUFFER_H_
+#define TNN_EXAMPLES_BASE_MASK_BUFFER_H_
+
+#include <cstddef>
+#include <cstdint>
+#include "tnn/core/status.h"
+
+namespace TNN_NS {
+
+typedef enum {
+    // 8 bit alpha
+    TNNMaskFormatA8       = 0,
+    // (alpha << 24) | rgb in a 32 bit word, the layout of the legacy maskData
+    TNNMaskFormatARGB8888 = 1,
+    // class id per pixel, 0 is background
+    TNNMaskFormatClassU8  = 2,
+    // 1 bit per pixel, pixel x of a row is bit x % 8 of byte x / 8
+    TNNMaskFormatBit1     = 3,
+} TNNMaskFormat;
+
+typedef enum {
+    TNNMaskBlendReplace = 0,
+    // only foreground pixels are written: alpha and argb are or-ed, class ids and bits are set
+    TNNMaskBlendOr      = 1,
+} TNNMaskBlend;
+
+/**
+ * Describes where and how a detector writes its mask. The memory belongs to the caller,
+ * data may point into a larger surface as long as stride is the pitch of that surface.
+ */
+struct MaskBuffer {
+    TNNMaskFormat format = TNNMaskFormatARGB8888;
+    // first pixel of the mask
+    void *data = nullptr;
+    // size of the mask in pixels, the detectors expect the size of the input frame
+    int width  = 0;
+    int height = 0;
+    // row pitch in bytes, 0 means tightly packed rows
+    int stride = 0;
+
+    MaskBuffer() {}
+    MaskBuffer(TNNMaskFormat format, void *data, int width, int height, int stride = 0)
+        : format(format), data(data), width(width), height(height), stride(stride) {}
+
+    static int BytesPerRow(TNNMaskFormat format, int width);
+    int GetStride() const;
+    uint8_t *Row(int y) const {
+        return static_cast<uint8_t *>(data) + static_cast<size_t>(y) * GetStride();
+    }
+    // checks the descriptor and that it covers width x height pixels
+    Status Validate(int frame_width, int frame_height) const;
+};
+
+// zero every pixel
+Status ClearMask(const MaskBuffer &dst);
+
+/**
+ * Writes a u8 alpha plane into the roi at (left, top) of dst. ARGB pixels get rgb in the low
+ * bits, class ids get class_id and bits are set where alpha >= threshold.
+ */
+Status WriteAlphaRegion(const MaskBuffer &dst, int left, int top, const uint8_t *alpha, int width, int height,
+                        int alpha_stride, uint32_t rgb, TNNMaskBlend blend = TNNMaskBlendReplace,
+                        uint8_t class_id = 1, uint8_t threshold = 128);
+
+/**
+ * Writes a u8 class id plane into the roi at (left, top) of dst. palette holds the ARGB colour
+ * of every class for ARGB8888 and A8 (its alpha byte), bits are set for non zero classes.
+ */
+Status WriteClassRegion(const MaskBuffer &dst, int left, int top, const uint8_t *classes, int width, int height,
+                        int class_stride, const uint32_t *palette, int num_classes);
+
+}  // namespace TNN_NS
+
+#endif  // TNN_EXAMPLES_BASE_MASK_BUFFER_H_
@@ -0,0 +1,57 @@
+// Tencent is pleased to support the open source community by making TNN available.
+//
+// Copyright (C) 2020 THL A29 Limited, a Tencent company. All rights reserved.
+//
+// Licensed under the BSD 3-Clause License (the "License"); you may not use this file except
+// in compliance with the License. You may obtain a copy of the License at
+//
+// https://opensource.org/licenses/BSD-3-Clause
+//
+// Unless required by applicable law or agreed to in writing, software distributed
+// under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+// CONDITIONS OF ANY KIND, either express or implied. See the License for the
+// specific language governing permissions and limitations under the License.
+
+#ifndef TNN_EXAMPLES_BASE_MASK_CODEC_H_
+#define TNN_EXAMPLES_BASE_MASK_CODEC_H_
+
+#include <cstdint>
+#include <vector>
+#include "mask_buffer.h"
+
+namespace TNN_NS {
+
+struct MaskRleInfo {
+    int width  = 0;
+    int height = 0;
+    // the encoded box, every pixel outside of it is 0
+    int box_x      = 0;
+    int box_y      = 0;
+    int box_width  = 0;
+    int box_height = 0;
+};
+
+/**
+ * Run length coding of u8 masks (alpha, class ids). A 24 byte little endian header
+ * (magic, size, box) is followed by (value, LEB128 length) runs over the box in row major
+ * order, runs continue across rows. With crop_to_box the box is the bounding box of the
+ * non zero pixels, otherwise the whole mask.
+ */
+Status EncodeMaskRle(const uint8_t *mask, int width, int height, int stride, bool crop_to_box,
+                     std::vector<uint8_t> &out);
+
+Status GetMaskRleInfo(const uint8_t *data, size_t size, MaskRleInfo &info);
+
+// decode into a u8 plane of the encoded size
+Status DecodeMaskRle(const uint8_t *data, size_t size, uint8_t *mask, int stride);
+
+/**
+ * decode into a mask buffer of the encoded size. without a palette the values are alpha
+ * (ARGB gets rgb 0xffffff, bits are set from 128), with a palette they are class ids
+ */
+Status DecodeMaskRle(const uint8_t *data, size_t size, const MaskBuffer &dst, const uint32_t *palette = nullptr,
+                     int num_classes = 0);
+
+}  // namespace TNN_NS
+
+#endif  // TNN_EXAMPLES_BASE_MASK_CODEC_H_
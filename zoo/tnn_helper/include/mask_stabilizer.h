@@ -0,0 +1,128 @@
+// Tencent is pleased to support the open source community by making TNN available.
+//
+// Copyright (C) 2020 THL A29 Limited, a Tencent company. All rights reserved.
+//
+// Licensed under the BSD 3-Clause License (the "License"); you may not use this file except
+// in compliance with the License. You may obtain a copy of the License at
+//
+// https://opensource.org/licenses/BSD-3-Clause
+//
+// Unless required by applicable law or agreed to in writing, software distributed
+// under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+// CONDITIONS OF ANY KIND, either express or implied. See the License for the
+// specific language governing permissions and limitations under the License.
+
+#ifndef TNN_EXAMPLES_BASE_MASK_STABILIZER_H_
+#define TNN_EXAMPLES_BASE_MASK_STABILIZER_H_
+
+#include <cstdint>
+#include <vector>
+#include "tnn/core/status.h"
+
+namespace TNN_NS {
+
+typedef enum {
+    // every pixel takes the value most frames of the window agree on, otherwise it keeps the
+    // value of the centre frame. the output lags window / 2 frames behind the input
+    TNNMaskStabilizerMajority   = 0,
+    // a pixel switches only after its new value persisted for window frames, no lag
+    TNNMaskStabilizerHysteresis = 1,
+} TNNMaskStabilizerMode;
+
+/**
+ * Per instance temporal filter for u8 label masks (binary or class masks), replaces the
+ * OFD of the segmentation samples. A window of 3 in majority mode reproduces the old OFD.
+ */
+class MaskStabilizer {
+public:
+    MaskStabilizer();
+    ~MaskStabilizer();
+
+    // size: pixels per mask. window: odd frame count in [3, 15] for majority, [1, 255] for hysteresis
+    Status Init(size_t size, TNNMaskStabilizerMode mode = TNNMaskStabilizerMajority, int window = 3);
+    // a disabled stabilizer passes masks through and drops its history
+    void SetEnabled(bool enabled);
+    bool IsEnabled() const {
+        return enabled_;
+    }
+    // forget the history, e.g. on scene cuts or when the roi changes
+    void Reset();
+
+    // the buffer the next raw mask has to be written into
+    uint8_t *GetInputBuffer();
+    // filter the mask written into GetInputBuffer, valid until the next Process
+    const uint8_t *Process();
+
+    size_t GetSize() const {
+        return size_;
+    }
+
+private:
+    const uint8_t *ProcessMajority();
+    const uint8_t *ProcessHysteresis();
+
+    TNNMaskStabilizerMode mode_ = TNNMaskStabilizerMajority;
+    int window_  = 3;
+    size_t size_ = 0;
+    bool enabled_ = true;
+    int count_    = 0;
+
+    // majority: ring of window frames, head_ is the slot of the newest one
+    std::vector<std::vector<uint8_t>> frames_ = {};
+    int head_ = 0;
+    // hysteresis: stable value, pending value and the frames the pending value lasted
+    std::vector<uint8_t> stable_  = {};
+    std::vector<uint8_t> pending_ = {};
+    std::vector<uint8_t> counter_ = {};
+};
+
+/**
+ * Temporal filter in the confidence domain: an exponential moving average of the u8 quantised
+ * foreground confidence followed by a hysteresis threshold around threshold +- band. Edges
+ * stop flickering because a pixel has to cross the whole band to switch. Per pixel it moves
+ * 5 bytes (confidence in, average and mask in/out) against 4 bytes of the majority-of-3 filter.
+ */
+class ConfidenceStabilizer {
+public:
+    ConfidenceStabilizer();
+    ~ConfidenceStabilizer();
+
+    // alpha: weight of the newest frame in (0, 1]
+    Status Init(size_t size, float alpha = 0.5f, float threshold = 0.5f, float band = 0.05f);
+    // threshold and band in confidence units
+    Status SetThreshold(float threshold, float band);
+    void SetEnabled(bool enabled);
+    bool IsEnabled() const {
+        return enabled_;
+    }
+    void Reset();
+
+    // quantise a float confidence plane into the input buffer, invert uses 1 - conf
+    void Quantize(const float *conf, bool invert = false);
+    // the buffer the next u8 confidence plane has to be written into
+    uint8_t *GetInputBuffer();
+    // update the average and return the 0 / 0xff mask, valid until the next Process
+    const uint8_t *Process(size_t *foreground = nullptr);
+    // the smoothed confidence of the last Process
+    const uint8_t *GetConfidence() const {
+        return average_.data();
+    }
+
+private:
+    size_t size_  = 0;
+    bool enabled_ = true;
+    bool primed_  = false;
+    // ema weight of the newest frame in 1/128 units
+    int alpha_    = 64;
+    uint8_t low_  = 0;
+    uint8_t high_ = 0;
+    uint8_t threshold_ = 0;
+
+    std::vector<uint8_t> input_   = {};
+    std::vector<uint8_t> average_ = {};
+    std::vector<uint8_t> mask_    = {};
+};
+
+}  // namespace TNN_NS
+
+#endif  // TNN_EXAMPLES_BASE_MASK_STABILIZER_H_
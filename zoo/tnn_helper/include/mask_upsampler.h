@@ -0,0 +1,87 @@
+// Tencent is pleased to support the open source community by making TNN available.
+//
+// Copyright (C) 2020 THL A29 Limited, a Tencent company. All rights reserved.
+//
+// Licensed under the BSD 3-Clause License (the "License"); you may not use this file except
+// in compliance with the License. You may obtain a copy of the License at
+//
+// https://opensource.org/licenses/BSD-3-Clause
+//
+// Unless required by applicable law or agreed to in writing, software distributed
+// under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+// CONDITIONS OF ANY KIND, either express or implied. See the License for the
+// specific language governing permissions and limitations under the License.
+
+#ifndef TNN_EXAMPLES_BASE_MASK_UPSAMPLER_H_
+#define TNN_EXAMPLES_BASE_MASK_UPSAMPLER_H_
+
+#include <cstdint>
+#include <vector>
+#include "mask_buffer.h"
+
+namespace TNN_NS {
+
+/**
+ * Bilinear upsampling of a u8 mask straight into the caller's memory, e.g. the roi of an
+ * ARGB frame, without an intermediate full size Mat. Sampling uses pixel centres like
+ * TNNInterpLinear, weights are 7 bit fixed point and the tables are rebuilt only when the
+ * geometry changes.
+ */
+class MaskUpsampler {
+public:
+    MaskUpsampler();
+    ~MaskUpsampler();
+
+    // src: size of the low resolution mask, dst: size of the output roi
+    Status Init(int src_width, int src_height, int dst_width, int dst_height);
+    // dst pixel (x, y) samples src at ((x + 0.5) * scale_x + offset_x - 0.5, same for y), e.g. the
+    // inverse of a crop and scale, samples outside of src are clamped to its edge
+    Status InitMapped(int src_width, int src_height, int dst_width, int dst_height, float scale_x, float offset_x,
+                      float scale_y, float offset_y);
+    // rows of the output are split into bands processed by num_threads threads
+    void SetNumThreads(int num_threads);
+
+    // dst points at the first pixel of the roi, dst_stride is the row pitch in pixels
+    Status Upsample(const uint8_t *src, uint8_t *dst, int dst_stride) const;
+    // writes (alpha << 24) | rgb, rgb is the low 24 bits of the colour
+    Status UpsampleToARGB(const uint8_t *src, uint32_t *dst, int dst_stride, uint32_t rgb) const;
+    // upsample into the roi at (left, top) of a mask buffer in any format, every row is blended
+    // while it is still in cache, see WriteAlphaRegion for rgb, blend, class_id and threshold
+    Status UpsampleToMask(const uint8_t *src, const MaskBuffer &dst, int left, int top, uint32_t rgb,
+                          TNNMaskBlend blend = TNNMaskBlendReplace, uint8_t class_id = 1,
+                          uint8_t threshold = 128) const;
+
+    int GetDstWidth() const {
+        return dst_width_;
+    }
+    int GetDstHeight() const {
+        return dst_height_;
+    }
+
+private:
+    struct Target;
+    void ProcessRows(const uint8_t *src, const Target &target, int y_begin, int y_end) const;
+    Status Run(const uint8_t *src, const Target &target) const;
+
+    int src_width_  = 0;
+    int src_height_ = 0;
+    int dst_width_  = 0;
+    int dst_height_ = 0;
+    int num_threads_ = 1;
+    float scale_x_   = 0;
+    float offset_x_  = 0;
+    float scale_y_   = 0;
+    float offset_y_  = 0;
+
+    // per output column / row: the two source taps and the weight of the second one in 1/128
+    std::vector<int> x0_      = {};
+    std::vector<int> x1_      = {};
+    std::vector<int16_t> wx_  = {};
+    std::vector<int> y0_      = {};
+    std::vector<int> y1_      = {};
+    std::vector<int16_t> wy_  = {};
+};
+
+}  // namespace TNN_NS
+
+#endif  // TNN_EXAMPLES_BASE_MASK_UPSAMPLER_H_
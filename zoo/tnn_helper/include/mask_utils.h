@@ -0,0 +1,81 @@
+// Tencent is pleased to support the open source community by making TNN available.
+//
+// Copyright (C) 2020 THL A29 Limited, a Tencent company. All rights reserved.
+//
+// Licensed under the BSD 3-Clause License (the "License"); you may not use this file except
+// in compliance with the License. You may obtain a copy of the License at
+//
+// https://opensource.org/licenses/BSD-3-Clause
+//
+// Unless required by applicable law or agreed to in writing, software distributed
+// under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+// CONDITIONS OF ANY KIND, either express or implied. See the License for the
+// specific language governing permissions and limitations under the License.
+
+#ifndef TNN_EXAMPLES_BASE_MASK_UTILS_H_
+#define TNN_EXAMPLES_BASE_MASK_UTILS_H_
+
+#include <cstddef>
+#include <cstdint>
+#include "tnn/core/macro.h"
+
+namespace TNN_NS {
+
+// bytes of a bit packed mask with size pixels, pixel i is bit i % 8 of byte i / 8
+inline size_t BitMaskBytes(size_t size) {
+    return (size + 7) / 8;
+}
+
+/**
+ * Threshold a float plane into a 0 / 0xff mask in one pass, every byte of dst is written so
+ * it needs no memset. A pixel is foreground if src < threshold when below is set and
+ * src > threshold otherwise, NaN is always background. Returns the foreground pixel count.
+ */
+size_t ThresholdToMask(const float *src, size_t size, float threshold, bool below, uint8_t *dst);
+
+// u8 plane, foreground if src >= threshold
+size_t ThresholdToMask(const uint8_t *src, size_t size, uint8_t threshold, uint8_t *dst);
+
+/**
+ * Same as ThresholdToMask but emits a bit packed mask of BitMaskBytes(size) bytes, the
+ * padding bits of the last byte are 0.
+ */
+size_t ThresholdToBitMask(const float *src, size_t size, float threshold, bool below, uint8_t *dst);
+
+// bit packed mask to 0 / 0xff bytes
+void UnpackBitMask(const uint8_t *bits, size_t size, uint8_t *dst);
+
+// bytes >= threshold (non zero by default) to a bit packed mask, returns the foreground pixel count
+size_t PackBitMask(const uint8_t *mask, size_t size, uint8_t *bits, uint8_t threshold = 1);
+
+/**
+ * Bounding box of the non zero pixels of a u8 mask, x2 / y2 exclusive.
+ * Returns false and leaves the box untouched if the mask is empty.
+ */
+bool MaskBoundingBox(const uint8_t *mask, int width, int height, int stride, int &x1, int &y1, int &x2, int &y2);
+
+struct MaskClassStat {
+    size_t count = 0;
+    // bounding box of the class, x2 / y2 exclusive, all 0 if the class is absent
+    int x1 = 0;
+    int y1 = 0;
+    int x2 = 0;
+    int y2 = 0;
+};
+
+/**
+ * Per pixel argmax over num_classes (at most 255) planar score planes of width * height, ties
+ * go to the lower class. dst gets codes[class], or the class id without codes. stats, if given,
+ * has num_classes entries and gets the pixel count and bounding box of every class in the same
+ * pass over the rows.
+ */
+void ArgmaxClasses(const float *const *planes, int num_classes, int width, int height, uint8_t *dst,
+                   const uint8_t *codes = nullptr, MaskClassStat *stats = nullptr);
+
+// fp16 planes, converted a row at a time
+void ArgmaxClasses(const uint16_t *const *planes, int num_classes, int width, int height, uint8_t *dst,
+                   const uint8_t *codes = nullptr, MaskClassStat *stats = nullptr);
+
+}  // namespace TNN_NS
+
+#endif  // TNN_EXAMPLES_BASE_MASK_UTILS_H_
@@ -0,0 +1,103 @@
+// Tencent is pleased to support the open source community by making TNN available.
+//
+// Copyright (C) 2020 THL A29 Limited, a Tencent company. All rights reserved.
+//
+// Licensed under the BSD 3-Clause License (the "License"); you may not use this file except
+// in compliance with the License. You may obtain a copy of the License at
+//
+// https://opensource.org/licenses/BSD-3-Clause
+//
+// Unless required by applicable law or agreed to in writing, software distributed
+// under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+// CONDITIONS OF ANY KIND, either express or implied. See the License for the
+// specific language governing permissions and limitations under the License.
+
+
+#ifndef TNN_EXAMPLES_BASE_MOTION_ESTIMATOR_H_
+#define TNN_EXAMPLES_BASE_MOTION_ESTIMATOR_H_
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+#include "tnn_sdk_sample.h"
+
+namespace TNN_NS {
+
+struct MotionEstimatorOption {
+    // width of the downsampled luma plane, the frame is reduced by an integer factor
+    int width = 160;
+    // block size and search range around the global motion, in downsampled pixels
+    int block = 8;
+    int range = 3;
+    // search range of the global motion
+    int global_range = 8;
+    // a block keeps the global motion unless its own vector lowers the sad by this per pixel
+    int block_gain = 2;
+};
+
+// sum of absolute differences of two width x height u8 blocks
+uint32_t BlockSad(const uint8_t *a, int a_stride, const uint8_t *b, int b_stride, int width, int height);
+
+// frame reduced by an integer factor to a u8 luma plane, N8UC3 or NV21 / NV12
+Status DownsampleLuma(std::shared_ptr<Mat> frame, int factor, std::vector<uint8_t> &luma, int &width, int &height);
+
+/**
+ * Cheap motion between consecutive frames for propagating masks while the segmentation is
+ * skipped. Frames are reduced to a small luma plane, one global vector is searched over the
+ * whole plane, then every block refines it within range. Vectors point from the current frame
+ * into the previous one: cur(p) ~ prev(p + v).
+ */
+class MotionEstimator {
+public:
+    MotionEstimator(MotionEstimatorOption option = MotionEstimatorOption());
+
+    void SetOption(MotionEstimatorOption option);
+    // forget the previous frame
+    void Reset();
+
+    // N8UC3 or NV21 / NV12 frames, the previous frame becomes the reference
+    Status AddFrame(std::shared_ptr<Mat> frame);
+    // motion between the last two frames, needs two frames of the same size
+    Status Estimate();
+
+    /**
+     * warps a mask of the previous frame to the current one. the mask covers the roi of the
+     * frame (frame coordinates), samples are nearest so class ids stay intact, pixels moving in
+     * from outside of the roi are 0
+     */
+    Status WarpMask(const uint8_t *src, int mask_width, int mask_height, const MatROI &roi, uint8_t *dst) const;
+
+    // global motion in frame pixels
+    float GetGlobalX() const {
+        return global_x_ * factor_;
+    }
+    float GetGlobalY() const {
+        return global_y_ * factor_;
+    }
+
+private:
+    MotionEstimatorOption option_;
+    int frame_width_  = 0;
+    int frame_height_ = 0;
+    // frame pixels per luma pixel
+    int factor_ = 1;
+    int width_  = 0;
+    int height_ = 0;
+    std::vector<uint8_t> luma_;
+    std::vector<uint8_t> prev_luma_;
+    bool has_frame_ = false;
+    bool has_prev_  = false;
+    bool estimated_ = false;
+
+    int global_x_ = 0;
+    int global_y_ = 0;
+    int blocks_x_ = 0;
+    int blocks_y_ = 0;
+    // per block vector in luma pixels
+    std::vector<int8_t> block_x_;
+    std::vector<int8_t> block_y_;
+};
+
+}  // namespace TNN_NS
+
+#endif  // TNN_EXAMPLES_BASE_MOTION_ESTIMATOR_H_
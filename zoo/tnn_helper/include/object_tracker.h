@@ -0,0 +1,98 @@
+// Tencent is pleased to support the open source community by making TNN available.
+//
+// Copyright (C) 2020 THL A29 Limited, a Tencent company. All rights reserved.
+//
+// Licensed under the BSD 3-Clause License (the "License"); you may not use this file except
+// in compliance with the License. You may obtain a copy of the License at
+//
+// https://opensource.org/licenses/BSD-3-Clause
+//
+// Unless required by applicable law or agreed to in writing, software distributed
+// under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+// CONDITIONS OF ANY KIND, either express or implied. See the License for the
+// specific language governing permissions and limitations under the License.
+
+#ifndef TNN_EXAMPLES_BASE_OBJECT_TRACKER_H_
+#define TNN_EXAMPLES_BASE_OBJECT_TRACKER_H_
+
+#include <vector>
+#include "tnn_sdk_sample.h"
+
+namespace TNN_NS {
+
+struct ObjectTrackerOption {
+    // min IoU between a prediction and a detection to associate them
+    float iou_threshold = 0.3f;
+    // frames a track survives without any matched detection
+    int max_age = 5;
+    // gains of the alpha-beta filter on position and velocity
+    float position_gain = 0.6f;
+    float velocity_gain = 0.3f;
+    // track confidence is multiplied by this factor every predicted frame
+    float confidence_decay = 0.9f;
+};
+
+struct ObjectTrack {
+    int id = 0;
+    // centre and size of the box
+    float cx = 0;
+    float cy = 0;
+    float w  = 0;
+    float h  = 0;
+    // per frame velocity of centre and size
+    float vx = 0;
+    float vy = 0;
+    float vw = 0;
+    float vh = 0;
+
+    float confidence = 0;
+    int class_id = -1;
+    int hits = 0;
+    // frames since the last matched detection
+    int age = 0;
+    // size of the frame the box was last detected on
+    int image_width = 0;
+    int image_height = 0;
+
+    ObjectInfo ToObjectInfo() const;
+};
+
+/**
+ * SORT style multi object tracker: constant velocity prediction, batched IoU association
+ * and greedy assignment. Call Predict() once per frame and Update() on frames where the
+ * detector ran.
+ */
+class ObjectTracker {
+public:
+    ObjectTracker(ObjectTrackerOption option = ObjectTrackerOption());
+
+    void SetOption(ObjectTrackerOption option);
+    void Reset();
+
+    // advance every track by one frame and return the predicted boxes
+    std::vector<ObjectInfo> Predict();
+    // associate detections with the current predictions, returns the boxes confirmed by them
+    std::vector<ObjectInfo> Update(const std::vector<ObjectInfo> &detections);
+
+    // every live track, including the ones kept alive without a match for up to max_age
+    std::vector<ObjectInfo> GetObjects() const;
+    // only the tracks matched or started by the last Update(), advanced by the predictions since
+    std::vector<ObjectInfo> GetConfirmedObjects() const;
+    bool IsEmpty() const;
+    // the lowest confidence of the confirmed tracks, 0 if there is none
+    float GetConfidence() const;
+
+private:
+    bool IsConfirmed(const ObjectTrack &track) const;
+    void ComputeIoUMatrix(const std::vector<ObjectInfo> &detections, std::vector<float> &ious) const;
+
+    ObjectTrackerOption option_;
+    std::vector<ObjectTrack> tracks_ = {};
+    int next_id_ = 0;
+    // Predict() calls since the last Update()
+    int frames_since_update_ = 0;
+};
+
+}  // namespace TNN_NS
+
+#endif  // TNN_EXAMPLES_BASE_OBJECT_TRACKER_H_
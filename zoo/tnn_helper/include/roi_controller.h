@@ -0,0 +1,99 @@
+// Tencent is pleased to support the open source community by making TNN available.
+//
+// Copyright (C) 2020 THL A29 Limited, a Tencent company. All rights reserved.
+//
+// Licensed under the BSD 3-Clause License (the "License"); you may not use this file except
+// in compliance with the License. You may obtain a copy of the License at
+//
+// https://opensource.org/licenses/BSD-3-Clause
+//
+// Unless required by applicable law or agreed to in writing, software distributed
+// under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+// CONDITIONS OF ANY KIND, either express or implied. See the License for the
+// specific language governing permissions and limitations under the License.
+
+#ifndef TNN_EXAMPLES_BASE_ROI_CONTROLLER_H_
+#define TNN_EXAMPLES_BASE_ROI_CONTROLLER_H_
+
+#include <cstdint>
+#include <vector>
+#include "tnn_sdk_sample.h"
+
+namespace TNN_NS {
+
+struct RoiControllerOption {
+    // the target box grows by this fraction of its size on every side
+    float margin = 0.15f;
+    // weight of the new target when the roi shrinks, it expands at once so nothing is cut off
+    float smoothing = 0.2f;
+    // roi sizes are rounded up to multiples of align
+    int align = 16;
+    // a roi within this fraction of the snap size takes exactly the snap size, no resize needed
+    float snap_tolerance = 0.1f;
+    // a roi covering more than this fraction of the frame becomes the full frame
+    float full_frame_ratio = 0.85f;
+    // frames without any target before the roi falls back to the full frame
+    int max_lost = 3;
+};
+
+struct RoiStat {
+    int64_t frames = 0;
+    // pixels fed to the crop against the pixels of the full frames
+    int64_t pixels_processed = 0;
+    int64_t pixels_full = 0;
+
+    float GetSavings() const {
+        return pixels_full > 0 ? 1.0f - static_cast<float>(pixels_processed) / pixels_full : 0.0f;
+    }
+};
+
+/**
+ * Turns per frame target boxes into a stable crop roi: margin, fast expand / slow shrink
+ * smoothing, alignment and snapping to the network input size.
+ */
+class RoiController {
+public:
+    RoiController(RoiControllerOption option = RoiControllerOption());
+
+    void SetOption(RoiControllerOption option);
+    // a new frame size drops the current roi
+    void SetFrameSize(int width, int height);
+    // preferred roi size, usually the network input, 0 disables snapping
+    void SetSnapSize(int width, int height);
+    void Reset();
+
+    // target boxes of the coming frame in frame coordinates, their union is tracked
+    void Update(const std::vector<ObjectInfo> &targets);
+    // no target in this frame
+    void Lost();
+
+    // the roi of the coming frame, counts it in the stats
+    void GetRoi(int &left, int &top, int &width, int &height);
+    bool IsFullFrame() const;
+    RoiStat GetStat() const {
+        return stat_;
+    }
+
+private:
+    void Snap(int &left, int &top, int &width, int &height) const;
+
+    RoiControllerOption option_;
+    int frame_width_  = 0;
+    int frame_height_ = 0;
+    int snap_width_   = 0;
+    int snap_height_  = 0;
+
+    // smoothed roi in frame coordinates, valid_ is false for the full frame
+    bool valid_ = false;
+    float x1_   = 0;
+    float y1_   = 0;
+    float x2_   = 0;
+    float y2_   = 0;
+    int lost_   = 0;
+
+    RoiStat stat_;
+};
+
+}  // namespace TNN_NS
+
+#endif  // TNN_EXAMPLES_BASE_ROI_CONTROLLER_H_
@@ -19,10 +19,15 @@
 #include <fstream>
 #include <sstream>
 #include <chrono>
+#include <functional>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
 #include "tnn/core/macro.h"
 #include "tnn/core/tnn.h"
 #include "tnn/utils/blob_converter.h"
 #include "tnn/utils/mat_utils.h"
+#include "frame_gate.h"
 
 #define TNN_SDK_ENABLE_BENCHMARK 1
 
@@ -145,6 +150,8 @@ public:
     std::string library_path = "";
     TNNComputeUnits compute_units = TNNComputeUnitsCPU;
     InputShapesMap input_shapes = {};
+    // reuse the last output while the frame does not change, see ReuseLastOutput
+    FrameGateOption frame_gate;
 };
 
 typedef enum {
@@ -159,6 +166,21 @@ typedef enum {
     
 } TNNBorderType;
 
+// a window of an image in pixels, it may extend beyond the image, the outside reads as border
+struct MatROI {
+    int left = 0;
+    int top = 0;
+    int width = 0;
+    int height = 0;
+};
+
+class FramePyramid;
+
+// camera frames, Resize, Crop, WarpAffine and friends convert them to N8UC3 only where they are sampled
+inline bool IsYUV420sp(std::shared_ptr<Mat> mat) {
+    return mat && (mat->GetMatType() == NNV21 || mat->GetMatType() == NNV12);
+}
+
 class TNNSDKSample {
 public:
     TNNSDKSample();
@@ -189,13 +211,34 @@ public:
     Status WarpAffine(std::shared_ptr<TNN_NS::Mat> src, std::shared_ptr<TNN_NS::Mat> dst, TNNInterpType interp_type, TNNBorderType border_type, float trans_mat[2][3]);
     Status Copy(std::shared_ptr<TNN_NS::Mat> src, std::shared_ptr<TNN_NS::Mat> dst);
     Status ResizeAndMakeBorder(std::shared_ptr<TNN_NS::Mat> src, std::shared_ptr<TNN_NS::Mat> dst);
+    // Crop + Resize in one resampling pass straight from src, there is no intermediate crop Mat
+    Status CropAndResize(std::shared_ptr<TNN_NS::Mat> src, std::shared_ptr<TNN_NS::Mat> dst, const MatROI &roi, TNNInterpType interp_type);
+    // Crop + ResizeAndMakeBorder in one pass, the roi keeps its aspect ratio and lands at (dx, dy) of dst with scale
+    Status CropAndLetterbox(std::shared_ptr<TNN_NS::Mat> src, std::shared_ptr<TNN_NS::Mat> dst, const MatROI &roi, float &scale, int &dx, int &dy);
+
+    // share the resized and normalized inputs of a frame with the other detectors run on it, nullptr stops sharing
+    void SetFramePyramid(std::shared_ptr<FramePyramid> pyramid);
+    FrameGateStat GetFrameGateStat() const {
+        return frame_gate_.GetStat();
+    }
 protected:
+    // output of a frame the gate found unchanged, the results of the last inferred frame stay. any
+    // status except TNN_OK and TNNERR_NO_RESULT runs the network instead, like the default does
+    virtual Status ReuseLastOutput(std::shared_ptr<TNNSDKOutput> &output);
+    // drop the history of temporal filters and trackers, called on a scene change
+    virtual void ResetTemporalState();
+
     BenchOption bench_option_;
     BenchResult bench_result_;
 
     std::vector<std::string> GetInputNames();
     std::vector<std::string> GetOutputNames();
     std::shared_ptr<Mat> ResizeToInputShape(std::shared_ptr<Mat> input_mat, std::string name);
+    // CropAndResize / CropAndLetterbox into a new Mat of dims, served by the frame pyramid if src is its frame
+    std::shared_ptr<Mat> ResizeFromFrame(std::shared_ptr<Mat> src, const MatROI &roi, DimsVector dims);
+    std::shared_ptr<Mat> LetterboxFromFrame(std::shared_ptr<Mat> src, const MatROI &roi, DimsVector dims, float &scale, int &dx, int &dy);
+    // instance_->SetInputMat, a pyramid level requested again with the same param gets the shared normalized input
+    Status SetInstanceInput(std::shared_ptr<Mat> mat, MatConvertParam param, std::string name = "");
     
 protected:
     std::shared_ptr<TNN> net_             = nullptr;
@@ -204,6 +247,28 @@ protected:
     DeviceType device_type_               = DEVICE_ARM;
     std::string model_path_str_           = "";
     bool check_npu_                       = false;
+    std::shared_ptr<FramePyramid> pyramid_ = nullptr;
+    FrameChangeGate frame_gate_;
+};
+
+// a node of the TNNSDKComposeSample graph, TNNERR_NO_RESULT from run means the stage found nothing
+struct TNNSDKStage {
+    std::string name;
+    // stages whose results this one reads, it is skipped if any of them failed, found nothing or was skipped
+    std::vector<std::string> inputs;
+    // stages that only have to finish first, e.g. because they write the same output
+    std::vector<std::string> after;
+    std::function<Status(std::shared_ptr<TNNSDKInput>)> run;
+};
+
+struct TNNSDKStageStat {
+    std::string name;
+    // ms since the start of the run
+    float start = 0;
+    float time = 0;
+    bool skipped = false;
+    // on the chain of stages that determined the total time
+    bool critical = false;
 };
 
 class TNNSDKComposeSample : public TNNSDKSample {
@@ -216,10 +281,40 @@ public:
     virtual DimsVector GetInputShape(std::string name = kTNNSDKDefaultName);
     virtual Status Predict(std::shared_ptr<TNNSDKInput> input, std::shared_ptr<TNNSDKOutput> &output);
     virtual Status GetCommandQueue(void **command_queue);
-    
+
+    // stages may only depend on stages added before them, so the graph has no cycles
+    Status AddStage(const TNNSDKStage &stage);
+    // independent stages run concurrently on up to num_threads threads, the caller of Predict and
+    // num_threads - 1 workers owned by the sample
+    void SetNumThreads(int num_threads);
+    // per stage timing of the last RunStages in the order of AddStage
+    const std::vector<TNNSDKStageStat> &GetStageStats() const {
+        return stage_stats_;
+    }
+
 protected:
+    // runs every stage once the stages it depends on are done, returns the first error other
+    // than TNNERR_NO_RESULT
+    Status RunStages(std::shared_ptr<TNNSDKInput> input);
+
     std::vector<std::shared_ptr<TNNSDKSample>> sdks_ = {};
-    
+    std::vector<TNNSDKStage> stages_ = {};
+    std::vector<TNNSDKStageStat> stage_stats_ = {};
+    int num_threads_ = 1;
+
+private:
+    struct StageRun;
+    void StopWorkers();
+    void WorkerLoop();
+    // runs the ready stages of the current RunStages, called with stage_mutex_ held
+    void RunReadyStages(std::unique_lock<std::mutex> &lock);
+
+    std::vector<std::thread> workers_ = {};
+    std::mutex stage_mutex_;
+    std::condition_variable stage_cond_;
+    // the RunStages in flight, nullptr while the workers are idle
+    StageRun *stage_run_ = nullptr;
+    bool stop_workers_ = false;
 };
 
 typedef enum {
@@ -0,0 +1,36 @@
+// Tencent is pleased to support the open source community by making TNN available.
+//
+// Copyright (C) 2020 THL A29 Limited, a Tencent company. All rights reserved.
+//
+// Licensed under the BSD 3-Clause License (the "License"); you may not use this file except
+// in compliance with the License. You may obtain a copy of the License at
+//
+// https://opensource.org/licenses/BSD-3-Clause
+//
+// Unless required by applicable law or agreed to in writing, software distributed
+// under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+// CONDITIONS OF ANY KIND, either express or implied. See the License for the
+// specific language governing permissions and limitations under the License.
+
+#ifndef TNN_EXAMPLES_BASE_YUV_UTILS_H_
+#define TNN_EXAMPLES_BASE_YUV_UTILS_H_
+
+#include <cstdint>
+#include "tnn/core/status.h"
+
+namespace TNN_NS {
+
+/**
+ * Fused NV21 / NV12 to BGR conversion and bilinear resampling, only the pixels of the frame
+ * that are sampled are converted. dst pixel (x, y) samples the frame at
+ * ((x + 0.5) * scale_x + offset_x - 0.5, (y + 0.5) * scale_y + offset_y - 0.5), samples
+ * outside of the frame are black. Chroma is taken from the nearest 2x2 block, the colour
+ * conversion is the full range one of yuv420sp_to_bgr_fast_asm. dst_stride is in bytes.
+ */
+Status YUV420spToBGRMapped(const uint8_t *yuv, int width, int height, bool nv21, uint8_t *bgr, int dst_width,
+                           int dst_height, int dst_stride, float scale_x, float offset_x, float scale_y,
+                           float offset_y);
+
+}  // namespace TNN_NS
+
+#endif  // TNN_EXAMPLES_BASE_YUV_UTILS_H_
@@ -0,0 +1,49 @@
+// Tencent is pleased to support the open source community by making TNN available.
+//
+// Copyright (C) 2020 THL A29 Limited, a Tencent company. All rights reserved.
+//
+// Licensed under the BSD 3-Clause License (the "License"); you may not use this file except
+// in compliance with the License. You may obtain a copy of the License at
+//
+// https://opensource.org/licenses/BSD-3-Clause
+//
+// Unless required by applicable law or agreed to in writing, software distributed
+// under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+// CONDITIONS OF ANY KIND, either express or implied. See the License for the
+// specific language governing permissions and limitations under the License.
+
+#include "affine_utils.h"
+#include <algorithm>
+#include <cmath>
+
+namespace TNN_NS {
+
+float LetterboxTransform(float x, float y, float width, float height, int dst_width, int dst_height,
+                         float m[2][3]) {
+    const float scale = std::min(dst_width / std::max(width, 1e-6f), dst_height / std::max(height, 1e-6f));
+    m[0][0] = scale;
+    m[0][1] = 0;
+    m[0][2] = dst_width * 0.5f - (x + width * 0.5f) * scale;
+    m[1][0] = 0;
+    m[1][1] = scale;
+    m[1][2] = dst_height * 0.5f - (y + height * 0.5f) * scale;
+    return scale;
+}
+
+bool InvertAffine(const float m[2][3], float inv[2][3]) {
+    const double det = (double)m[0][0] * m[1][1] - (double)m[0][1] * m[1][0];
+    if (std::fabs(det) < 1e-12) {
+        return false;
+    }
+    const double a = m[1][1] / det, b = -m[0][1] / det;
+    const double c = -m[1][0] / det, d = m[0][0] / det;
+    inv[0][0] = static_cast<float>(a);
+    inv[0][1] = static_cast<float>(b);
+    inv[0][2] = static_cast<float>(-(a * m[0][2] + b * m[1][2]));
+    inv[1][0] = static_cast<float>(c);
+    inv[1][1] = static_cast<float>(d);
+    inv[1][2] = static_cast<float>(-(c * m[0][2] + d * m[1][2]));
+    return true;
+}
+
+}  // namespace TNN_NS
@@ -0,0 +1,106 @@
+// Tencent is pleased to support the open source community by making TNN available.
+//
+// Copyright (C) 2020 THL A29 Limited, a Tencent company. All rights reserved.
+//
+// Licensed under the BSD 3-Clause License (the "License"); you may not use this file except
+// in compliance with the License. You may obtain a copy of the License at
+//
+// https://opensource.org/licenses/BSD-3-Clause
+//
+// Unless required by applicable law or agreed to in writing, software distributed
+// under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+// CONDITIONS OF ANY KIND, either express or implied. See the License for the
+// specific language governing permissions and limitations under the License.
+
+
+#include "frame_gate.h"
+#include <algorithm>
+#include "motion_estimator.h"
+
+namespace TNN_NS {
+
+FrameChangeGate::FrameChangeGate(FrameGateOption option) {
+    SetOption(option);
+}
+
+void FrameChangeGate::SetOption(FrameGateOption option) {
+    option.width = std::max(option.width, 8);
+    option.block = std::max(option.block, 2);
+    option_      = option;
+    Reset();
+}
+
+void FrameChangeGate::Reset() {
+    has_reference_ = false;
+    skipped_       = 0;
+    stat_          = FrameGateStat();
+}
+
+TNNFrameGateDecision FrameChangeGate::Check(std::shared_ptr<Mat> frame) {
+    stat_.frames++;
+    last_reused_ = false;
+    int width = 0, height = 0;
+    const int factor = frame ? std::max(1, frame->GetWidth() / option_.width) : 1;
+    if (DownsampleLuma(frame, factor, current_, width, height) != TNN_OK) {
+        has_reference_ = false;
+        return TNNFrameGateInfer;
+    }
+    if (!has_reference_ || width != width_ || height != height_) {
+        width_  = width;
+        height_ = height;
+        current_.swap(reference_);
+        has_reference_ = true;
+        skipped_       = 0;
+        return TNNFrameGateInfer;
+    }
+
+    // mean difference of the most changed block and of the whole signature
+    const int b      = option_.block;
+    uint64_t total   = 0;
+    float block_diff = 0;
+    for (int y = 0; y < height_; y += b) {
+        for (int x = 0; x < width_; x += b) {
+            const int bw = std::min(b, width_ - x), bh = std::min(b, height_ - y);
+            const size_t offset = static_cast<size_t>(y) * width_ + x;
+            uint32_t sad = BlockSad(current_.data() + offset, width_, reference_.data() + offset, width_, bw, bh);
+            total += sad;
+            block_diff = std::max(block_diff, static_cast<float>(sad) / (bw * bh));
+        }
+    }
+    const float frame_diff = static_cast<float>(total) / (width_ * height_);
+    stat_.last_diff        = block_diff;
+
+    if (frame_diff > option_.scene_threshold) {
+        current_.swap(reference_);
+        skipped_ = 0;
+        stat_.scene_changes++;
+        return TNNFrameGateSceneChange;
+    }
+    if (block_diff < option_.skip_threshold) {
+        if (skipped_ < option_.max_skip) {
+            skipped_++;
+            stat_.reused++;
+            stat_.reused_diff_sum += block_diff;
+            stat_.reused_diff_max = std::max(stat_.reused_diff_max, block_diff);
+            last_reused_ = true;
+            return TNNFrameGateReuse;
+        }
+        stat_.forced++;
+    }
+    current_.swap(reference_);
+    skipped_ = 0;
+    return TNNFrameGateInfer;
+}
+
+void FrameChangeGate::Reject() {
+    if (!last_reused_) {
+        return;
+    }
+    last_reused_ = false;
+    stat_.reused--;
+    stat_.reused_diff_sum -= stat_.last_diff;
+    current_.swap(reference_);
+    skipped_ = 0;
+}
+
+}  // namespace TNN_NS
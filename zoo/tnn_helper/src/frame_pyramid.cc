@@ -0,0 +1,164 @@
+// Tencent is pleased to support the open source community by making TNN available.
+//
+// Copyright (C) 2020 THL A29 Limited, a Tencent company. All rights reserved.
+//
+// Licensed under the BSD 3-Clause License (the "License"); you may not use this file except
+// in compliance with the License. You may obtain a copy of the License at
+//
+// https://opensource.org/licenses/BSD-3-Clause
+//
+// Unless required by applicable law or agreed to in writing, software distributed
+// under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+// CONDITIONS OF ANY KIND, either express or implied. See the License for the
+// specific language governing permissions and limitations under the License.
+
+#include "frame_pyramid.h"
+#include <algorithm>
+
+namespace TNN_NS {
+
+namespace {
+
+bool SameROI(const MatROI &a, const MatROI &b) {
+    return a.left == b.left && a.top == b.top && a.width == b.width && a.height == b.height;
+}
+
+bool SameParam(const MatConvertParam &a, const MatConvertParam &b) {
+    return a.scale == b.scale && a.bias == b.bias && a.reverse_channel == b.reverse_channel;
+}
+
+}  // namespace
+
+void FramePyramid::SetFrame(std::shared_ptr<Mat> frame) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    frame_ = frame;
+    levels_.clear();
+}
+
+Status FramePyramid::GetLevel(TNNSDKSample &sample, bool letterbox, const MatROI &roi, int width, int height,
+                              std::shared_ptr<Level> &level) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    if (!frame_) {
+        return Status(TNNERR_PARAM_ERR, "frame pyramid has no frame");
+    }
+    for (auto &cached : levels_) {
+        if (cached->letterbox == letterbox && cached->width == width && cached->height == height &&
+            SameROI(cached->roi, roi)) {
+            stat_.hits++;
+            // keep the level alive even if SetFrame drops it while it is being built
+            std::shared_ptr<Level> waited = cached;
+            cond_.wait(lock, [&]() { return waited->ready; });
+            RETURN_ON_NEQ(waited->status, TNN_OK);
+            level = waited;
+            return TNN_OK;
+        }
+    }
+
+    // publish the level before building it, the build itself runs unlocked
+    auto built = std::make_shared<Level>();
+    built->letterbox = letterbox;
+    built->roi = roi;
+    built->width = width;
+    built->height = height;
+    levels_.push_back(built);
+    auto frame = frame_;
+    lock.unlock();
+
+    DimsVector dims = {1, 3, height, width};
+    built->mat = std::make_shared<Mat>(frame->GetDeviceType(), N8UC3, dims);
+    auto status = letterbox ? sample.CropAndLetterbox(frame, built->mat, roi, built->scale, built->dx, built->dy)
+                            : sample.CropAndResize(frame, built->mat, roi, TNNInterpLinear);
+
+    lock.lock();
+    built->status = status;
+    built->ready = true;
+    if (status == TNN_OK) {
+        stat_.misses++;
+    } else {
+        // the waiters get the error, later requests try again
+        levels_.erase(std::remove(levels_.begin(), levels_.end(), built), levels_.end());
+    }
+    cond_.notify_all();
+    RETURN_ON_NEQ(status, TNN_OK);
+    level = built;
+    return TNN_OK;
+}
+
+FramePyramidStat FramePyramid::GetStat() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return stat_;
+}
+
+Status FramePyramid::GetResized(TNNSDKSample &sample, const MatROI &roi, int width, int height,
+                                std::shared_ptr<Mat> &level) {
+    std::shared_ptr<Level> cached = nullptr;
+    auto status = GetLevel(sample, false, roi, width, height, cached);
+    RETURN_ON_NEQ(status, TNN_OK);
+    level = cached->mat;
+    return TNN_OK;
+}
+
+Status FramePyramid::GetLetterboxed(TNNSDKSample &sample, const MatROI &roi, int width, int height,
+                                    std::shared_ptr<Mat> &level, float &scale, int &dx, int &dy) {
+    std::shared_ptr<Level> cached = nullptr;
+    auto status = GetLevel(sample, true, roi, width, height, cached);
+    RETURN_ON_NEQ(status, TNN_OK);
+    level = cached->mat;
+    scale = cached->scale;
+    dx = cached->dx;
+    dy = cached->dy;
+    return TNN_OK;
+}
+
+std::shared_ptr<Mat> FramePyramid::GetNormalized(std::shared_ptr<Mat> level, const MatConvertParam &param) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (!level || param.scale.size() < 3 || param.bias.size() < 3) {
+        return nullptr;
+    }
+    for (auto &entry : levels_) {
+        Level &cached = *entry;
+        if (!cached.ready || cached.mat != level) {
+            continue;
+        }
+        Normalized *requested = nullptr;
+        for (auto &normalized : cached.normalized) {
+            if (SameParam(normalized.param, param)) {
+                requested = &normalized;
+                break;
+            }
+        }
+        if (!requested) {
+            // the first consumer converts on its own, a float copy only pays off once it is shared
+            Normalized normalized;
+            normalized.param = param;
+            cached.normalized.push_back(normalized);
+            return nullptr;
+        }
+        if (requested->mat) {
+            stat_.hits++;
+            return requested->mat;
+        }
+
+        // dst[c] = src[c] * scale[c] + bias[c], src channels reversed first like the blob converter
+        const int plane = cached.width * cached.height;
+        DimsVector dims = {1, 3, cached.height, cached.width};
+        auto mat = std::make_shared<Mat>(level->GetDeviceType(), NCHW_FLOAT, dims);
+        const uint8_t *src = (const uint8_t *)level->GetData();
+        float *dst = (float *)mat->GetData();
+        for (int c = 0; c < 3; ++c) {
+            const int sc = param.reverse_channel ? 2 - c : c;
+            const float scale = param.scale[c];
+            const float bias = param.bias[c];
+            float *out = dst + c * plane;
+            for (int i = 0; i < plane; ++i) {
+                out[i] = src[i * 3 + sc] * scale + bias;
+            }
+        }
+        stat_.misses++;
+        requested->mat = mat;
+        return mat;
+    }
+    return nullptr;
+}
+
+}  // namespace TNN_NS
@@ -0,0 +1,189 @@
+// Tencent is pleased to support the open source community by making TNN available.
+//
+// Copyright (C) 2020 THL A29 Limited, a Tencent company. All rights reserved.
+//
+// Licensed under the BSD 3-Clause License (the "License"); you may not use this file except
+// in compliance with the License. You may obtain a copy of the License at
+//
+// https://opensource.org/licenses/BSD-3-Clause
+//
+// Unless required by applicable law or agreed to in writing, software distributed
+// under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+// CONDITIONS OF ANY KIND, either express or implied. See the License for the
+// specific language governing permissions and limitations under the License.
+
+
+#include "frame_scheduler.h"
+#include <algorithm>
+
+namespace TNN_NS {
+
+FrameScheduler::FrameScheduler(FrameSchedulerOption option) : option_(option) {}
+
+void FrameScheduler::SetOption(FrameSchedulerOption option) {
+    option_ = option;
+    Reset();
+}
+
+Status FrameScheduler::AddStage(const std::string &name, bool reusable) {
+    if (name.empty() || FindStage(name) >= 0) {
+        return Status(TNNERR_PARAM_ERR, "frame scheduler stage name is empty or added twice");
+    }
+    Stage stage;
+    stage.name     = name;
+    stage.reusable = reusable;
+    stages_.push_back(stage);
+    FrameSchedulerStageStat stat;
+    stat.name     = name;
+    stat.reusable = reusable;
+    stat_.stages.push_back(stat);
+    return TNN_OK;
+}
+
+void FrameScheduler::Reset() {
+    FrameSchedulerStat stat;
+    for (auto &stage : stages_) {
+        stage.has_cost  = false;
+        stage.interval  = 1;
+        stage.since_run = 0;
+        stage.planned   = true;
+        FrameSchedulerStageStat stage_stat;
+        stage_stat.name     = stage.name;
+        stage_stat.reusable = stage.reusable;
+        stat.stages.push_back(stage_stat);
+    }
+    stat_     = stat;
+    debt_     = 0;
+    drops_    = 0;
+    hold_     = 0;
+    in_frame_ = false;
+}
+
+int FrameScheduler::FindStage(const std::string &name) const {
+    for (size_t i = 0; i < stages_.size(); ++i) {
+        if (stages_[i].name == name) {
+            return static_cast<int>(i);
+        }
+    }
+    return -1;
+}
+
+bool FrameScheduler::BeginFrame() {
+    bool may_drop = option_.policy == TNNSchedulePolicyDropFrames;
+    if (option_.policy == TNNSchedulePolicyAdaptive) {
+        // only once nothing is left to slow down
+        may_drop = std::none_of(stages_.begin(), stages_.end(), [&](const Stage &s) {
+            return s.reusable && s.interval < option_.max_interval;
+        });
+    }
+    if (may_drop && debt_ >= option_.budget_ms && drops_ < option_.max_drop) {
+        debt_ -= option_.budget_ms;
+        drops_++;
+        stat_.dropped++;
+        in_frame_ = false;
+        return false;
+    }
+    drops_ = 0;
+
+    for (size_t i = 0; i < stages_.size(); ++i) {
+        auto &stage = stages_[i];
+        // a stage without a result yet always runs
+        stage.planned = !stage.reusable || stat_.stages[i].runs == 0 || stage.since_run + 1 >= stage.interval;
+        if (stage.planned) {
+            stage.since_run = 0;
+            stat_.stages[i].runs++;
+        } else {
+            stage.since_run++;
+            stat_.stages[i].reused++;
+        }
+    }
+    stat_.frames++;
+    in_frame_ = true;
+    return true;
+}
+
+bool FrameScheduler::ShouldRun(const std::string &name) const {
+    int i = FindStage(name);
+    return i < 0 || stages_[i].planned;
+}
+
+void FrameScheduler::AddStageTime(const std::string &name, float time_ms) {
+    int i = FindStage(name);
+    if (i < 0 || !stages_[i].planned) {
+        return;
+    }
+    float &cost = stat_.stages[i].cost;
+    cost = stages_[i].has_cost ? cost + (time_ms - cost) * option_.alpha : time_ms;
+    stages_[i].has_cost = true;
+}
+
+void FrameScheduler::AddStageTimes(const std::vector<TNNSDKStageStat> &stats) {
+    for (const auto &stat : stats) {
+        if (!stat.skipped) {
+            AddStageTime(stat.name, stat.time);
+        }
+    }
+}
+
+void FrameScheduler::EndFrame(float frame_ms) {
+    if (!in_frame_) {
+        return;
+    }
+    in_frame_ = false;
+    stat_.frame_time = stat_.frames > 1 ? stat_.frame_time + (frame_ms - stat_.frame_time) * option_.alpha : frame_ms;
+    if (frame_ms > option_.budget_ms) {
+        stat_.over_budget++;
+    }
+    // a frame under budget pays back, but does not build up credit
+    debt_ = std::max(debt_ + frame_ms - option_.budget_ms, 0.0f);
+    if (option_.policy == TNNSchedulePolicyAdaptive) {
+        Adapt();
+    }
+}
+
+void FrameScheduler::Adapt() {
+    if (hold_ > 0) {
+        hold_--;
+        return;
+    }
+    const float frame_time = stat_.frame_time;
+    int pick = -1;
+    if (frame_time > option_.budget_ms) {
+        // the largest saving first
+        for (size_t i = 0; i < stages_.size(); ++i) {
+            if (stages_[i].reusable && stages_[i].interval < option_.max_interval &&
+                (pick < 0 || stat_.stages[i].cost > stat_.stages[pick].cost)) {
+                pick = static_cast<int>(i);
+            }
+        }
+        if (pick >= 0) {
+            stages_[pick].interval++;
+            stat_.slowdowns++;
+        }
+    } else if (frame_time < option_.budget_ms * option_.recover_ratio) {
+        // the smallest risk first
+        for (size_t i = 0; i < stages_.size(); ++i) {
+            if (stages_[i].reusable && stages_[i].interval > 1 &&
+                (pick < 0 || stat_.stages[i].cost < stat_.stages[pick].cost)) {
+                pick = static_cast<int>(i);
+            }
+        }
+        // only if the frame time with the extra runs still stays below the threshold
+        if (pick >= 0) {
+            const int k = stages_[pick].interval;
+            float extra = stat_.stages[pick].cost * (1.0f / (k - 1) - 1.0f / k);
+            if (frame_time + extra < option_.budget_ms * option_.recover_ratio) {
+                stages_[pick].interval--;
+                stat_.speedups++;
+            } else {
+                pick = -1;
+            }
+        }
+    }
+    if (pick >= 0) {
+        stat_.stages[pick].interval = stages_[pick].interval;
+        hold_ = option_.hold_frames;
+    }
+}
+
+}  // namespace TNN_NS
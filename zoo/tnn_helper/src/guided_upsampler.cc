@@ -0,0 +1,384 @@
+// Tencent is pleased to support the open source community by making TNN available.
+//
+// Copyright (C) 2020 THL A29 Limited, a Tencent company. All rights reserved.
+//
+// Licensed under the BSD 3-Clause License (the "License"); you may not use this file except
+// in compliance with the License. You may obtain a copy of the License at
+//
+// https://opensource.org/licenses/BSD-3-Clause
+//
+// Unless required by applicable law or agreed to in writing, software distributed
+// under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+// CONDITIONS OF ANY KIND, either express or implied. See the License for the
+// specific language governing permissions and limitations under the License.
+
+#include "guided_upsampler.h"
+#include <algorithm>
+#include <cmath>
+
+#if defined(TNN_USE_NEON)
+#include <arm_neon.h>
+#endif
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+namespace TNN_NS {
+
+namespace {
+
+void BuildTable(int src_size, int dst_size, std::vector<int> &i0, std::vector<int> &i1, std::vector<float> &w) {
+    i0.resize(dst_size);
+    i1.resize(dst_size);
+    w.resize(dst_size);
+    const float scale = static_cast<float>(src_size) / dst_size;
+    for (int d = 0; d < dst_size; ++d) {
+        float f = (d + 0.5f) * scale - 0.5f;
+        int s   = static_cast<int>(std::floor(f));
+        float t = f - s;
+        if (s < 0) {
+            s = 0;
+            t = 0;
+        }
+        if (s >= src_size - 1) {
+            s = src_size - 1;
+            t = 0;
+        }
+        i0[d] = s;
+        i1[d] = std::min(s + 1, src_size - 1);
+        w[d]  = t;
+    }
+}
+
+void BuildBins(int src_size, int dst_size, std::vector<int> &bins) {
+    bins.resize(dst_size);
+    for (int d = 0; d < dst_size; ++d) {
+        bins[d] = std::min(static_cast<int>(static_cast<int64_t>(d) * src_size / dst_size), src_size - 1);
+    }
+}
+
+// BGR order, swapping R and B barely changes the guide
+void LumaRow(const uint8_t *bgr, uint8_t *luma, int width) {
+    int x = 0;
+#if defined(TNN_USE_NEON)
+    const uint8x8_t wb = vdup_n_u8(29);
+    const uint8x8_t wg = vdup_n_u8(150);
+    const uint8x8_t wr = vdup_n_u8(77);
+    for (; x + 8 <= width; x += 8) {
+        uint8x8x3_t v = vld3_u8(bgr + 3 * x);
+        uint16x8_t s  = vmlal_u8(vmlal_u8(vmull_u8(v.val[0], wb), v.val[1], wg), v.val[2], wr);
+        vst1_u8(luma + x, vrshrn_n_u16(s, 8));
+    }
+#endif
+    for (; x < width; ++x) {
+        const uint8_t *p = bgr + 3 * x;
+        luma[x]          = static_cast<uint8_t>((p[0] * 29 + p[1] * 150 + p[2] * 77 + 128) >> 8);
+    }
+}
+
+void AddRow(float *acc, const float *row, int width, float sign) {
+    int x = 0;
+#if defined(TNN_USE_NEON)
+    const float32x4_t vs = vdupq_n_f32(sign);
+    for (; x + 4 <= width; x += 4) {
+        vst1q_f32(acc + x, vmlaq_f32(vld1q_f32(acc + x), vld1q_f32(row + x), vs));
+    }
+#elif defined(__SSE2__)
+    const __m128 vs = _mm_set1_ps(sign);
+    for (; x + 4 <= width; x += 4) {
+        _mm_storeu_ps(acc + x, _mm_add_ps(_mm_loadu_ps(acc + x), _mm_mul_ps(_mm_loadu_ps(row + x), vs)));
+    }
+#endif
+    for (; x < width; ++x) {
+        acc[x] += row[x] * sign;
+    }
+}
+
+// out[x] = a0[x] + (a1[x] - a0[x]) * w
+void LerpRow(const float *a0, const float *a1, float w, float *out, int width) {
+    int x = 0;
+#if defined(TNN_USE_NEON)
+    const float32x4_t vw = vdupq_n_f32(w);
+    for (; x + 4 <= width; x += 4) {
+        float32x4_t v0 = vld1q_f32(a0 + x);
+        vst1q_f32(out + x, vmlaq_f32(v0, vsubq_f32(vld1q_f32(a1 + x), v0), vw));
+    }
+#elif defined(__SSE2__)
+    const __m128 vw = _mm_set1_ps(w);
+    for (; x + 4 <= width; x += 4) {
+        __m128 v0 = _mm_loadu_ps(a0 + x);
+        _mm_storeu_ps(out + x, _mm_add_ps(v0, _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(a1 + x), v0), vw)));
+    }
+#endif
+    for (; x < width; ++x) {
+        out[x] = a0[x] + (a1[x] - a0[x]) * w;
+    }
+}
+
+// alpha = clamp(a * luma + b), written as gray or into the alpha byte of ARGB pixels
+void ApplyRow(const float *a, const float *b, const uint8_t *luma, void *dst, int width, bool argb, uint32_t rgb) {
+    uint8_t *gray  = static_cast<uint8_t *>(dst);
+    uint32_t *pixel = static_cast<uint32_t *>(dst);
+    int x          = 0;
+#if defined(TNN_USE_NEON)
+    const float32x4_t vzero = vdupq_n_f32(0.0f);
+    const float32x4_t vmax  = vdupq_n_f32(255.0f);
+    const float32x4_t vhalf = vdupq_n_f32(0.5f);
+    const uint32x4_t vrgb   = vdupq_n_u32(rgb);
+    for (; x + 8 <= width; x += 8) {
+        uint16x8_t l  = vmovl_u8(vld1_u8(luma + x));
+        float32x4_t lo = vmlaq_f32(vld1q_f32(b + x), vld1q_f32(a + x), vcvtq_f32_u32(vmovl_u16(vget_low_u16(l))));
+        float32x4_t hi =
+            vmlaq_f32(vld1q_f32(b + x + 4), vld1q_f32(a + x + 4), vcvtq_f32_u32(vmovl_u16(vget_high_u16(l))));
+        uint32x4_t ilo = vcvtq_u32_f32(vminq_f32(vmaxq_f32(vaddq_f32(lo, vhalf), vzero), vmax));
+        uint32x4_t ihi = vcvtq_u32_f32(vminq_f32(vmaxq_f32(vaddq_f32(hi, vhalf), vzero), vmax));
+        if (argb) {
+            vst1q_u32(pixel + x, vorrq_u32(vshlq_n_u32(ilo, 24), vrgb));
+            vst1q_u32(pixel + x + 4, vorrq_u32(vshlq_n_u32(ihi, 24), vrgb));
+        } else {
+            vst1_u8(gray + x, vmovn_u16(vcombine_u16(vmovn_u32(ilo), vmovn_u32(ihi))));
+        }
+    }
+#elif defined(__SSE2__)
+    const __m128 vzero  = _mm_setzero_ps();
+    const __m128 vmax   = _mm_set1_ps(255.0f);
+    const __m128 vhalf  = _mm_set1_ps(0.5f);
+    const __m128i vrgb  = _mm_set1_epi32(static_cast<int>(rgb));
+    const __m128i izero = _mm_setzero_si128();
+    for (; x + 8 <= width; x += 8) {
+        __m128i l   = _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i *)(luma + x)), izero);
+        __m128 flo  = _mm_cvtepi32_ps(_mm_unpacklo_epi16(l, izero));
+        __m128 fhi  = _mm_cvtepi32_ps(_mm_unpackhi_epi16(l, izero));
+        __m128 lo   = _mm_add_ps(_mm_mul_ps(_mm_loadu_ps(a + x), flo), _mm_loadu_ps(b + x));
+        __m128 hi   = _mm_add_ps(_mm_mul_ps(_mm_loadu_ps(a + x + 4), fhi), _mm_loadu_ps(b + x + 4));
+        __m128i ilo = _mm_cvttps_epi32(_mm_min_ps(_mm_max_ps(_mm_add_ps(lo, vhalf), vzero), vmax));
+        __m128i ihi = _mm_cvttps_epi32(_mm_min_ps(_mm_max_ps(_mm_add_ps(hi, vhalf), vzero), vmax));
+        if (argb) {
+            _mm_storeu_si128((__m128i *)(pixel + x), _mm_or_si128(_mm_slli_epi32(ilo, 24), vrgb));
+            _mm_storeu_si128((__m128i *)(pixel + x + 4), _mm_or_si128(_mm_slli_epi32(ihi, 24), vrgb));
+        } else {
+            __m128i v = _mm_packs_epi32(ilo, ihi);
+            _mm_storel_epi64((__m128i *)(gray + x), _mm_packus_epi16(v, v));
+        }
+    }
+#endif
+    for (; x < width; ++x) {
+        float v     = std::min(std::max(a[x] * luma[x] + b[x] + 0.5f, 0.0f), 255.0f);
+        uint32_t iv = static_cast<uint32_t>(v);
+        if (argb) {
+            pixel[x] = (iv << 24) | rgb;
+        } else {
+            gray[x] = static_cast<uint8_t>(iv);
+        }
+    }
+}
+
+}  // namespace
+
+GuidedUpsampler::GuidedUpsampler() {}
+
+GuidedUpsampler::~GuidedUpsampler() {}
+
+Status GuidedUpsampler::Init(int src_width, int src_height, int dst_width, int dst_height, int radius, float eps) {
+    if (src_width <= 0 || src_height <= 0 || dst_width <= 0 || dst_height <= 0) {
+        return Status(TNNERR_PARAM_ERR, "guided upsampler size must be positive");
+    }
+    if (radius < 1 || eps <= 0) {
+        return Status(TNNERR_PARAM_ERR, "guided upsampler needs radius >= 1 and eps > 0");
+    }
+    if (src_width != src_width_ || dst_width != dst_width_) {
+        BuildTable(src_width, dst_width, x0_, x1_, wx_);
+        BuildBins(src_width, dst_width, xbin_);
+    }
+    if (src_height != src_height_ || dst_height != dst_height_) {
+        BuildTable(src_height, dst_height, y0_, y1_, wy_);
+        BuildBins(src_height, dst_height, ybin_);
+    }
+    src_width_  = src_width;
+    src_height_ = src_height;
+    dst_width_  = dst_width;
+    dst_height_ = dst_height;
+    radius_     = radius;
+    eps_        = eps;
+
+    const size_t src_size = static_cast<size_t>(src_width) * src_height;
+    luma_.resize(static_cast<size_t>(dst_width) * dst_height);
+    guide_low_.resize(src_size);
+    a_.resize(src_size);
+    b_.resize(src_size);
+    for (auto &plane : planes_) {
+        plane.resize(src_size);
+    }
+    column_.resize(src_width);
+    return TNN_OK;
+}
+
+Status GuidedUpsampler::Process(const uint8_t *conf, const uint8_t *guide, int guide_stride, uint8_t *dst,
+                                int dst_stride) {
+    return Run(conf, guide, guide_stride, dst, dst_stride, false, 0);
+}
+
+Status GuidedUpsampler::ProcessToARGB(const uint8_t *conf, const uint8_t *guide, int guide_stride, uint32_t *dst,
+                                      int dst_stride, uint32_t rgb) {
+    return Run(conf, guide, guide_stride, dst, dst_stride, true, rgb & 0xffffff);
+}
+
+void GuidedUpsampler::ComputeGuide(const uint8_t *guide, int guide_stride) {
+    std::fill(guide_low_.begin(), guide_low_.end(), 0.0f);
+    std::vector<int> xcount(src_width_, 0);
+    std::vector<int> ycount(src_height_, 0);
+    for (int x = 0; x < dst_width_; ++x) {
+        xcount[xbin_[x]]++;
+    }
+    for (int y = 0; y < dst_height_; ++y) {
+        ycount[ybin_[y]]++;
+    }
+
+    for (int y = 0; y < dst_height_; ++y) {
+        uint8_t *luma = luma_.data() + static_cast<size_t>(y) * dst_width_;
+        LumaRow(guide + static_cast<size_t>(y) * guide_stride, luma, dst_width_);
+        float *low = guide_low_.data() + static_cast<size_t>(ybin_[y]) * src_width_;
+        for (int x = 0; x < dst_width_; ++x) {
+            low[xbin_[x]] += luma[x];
+        }
+    }
+
+    // block average in [0, 1], blocks without any pixel (dst smaller than src) take the nearest one
+    for (int by = 0; by < src_height_; ++by) {
+        float *low = guide_low_.data() + static_cast<size_t>(by) * src_width_;
+        int ny     = std::min(static_cast<int>(static_cast<int64_t>(by) * dst_height_ / src_height_), dst_height_ - 1);
+        for (int bx = 0; bx < src_width_; ++bx) {
+            int count = xcount[bx] * ycount[by];
+            if (count > 0) {
+                low[bx] /= count * 255.0f;
+            } else {
+                int nx  = std::min(static_cast<int>(static_cast<int64_t>(bx) * dst_width_ / src_width_), dst_width_ - 1);
+                low[bx] = luma_[static_cast<size_t>(ny) * dst_width_ + nx] / 255.0f;
+            }
+        }
+    }
+}
+
+/*
+ * mean over the (2r+1)^2 window clipped to the image, O(1) per pixel:
+ * column sums are updated by one SIMD row add and subtract, rows slide a running sum
+ */
+void GuidedUpsampler::BoxFilter(const float *src, float *dst) {
+    const int w = src_width_;
+    const int h = src_height_;
+    const int r = radius_;
+    std::fill(column_.begin(), column_.end(), 0.0f);
+    for (int y = 0; y <= std::min(r, h - 1); ++y) {
+        AddRow(column_.data(), src + static_cast<size_t>(y) * w, w, 1.0f);
+    }
+    for (int y = 0; y < h; ++y) {
+        const float inv_y = 1.0f / (std::min(h - 1, y + r) - std::max(0, y - r) + 1);
+        float *out        = dst + static_cast<size_t>(y) * w;
+        float sum         = 0;
+        for (int x = 0; x <= std::min(r, w - 1); ++x) {
+            sum += column_[x];
+        }
+        for (int x = 0; x < w; ++x) {
+            out[x] = sum * inv_y / (std::min(w - 1, x + r) - std::max(0, x - r) + 1);
+            if (x + r + 1 < w) {
+                sum += column_[x + r + 1];
+            }
+            if (x - r >= 0) {
+                sum -= column_[x - r];
+            }
+        }
+        if (y + r + 1 < h) {
+            AddRow(column_.data(), src + static_cast<size_t>(y + r + 1) * w, w, 1.0f);
+        }
+        if (y - r >= 0) {
+            AddRow(column_.data(), src + static_cast<size_t>(y - r) * w, w, -1.0f);
+        }
+    }
+}
+
+void GuidedUpsampler::ComputeCoefficients(const uint8_t *conf) {
+    const size_t size = static_cast<size_t>(src_width_) * src_height_;
+    const float *I    = guide_low_.data();
+    float *p          = planes_[0].data();
+    float *Ip         = planes_[1].data();
+    float *II         = planes_[2].data();
+    for (size_t i = 0; i < size; ++i) {
+        p[i]  = conf[i] * (1.0f / 255.0f);
+        Ip[i] = I[i] * p[i];
+        II[i] = I[i] * I[i];
+    }
+    float *mean_I  = planes_[4].data();
+    float *mean_p  = planes_[5].data();
+    float *mean_Ip = planes_[6].data();
+    float *mean_II = planes_[7].data();
+    BoxFilter(I, mean_I);
+    BoxFilter(p, mean_p);
+    BoxFilter(Ip, mean_Ip);
+    BoxFilter(II, mean_II);
+
+    float *a = planes_[0].data();
+    float *b = planes_[1].data();
+    for (size_t i = 0; i < size; ++i) {
+        float var_I  = mean_II[i] - mean_I[i] * mean_I[i];
+        float cov_Ip = mean_Ip[i] - mean_I[i] * mean_p[i];
+        a[i]         = cov_Ip / (var_I + eps_);
+        b[i]         = mean_p[i] - a[i] * mean_I[i];
+    }
+    BoxFilter(a, a_.data());
+    BoxFilter(b, b_.data());
+
+    // alpha in [0, 255] from luma in [0, 255]: a stays, b scales by 255
+    for (size_t i = 0; i < size; ++i) {
+        b_[i] *= 255.0f;
+    }
+}
+
+Status GuidedUpsampler::Run(const uint8_t *conf, const uint8_t *guide, int guide_stride, void *dst, int dst_stride,
+                            bool argb, uint32_t rgb) {
+    if (dst_width_ <= 0) {
+        return Status(TNNERR_PARAM_ERR, "guided upsampler is not initialized");
+    }
+    if (!conf || !guide || !dst || guide_stride < 3 * dst_width_ || dst_stride < dst_width_) {
+        return Status(TNNERR_PARAM_ERR, "guided upsampler got an invalid buffer");
+    }
+
+    ComputeGuide(guide, guide_stride);
+    ComputeCoefficients(conf);
+
+    // horizontally interpolated a / b rows of two source rows, reused by consecutive output rows
+    std::vector<float> rows_a[2] = {std::vector<float>(dst_width_), std::vector<float>(dst_width_)};
+    std::vector<float> rows_b[2] = {std::vector<float>(dst_width_), std::vector<float>(dst_width_)};
+    std::vector<float> line_a(dst_width_);
+    std::vector<float> line_b(dst_width_);
+    int row_index[2] = {-1, -1};
+    auto get_row     = [&](int sy, int keep) -> int {
+        for (int k = 0; k < 2; ++k) {
+            if (row_index[k] == sy) {
+                return k;
+            }
+        }
+        int slot        = row_index[0] == keep ? 1 : 0;
+        const float *sa = a_.data() + static_cast<size_t>(sy) * src_width_;
+        const float *sb = b_.data() + static_cast<size_t>(sy) * src_width_;
+        for (int x = 0; x < dst_width_; ++x) {
+            rows_a[slot][x] = sa[x0_[x]] + (sa[x1_[x]] - sa[x0_[x]]) * wx_[x];
+            rows_b[slot][x] = sb[x0_[x]] + (sb[x1_[x]] - sb[x0_[x]]) * wx_[x];
+        }
+        row_index[slot] = sy;
+        return slot;
+    };
+
+    for (int y = 0; y < dst_height_; ++y) {
+        int s0 = get_row(y0_[y], y1_[y]);
+        int s1 = get_row(y1_[y], y0_[y]);
+        LerpRow(rows_a[s0].data(), rows_a[s1].data(), wy_[y], line_a.data(), dst_width_);
+        LerpRow(rows_b[s0].data(), rows_b[s1].data(), wy_[y], line_b.data(), dst_width_);
+        const uint8_t *luma = luma_.data() + static_cast<size_t>(y) * dst_width_;
+        void *out = argb ? static_cast<void *>(static_cast<uint32_t *>(dst) + static_cast<size_t>(y) * dst_stride)
+                         : static_cast<void *>(static_cast<uint8_t *>(dst) + static_cast<size_t>(y) * dst_stride);
+        ApplyRow(line_a.data(), line_b.data(), luma, out, dst_width_, argb, rgb);
+    }
+    return TNN_OK;
+}
+
+}  // namespace TNN_NS
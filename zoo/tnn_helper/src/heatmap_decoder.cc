@@ -0,0 +1,188 @@
+// Tencent is pleased to support the open source community by making TNN available.
+//
+// Copyright (C) 2020 THL A29 Limited, a Tencent company. All rights reserved.
+//
+// Licensed under the BSD 3-Clause License (the "License"); you may not use this file except
+// in compliance with the License. You may obtain a copy of the License at
+//
+// https://opensource.org/licenses/BSD-3-Clause
+//
+// Unless required by applicable law or agreed to in writing, software distributed
+// under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+// CONDITIONS OF ANY KIND, either express or implied. See the License for the
+// specific language governing permissions and limitations under the License.
+
+#include "heatmap_decoder.h"
+#include <algorithm>
+#include <limits>
+
+#if defined(TNN_USE_NEON)
+#include <arm_neon.h>
+#endif
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+namespace TNN_NS {
+
+namespace {
+
+// dst[x] = max(src[x - 1], src[x], src[x + 1]), the row is padded with -inf
+void HorizontalMax(const float *src, int width, float *dst) {
+    if (width == 1) {
+        dst[0] = src[0];
+        return;
+    }
+    dst[0] = std::max(src[0], src[1]);
+    int x  = 1;
+#if defined(TNN_USE_NEON)
+    for (; x + 4 < width; x += 4) {
+        float32x4_t m = vmaxq_f32(vld1q_f32(src + x - 1), vld1q_f32(src + x));
+        vst1q_f32(dst + x, vmaxq_f32(m, vld1q_f32(src + x + 1)));
+    }
+#elif defined(__SSE2__)
+    for (; x + 4 < width; x += 4) {
+        __m128 m = _mm_max_ps(_mm_loadu_ps(src + x - 1), _mm_loadu_ps(src + x));
+        _mm_storeu_ps(dst + x, _mm_max_ps(m, _mm_loadu_ps(src + x + 1)));
+    }
+#endif
+    for (; x < width - 1; ++x) {
+        dst[x] = std::max(std::max(src[x - 1], src[x]), src[x + 1]);
+    }
+    dst[width - 1] = std::max(src[width - 2], src[width - 1]);
+}
+
+// appends the cells of row that equal the 3x3 maximum and are above threshold
+void RowPeaks(const float *row, const float *h0, const float *h1, const float *h2, int width, float threshold, int y,
+              int channel, std::vector<HeatmapPeak> &peaks) {
+    auto push = [&](int x) {
+        HeatmapPeak peak;
+        peak.x       = x;
+        peak.y       = y;
+        peak.channel = channel;
+        peak.score   = row[x];
+        peaks.push_back(peak);
+    };
+    int x = 0;
+#if defined(TNN_USE_NEON)
+    const float32x4_t vthr = vdupq_n_f32(threshold);
+    for (; x + 4 <= width; x += 4) {
+        float32x4_t v = vld1q_f32(row + x);
+        float32x4_t m = vmaxq_f32(vmaxq_f32(vld1q_f32(h0 + x), vld1q_f32(h1 + x)), vld1q_f32(h2 + x));
+        uint32x4_t hit = vandq_u32(vceqq_f32(v, m), vcgtq_f32(v, vthr));
+        uint32x2_t any = vorr_u32(vget_low_u32(hit), vget_high_u32(hit));
+        if (vget_lane_u64(vreinterpret_u64_u32(any), 0) == 0) {
+            continue;
+        }
+        for (int k = 0; k < 4; ++k) {
+            if (row[x + k] > threshold && row[x + k] == std::max(std::max(h0[x + k], h1[x + k]), h2[x + k])) {
+                push(x + k);
+            }
+        }
+    }
+#elif defined(__SSE2__)
+    const __m128 vthr = _mm_set1_ps(threshold);
+    for (; x + 4 <= width; x += 4) {
+        __m128 v = _mm_loadu_ps(row + x);
+        __m128 m = _mm_max_ps(_mm_max_ps(_mm_loadu_ps(h0 + x), _mm_loadu_ps(h1 + x)), _mm_loadu_ps(h2 + x));
+        int hit  = _mm_movemask_ps(_mm_and_ps(_mm_cmpeq_ps(v, m), _mm_cmpgt_ps(v, vthr)));
+        while (hit) {
+            int k = __builtin_ctz(hit);
+            push(x + k);
+            hit &= hit - 1;
+        }
+    }
+#endif
+    for (; x < width; ++x) {
+        if (row[x] > threshold && row[x] == std::max(std::max(h0[x], h1[x]), h2[x])) {
+            push(x);
+        }
+    }
+}
+
+}  // namespace
+
+void FindHeatmapPeaks(const float *heatmap, int width, int height, int channels, float threshold, int top_k,
+                      std::vector<HeatmapPeak> &peaks) {
+    peaks.clear();
+    if (!heatmap || width <= 0 || height <= 0 || channels <= 0) {
+        return;
+    }
+    // three horizontally pooled rows, the one above and below the border is -inf
+    std::vector<float> pooled(3 * width);
+    std::vector<float> border(width, -std::numeric_limits<float>::infinity());
+    for (int c = 0; c < channels; ++c) {
+        const float *plane = heatmap + static_cast<size_t>(c) * width * height;
+        HorizontalMax(plane, width, pooled.data());
+        for (int y = 0; y < height; ++y) {
+            const float *above = y > 0 ? pooled.data() + ((y - 1) % 3) * width : border.data();
+            const float *here  = pooled.data() + (y % 3) * width;
+            const float *below = border.data();
+            if (y + 1 < height) {
+                HorizontalMax(plane + static_cast<size_t>(y + 1) * width, width,
+                              pooled.data() + ((y + 1) % 3) * width);
+                below = pooled.data() + ((y + 1) % 3) * width;
+            }
+            RowPeaks(plane + static_cast<size_t>(y) * width, above, here, below, width, threshold, y, c, peaks);
+        }
+    }
+
+    auto stronger = [](const HeatmapPeak &a, const HeatmapPeak &b) {
+        return a.score > b.score;
+    };
+    if (top_k > 0 && static_cast<int>(peaks.size()) > top_k) {
+        std::partial_sort(peaks.begin(), peaks.begin() + top_k, peaks.end(), stronger);
+        peaks.resize(top_k);
+    } else {
+        std::sort(peaks.begin(), peaks.end(), stronger);
+    }
+}
+
+void MaxHeatmapChannels(const float *heatmap, int size, int channels, float *dst) {
+    if (!heatmap || size <= 0 || channels <= 0) {
+        return;
+    }
+    std::copy(heatmap, heatmap + size, dst);
+    for (int c = 1; c < channels; ++c) {
+        const float *plane = heatmap + static_cast<size_t>(c) * size;
+        int i              = 0;
+#if defined(TNN_USE_NEON)
+        for (; i + 4 <= size; i += 4) {
+            vst1q_f32(dst + i, vmaxq_f32(vld1q_f32(dst + i), vld1q_f32(plane + i)));
+        }
+#elif defined(__SSE2__)
+        for (; i + 4 <= size; i += 4) {
+            _mm_storeu_ps(dst + i, _mm_max_ps(_mm_loadu_ps(dst + i), _mm_loadu_ps(plane + i)));
+        }
+#endif
+        for (; i < size; ++i) {
+            dst[i] = std::max(dst[i], plane[i]);
+        }
+    }
+}
+
+void DecodeCenterBoxes(const std::vector<HeatmapPeak> &peaks, const float *offset, const float *size, int width,
+                       int height, std::vector<ObjectInfo> &boxes) {
+    boxes.clear();
+    const size_t plane = static_cast<size_t>(width) * height;
+    for (const auto &peak : peaks) {
+        const size_t i = static_cast<size_t>(peak.y) * width + peak.x;
+        float cx = peak.x + (offset ? offset[i] : 0.0f);
+        float cy = peak.y + (offset ? offset[i + plane] : 0.0f);
+        float w  = size ? size[i] : 0.0f;
+        float h  = size ? size[i + plane] : 0.0f;
+
+        ObjectInfo box;
+        box.image_width  = width;
+        box.image_height = height;
+        box.x1           = cx - w / 2;
+        box.y1           = cy - h / 2;
+        box.x2           = cx + w / 2;
+        box.y2           = cy + h / 2;
+        box.score        = peak.score;
+        box.class_id     = peak.channel;
+        boxes.push_back(box);
+    }
+}
+
+}  // namespace TNN_NS
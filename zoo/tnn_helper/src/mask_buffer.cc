@@ -0,0 +1,218 @@
+// Tencent is pleased to support the open source community by making TNN available.
+//
+// Copyright (C) 2020 THL A29 Limited, a Tencent company. All rights reserved.
+//
+// Licensed under the BSD 3-Clause License (the "License"); you may not use this file except
+// in compliance with the License. You may obtain a copy of the License at
+//
+// https://opensource.org/licenses/BSD-3-Clause
+//
+// Unless required by applicable law or agreed to in writing, software distributed
+// under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+// CONDITIONS OF ANY KIND, either express or implied. See the License for the
+// specific language governing permissions and limitations under the License.
+
+#include "mask_buffer.h"
+#include <cstring>
+#include <vector>
+#include "mask_utils.h"
+
+namespace TNN_NS {
+
+namespace {
+
+inline void SetBit(uint8_t *row, int x, bool value) {
+    if (value) {
+        row[x >> 3] |= 1 << (x & 7);
+    } else {
+        row[x >> 3] &= ~(1 << (x & 7));
+    }
+}
+
+/*
+ * bits [left, left + width) of row = src >= threshold, or-ed in unless replace. the whole bytes
+ * are packed 16 pixels at a time, only the unaligned head and tail bits are set one by one.
+ * scratch holds width / 8 bytes
+ */
+void WriteBitRow(uint8_t *row, int left, const uint8_t *src, int width, uint8_t threshold, bool replace,
+                 uint8_t *scratch) {
+    int x = 0;
+    for (; x < width && ((left + x) & 7) != 0; ++x) {
+        bool fg = src[x] >= threshold;
+        if (fg || replace) {
+            SetBit(row, left + x, fg);
+        }
+    }
+    const int bytes = (width - x) >> 3;
+    if (bytes > 0) {
+        uint8_t *dst = row + ((left + x) >> 3);
+        if (replace) {
+            PackBitMask(src + x, bytes * 8, dst, threshold);
+        } else {
+            PackBitMask(src + x, bytes * 8, scratch, threshold);
+            for (int b = 0; b < bytes; ++b) {
+                dst[b] |= scratch[b];
+            }
+        }
+        x += bytes * 8;
+    }
+    for (; x < width; ++x) {
+        bool fg = src[x] >= threshold;
+        if (fg || replace) {
+            SetBit(row, left + x, fg);
+        }
+    }
+}
+
+Status CheckRegion(const MaskBuffer &dst, int left, int top, const void *src, int width, int height) {
+    if (!dst.data || !src) {
+        return Status(TNNERR_PARAM_ERR, "mask buffer or source is null");
+    }
+    if (left < 0 || top < 0 || width < 0 || height < 0 || left + width > dst.width || top + height > dst.height) {
+        return Status(TNNERR_PARAM_ERR, "mask region is out of the mask buffer");
+    }
+    return TNN_OK;
+}
+
+}  // namespace
+
+int MaskBuffer::BytesPerRow(TNNMaskFormat format, int width) {
+    switch (format) {
+        case TNNMaskFormatARGB8888:
+            return width * 4;
+        case TNNMaskFormatBit1:
+            return (width + 7) / 8;
+        default:
+            return width;
+    }
+}
+
+int MaskBuffer::GetStride() const {
+    return stride > 0 ? stride : BytesPerRow(format, width);
+}
+
+Status MaskBuffer::Validate(int frame_width, int frame_height) const {
+    if (!data) {
+        return Status(TNNERR_PARAM_ERR, "mask buffer has no memory");
+    }
+    if (width != frame_width || height != frame_height) {
+        return Status(TNNERR_PARAM_ERR, "mask buffer size differs from the input frame");
+    }
+    if (GetStride() < BytesPerRow(format, width)) {
+        return Status(TNNERR_PARAM_ERR, "mask buffer stride is smaller than a row");
+    }
+    if (format == TNNMaskFormatARGB8888 && GetStride() % 4 != 0) {
+        return Status(TNNERR_PARAM_ERR, "ARGB8888 mask buffer stride must be a multiple of 4");
+    }
+    return TNN_OK;
+}
+
+Status ClearMask(const MaskBuffer &dst) {
+    if (!dst.data) {
+        return Status(TNNERR_PARAM_ERR, "mask buffer has no memory");
+    }
+    const int row_bytes = MaskBuffer::BytesPerRow(dst.format, dst.width);
+    for (int y = 0; y < dst.height; ++y) {
+        memset(dst.Row(y), 0, row_bytes);
+    }
+    return TNN_OK;
+}
+
+Status WriteAlphaRegion(const MaskBuffer &dst, int left, int top, const uint8_t *alpha, int width, int height,
+                        int alpha_stride, uint32_t rgb, TNNMaskBlend blend, uint8_t class_id, uint8_t threshold) {
+    auto status = CheckRegion(dst, left, top, alpha, width, height);
+    if (status != TNN_OK) {
+        return status;
+    }
+    rgb &= 0xffffff;
+    const bool replace = blend == TNNMaskBlendReplace;
+    // or-ed bit rows are packed here first
+    std::vector<uint8_t> scratch(dst.format == TNNMaskFormatBit1 && !replace ? width / 8 + 1 : 0);
+    for (int y = 0; y < height; ++y) {
+        const uint8_t *a = alpha + static_cast<size_t>(y) * alpha_stride;
+        uint8_t *row     = dst.Row(top + y);
+        switch (dst.format) {
+            case TNNMaskFormatA8: {
+                uint8_t *d = row + left;
+                if (replace) {
+                    memcpy(d, a, width);
+                } else {
+                    for (int x = 0; x < width; ++x) {
+                        d[x] |= a[x];
+                    }
+                }
+                break;
+            }
+            case TNNMaskFormatARGB8888: {
+                uint32_t *d = reinterpret_cast<uint32_t *>(row) + left;
+                if (replace) {
+                    for (int x = 0; x < width; ++x) {
+                        d[x] = (static_cast<uint32_t>(a[x]) << 24) | rgb;
+                    }
+                } else {
+                    for (int x = 0; x < width; ++x) {
+                        if (a[x]) {
+                            d[x] |= (static_cast<uint32_t>(a[x]) << 24) | rgb;
+                        }
+                    }
+                }
+                break;
+            }
+            case TNNMaskFormatClassU8: {
+                uint8_t *d = row + left;
+                for (int x = 0; x < width; ++x) {
+                    if (a[x] >= threshold) {
+                        d[x] = class_id;
+                    } else if (replace) {
+                        d[x] = 0;
+                    }
+                }
+                break;
+            }
+            case TNNMaskFormatBit1:
+                WriteBitRow(row, left, a, width, threshold, replace, scratch.data());
+                break;
+        }
+    }
+    return TNN_OK;
+}
+
+Status WriteClassRegion(const MaskBuffer &dst, int left, int top, const uint8_t *classes, int width, int height,
+                        int class_stride, const uint32_t *palette, int num_classes) {
+    auto status = CheckRegion(dst, left, top, classes, width, height);
+    if (status != TNN_OK) {
+        return status;
+    }
+    if (!palette && (dst.format == TNNMaskFormatARGB8888 || dst.format == TNNMaskFormatA8)) {
+        return Status(TNNERR_PARAM_ERR, "class mask needs a palette for colour output");
+    }
+    for (int y = 0; y < height; ++y) {
+        const uint8_t *c = classes + static_cast<size_t>(y) * class_stride;
+        uint8_t *row     = dst.Row(top + y);
+        switch (dst.format) {
+            case TNNMaskFormatA8: {
+                uint8_t *d = row + left;
+                for (int x = 0; x < width; ++x) {
+                    d[x] = c[x] < num_classes ? static_cast<uint8_t>(palette[c[x]] >> 24) : 0;
+                }
+                break;
+            }
+            case TNNMaskFormatARGB8888: {
+                uint32_t *d = reinterpret_cast<uint32_t *>(row) + left;
+                for (int x = 0; x < width; ++x) {
+                    d[x] = c[x] < num_classes ? palette[c[x]] : 0;
+                }
+                break;
+            }
+            case TNNMaskFormatClassU8:
+                memcpy(row + left, c, width);
+                break;
+            case TNNMaskFormatBit1:
+                WriteBitRow(row, left, c, width, 1, true, nullptr);
+                break;
+        }
+    }
+    return TNN_OK;
+}
+
+}  // namespace TNN_NS
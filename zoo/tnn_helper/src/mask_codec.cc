@@ -0,0 +1,244 @@
+// Tencent is pleased to support the open source community by making TNN available.
+//
+// Copyright (C) 2020 THL A29 Limited, a Tencent company. All rights reserved.
+//
+// Licensed under the BSD 3-Clause License (the "License"); you may not use this file except
+// in compliance with the License. You may obtain a copy of the License at
+//
+// https://opensource.org/licenses/BSD-3-Clause
+//
+// Unless required by applicable law or agreed to in writing, software distributed
+// under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+// CONDITIONS OF ANY KIND, either express or implied. See the License for the
+// specific language governing permissions and limitations under the License.
+
+#include "mask_codec.h"
+#include <algorithm>
+#include <cstring>
+#include "mask_utils.h"
+
+#if defined(TNN_USE_NEON)
+#include <arm_neon.h>
+#endif
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+namespace TNN_NS {
+
+namespace {
+
+const uint32_t kMaskRleMagic = 0x314b4d54;  // "TMK1"
+const size_t kMaskRleHeader  = 24;
+
+void PutU32(std::vector<uint8_t> &out, uint32_t v) {
+    for (int i = 0; i < 4; ++i) {
+        out.push_back(static_cast<uint8_t>(v >> (8 * i)));
+    }
+}
+
+uint32_t GetU32(const uint8_t *p) {
+    return p[0] | (p[1] << 8) | (p[2] << 16) | (static_cast<uint32_t>(p[3]) << 24);
+}
+
+void PutRun(std::vector<uint8_t> &out, uint8_t value, size_t length) {
+    out.push_back(value);
+    while (length >= 0x80) {
+        out.push_back(static_cast<uint8_t>(length | 0x80));
+        length >>= 7;
+    }
+    out.push_back(static_cast<uint8_t>(length));
+}
+
+// length of the run of value starting at row[0], at most width
+int RunLength(const uint8_t *row, int width, uint8_t value) {
+    int x = 0;
+#if defined(TNN_USE_NEON)
+    const uint8x16_t vv = vdupq_n_u8(value);
+    for (; x + 16 <= width; x += 16) {
+        uint8x16_t eq = vceqq_u8(vld1q_u8(row + x), vv);
+        // one nibble per byte, the first zero nibble is the first mismatch
+        uint64_t bits = vget_lane_u64(vreinterpret_u64_u8(vshrn_n_u16(vreinterpretq_u16_u8(eq), 4)), 0);
+        if (bits != ~0ULL) {
+            return x + __builtin_ctzll(~bits) / 4;
+        }
+    }
+#elif defined(__SSE2__)
+    const __m128i vv = _mm_set1_epi8((char)value);
+    for (; x + 16 <= width; x += 16) {
+        int eq = _mm_movemask_epi8(_mm_cmpeq_epi8(_mm_loadu_si128((const __m128i *)(row + x)), vv));
+        if (eq != 0xffff) {
+            return x + __builtin_ctz(~eq);
+        }
+    }
+#endif
+    while (x < width && row[x] == value) {
+        x++;
+    }
+    return x;
+}
+
+// walks the runs of an encoded stream, emit(value, start, length) for each, start counts box pixels
+template <typename Emit>
+Status ReadRuns(const uint8_t *data, size_t size, size_t total, Emit emit) {
+    size_t pos  = kMaskRleHeader;
+    size_t done = 0;
+    while (done < total) {
+        if (pos >= size) {
+            return Status(TNNERR_PARAM_ERR, "mask rle stream is truncated");
+        }
+        uint8_t value = data[pos++];
+        size_t length = 0;
+        int shift     = 0;
+        while (true) {
+            if (pos >= size || shift > 35) {
+                return Status(TNNERR_PARAM_ERR, "mask rle stream is truncated");
+            }
+            uint8_t b = data[pos++];
+            length |= static_cast<size_t>(b & 0x7f) << shift;
+            shift += 7;
+            if (!(b & 0x80)) {
+                break;
+            }
+        }
+        if (length == 0 || length > total - done) {
+            return Status(TNNERR_PARAM_ERR, "mask rle run exceeds the mask");
+        }
+        emit(value, done, length);
+        done += length;
+    }
+    return TNN_OK;
+}
+
+}  // namespace
+
+Status EncodeMaskRle(const uint8_t *mask, int width, int height, int stride, bool crop_to_box,
+                     std::vector<uint8_t> &out) {
+    if (!mask || width <= 0 || height <= 0 || stride < width) {
+        return Status(TNNERR_PARAM_ERR, "mask rle got an invalid mask");
+    }
+    int x1 = 0, y1 = 0, x2 = width, y2 = height;
+    if (crop_to_box && !MaskBoundingBox(mask, width, height, stride, x1, y1, x2, y2)) {
+        x1 = y1 = x2 = y2 = 0;
+    }
+
+    out.clear();
+    PutU32(out, kMaskRleMagic);
+    PutU32(out, width);
+    PutU32(out, height);
+    PutU32(out, (y1 << 16) | x1);
+    PutU32(out, x2 - x1);
+    PutU32(out, y2 - y1);
+
+    // the current run continues across rows, it is flushed on a value change
+    bool open     = false;
+    uint8_t value = 0;
+    size_t length = 0;
+    for (int y = y1; y < y2; ++y) {
+        const uint8_t *row = mask + static_cast<size_t>(y) * stride + x1;
+        const int w        = x2 - x1;
+        int x              = 0;
+        while (x < w) {
+            if (!open || row[x] != value) {
+                if (open) {
+                    PutRun(out, value, length);
+                }
+                open   = true;
+                value  = row[x];
+                length = 0;
+            }
+            int n = RunLength(row + x, w - x, value);
+            length += n;
+            x += n;
+        }
+    }
+    if (open) {
+        PutRun(out, value, length);
+    }
+    return TNN_OK;
+}
+
+Status GetMaskRleInfo(const uint8_t *data, size_t size, MaskRleInfo &info) {
+    if (!data || size < kMaskRleHeader || GetU32(data) != kMaskRleMagic) {
+        return Status(TNNERR_PARAM_ERR, "not a mask rle stream");
+    }
+    uint32_t origin = GetU32(data + 12);
+    info.width      = static_cast<int>(GetU32(data + 4));
+    info.height     = static_cast<int>(GetU32(data + 8));
+    info.box_x      = static_cast<int>(origin & 0xffff);
+    info.box_y      = static_cast<int>(origin >> 16);
+    info.box_width  = static_cast<int>(GetU32(data + 16));
+    info.box_height = static_cast<int>(GetU32(data + 20));
+    if (info.width <= 0 || info.height <= 0 || info.box_width < 0 || info.box_height < 0 ||
+        info.box_x + info.box_width > info.width || info.box_y + info.box_height > info.height) {
+        return Status(TNNERR_PARAM_ERR, "mask rle header is corrupt");
+    }
+    return TNN_OK;
+}
+
+Status DecodeMaskRle(const uint8_t *data, size_t size, uint8_t *mask, int stride) {
+    MaskRleInfo info;
+    auto status = GetMaskRleInfo(data, size, info);
+    if (status != TNN_OK) {
+        return status;
+    }
+    MaskBuffer dst(TNNMaskFormatA8, mask, info.width, info.height, stride);
+    return DecodeMaskRle(data, size, dst);
+}
+
+Status DecodeMaskRle(const uint8_t *data, size_t size, const MaskBuffer &dst, const uint32_t *palette,
+                     int num_classes) {
+    MaskRleInfo info;
+    auto status = GetMaskRleInfo(data, size, info);
+    if (status != TNN_OK) {
+        return status;
+    }
+    status = dst.Validate(info.width, info.height);
+    if (status != TNN_OK) {
+        return status;
+    }
+    status = ClearMask(dst);
+    if (status != TNN_OK) {
+        return status;
+    }
+    const size_t w     = info.box_width;
+    const size_t total = w * info.box_height;
+    if (total == 0) {
+        return TNN_OK;
+    }
+
+    // byte formats take the runs as memsets, the others get one decoded row at a time
+    if (!palette && (dst.format == TNNMaskFormatA8 || dst.format == TNNMaskFormatClassU8)) {
+        return ReadRuns(data, size, total, [&](uint8_t value, size_t start, size_t length) {
+            while (length > 0) {
+                size_t y = start / w, x = start % w;
+                size_t n = std::min(length, w - x);
+                memset(dst.Row(info.box_y + static_cast<int>(y)) + info.box_x + x, value, n);
+                start += n;
+                length -= n;
+            }
+        });
+    }
+
+    std::vector<uint8_t> row(w);
+    Status write_status = TNN_OK;
+    status = ReadRuns(data, size, total, [&](uint8_t value, size_t start, size_t length) {
+        while (length > 0) {
+            size_t y = start / w, x = start % w;
+            size_t n = std::min(length, w - x);
+            memset(row.data() + x, value, n);
+            if (x + n == w && write_status == TNN_OK) {
+                int ry = info.box_y + static_cast<int>(y);
+                write_status = palette ? WriteClassRegion(dst, info.box_x, ry, row.data(), static_cast<int>(w), 1,
+                                                          static_cast<int>(w), palette, num_classes)
+                                       : WriteAlphaRegion(dst, info.box_x, ry, row.data(), static_cast<int>(w), 1,
+                                                          static_cast<int>(w), 0xffffff);
+            }
+            start += n;
+            length -= n;
+        }
+    });
+    return status != TNN_OK ? status : write_status;
+}
+
+}  // namespace TNN_NS
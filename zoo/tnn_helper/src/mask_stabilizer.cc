@@ -0,0 +1,452 @@
+// Tencent is pleased to support the open source community by making TNN available.
+//
+// Copyright (C) 2020 THL A29 Limited, a Tencent company. All rights reserved.
+//
+// Licensed under the BSD 3-Clause License (the "License"); you may not use this file except
+// in compliance with the License. You may obtain a copy of the License at
+//
+// https://opensource.org/licenses/BSD-3-Clause
+//
+// Unless required by applicable law or agreed to in writing, software distributed
+// under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+// CONDITIONS OF ANY KIND, either express or implied. See the License for the
+// specific language governing permissions and limitations under the License.
+
+#include "mask_stabilizer.h"
+#include "mask_utils.h"
+#include <algorithm>
+#include <cstring>
+#include "tnn/core/macro.h"
+
+#if defined(TNN_USE_NEON)
+#include <arm_neon.h>
+#endif
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+#if defined(__AVX2__)
+#include <immintrin.h>
+#endif
+
+namespace TNN_NS {
+
+namespace {
+
+const int kMaxMajorityWindow = 15;
+
+// cur = pre == next ? next : cur
+void MajorityKernel3(const uint8_t *pre, uint8_t *cur, const uint8_t *next, size_t size) {
+    size_t i = 0;
+#if defined(__AVX2__)
+    for (; i + 32 <= size; i += 32) {
+        __m256i p  = _mm256_loadu_si256((const __m256i *)(pre + i));
+        __m256i c  = _mm256_loadu_si256((const __m256i *)(cur + i));
+        __m256i n  = _mm256_loadu_si256((const __m256i *)(next + i));
+        __m256i eq = _mm256_cmpeq_epi8(p, n);
+        _mm256_storeu_si256((__m256i *)(cur + i), _mm256_blendv_epi8(c, n, eq));
+    }
+#endif
+#if defined(TNN_USE_NEON)
+    for (; i + 16 <= size; i += 16) {
+        uint8x16_t p  = vld1q_u8(pre + i);
+        uint8x16_t c  = vld1q_u8(cur + i);
+        uint8x16_t n  = vld1q_u8(next + i);
+        vst1q_u8(cur + i, vbslq_u8(vceqq_u8(p, n), n, c));
+    }
+#elif defined(__SSE2__)
+    for (; i + 16 <= size; i += 16) {
+        __m128i p  = _mm_loadu_si128((const __m128i *)(pre + i));
+        __m128i c  = _mm_loadu_si128((const __m128i *)(cur + i));
+        __m128i n  = _mm_loadu_si128((const __m128i *)(next + i));
+        __m128i eq = _mm_cmpeq_epi8(p, n);
+        _mm_storeu_si128((__m128i *)(cur + i), _mm_or_si128(_mm_and_si128(eq, n), _mm_andnot_si128(eq, c)));
+    }
+#endif
+    for (; i < size; ++i) {
+        if (pre[i] == next[i]) {
+            cur[i] = next[i];
+        }
+    }
+}
+
+// frames[center] = the value more than half of the frames agree on, if any
+void MajorityKernelN(const uint8_t *const *frames, int window, int center, size_t size) {
+    const int half = window / 2;
+    uint8_t *out   = const_cast<uint8_t *>(frames[center]);
+    size_t i       = 0;
+#if defined(TNN_USE_NEON)
+    const uint8x16_t vhalf = vdupq_n_u8(half);
+    for (; i + 16 <= size; i += 16) {
+        uint8x16_t v[kMaxMajorityWindow] = {};
+        for (int k = 0; k < window; ++k) {
+            v[k] = vld1q_u8(frames[k] + i);
+        }
+        uint8x16_t result = vld1q_u8(frames[center] + i);
+        for (int j = 0; j < window; ++j) {
+            uint8x16_t votes = vdupq_n_u8(0);
+            for (int k = 0; k < window; ++k) {
+                votes = vsubq_u8(votes, vceqq_u8(v[j], v[k]));
+            }
+            result = vbslq_u8(vcgtq_u8(votes, vhalf), v[j], result);
+        }
+        vst1q_u8(out + i, result);
+    }
+#elif defined(__SSE2__)
+    const __m128i vhalf = _mm_set1_epi8(half);
+    for (; i + 16 <= size; i += 16) {
+        __m128i v[kMaxMajorityWindow] = {};
+        for (int k = 0; k < window; ++k) {
+            v[k] = _mm_loadu_si128((const __m128i *)(frames[k] + i));
+        }
+        __m128i result = _mm_loadu_si128((const __m128i *)(frames[center] + i));
+        for (int j = 0; j < window; ++j) {
+            __m128i votes = _mm_setzero_si128();
+            for (int k = 0; k < window; ++k) {
+                votes = _mm_sub_epi8(votes, _mm_cmpeq_epi8(v[j], v[k]));
+            }
+            __m128i major = _mm_cmpgt_epi8(votes, vhalf);
+            result        = _mm_or_si128(_mm_and_si128(major, v[j]), _mm_andnot_si128(major, result));
+        }
+        _mm_storeu_si128((__m128i *)(out + i), result);
+    }
+#endif
+    for (; i < size; ++i) {
+        uint8_t result = frames[center][i];
+        for (int j = 0; j < window; ++j) {
+            int votes = 0;
+            for (int k = 0; k < window; ++k) {
+                votes += frames[j][i] == frames[k][i];
+            }
+            if (votes > half) {
+                result = frames[j][i];
+                break;
+            }
+        }
+        out[i] = result;
+    }
+}
+
+/*
+ * pending = x
+ * counter = x == stable ? 0 : (x == old pending ? counter + 1 : 1)
+ * counter >= window: stable = x, counter = 0
+ */
+void HysteresisKernel(const uint8_t *x, uint8_t *stable, uint8_t *pending, uint8_t *counter, size_t size,
+                      int window) {
+    size_t i = 0;
+#if defined(TNN_USE_NEON)
+    const uint8x16_t one  = vdupq_n_u8(1);
+    const uint8x16_t vwin = vdupq_n_u8(window);
+    for (; i + 16 <= size; i += 16) {
+        uint8x16_t vx   = vld1q_u8(x + i);
+        uint8x16_t vs   = vld1q_u8(stable + i);
+        uint8x16_t vp   = vld1q_u8(pending + i);
+        uint8x16_t vc   = vld1q_u8(counter + i);
+        uint8x16_t eq_s = vceqq_u8(vx, vs);
+        uint8x16_t cnt  = vbicq_u8(vbslq_u8(vceqq_u8(vx, vp), vqaddq_u8(vc, one), one), eq_s);
+        uint8x16_t flip = vcgeq_u8(cnt, vwin);
+        vst1q_u8(stable + i, vbslq_u8(flip, vx, vs));
+        vst1q_u8(counter + i, vbicq_u8(cnt, flip));
+        vst1q_u8(pending + i, vx);
+    }
+#elif defined(__SSE2__)
+    const __m128i one  = _mm_set1_epi8(1);
+    const __m128i vwin = _mm_set1_epi8((char)window);
+    for (; i + 16 <= size; i += 16) {
+        __m128i vx   = _mm_loadu_si128((const __m128i *)(x + i));
+        __m128i vs   = _mm_loadu_si128((const __m128i *)(stable + i));
+        __m128i vp   = _mm_loadu_si128((const __m128i *)(pending + i));
+        __m128i vc   = _mm_loadu_si128((const __m128i *)(counter + i));
+        __m128i eq_s = _mm_cmpeq_epi8(vx, vs);
+        __m128i eq_p = _mm_cmpeq_epi8(vx, vp);
+        __m128i cnt  = _mm_or_si128(_mm_and_si128(eq_p, _mm_adds_epu8(vc, one)), _mm_andnot_si128(eq_p, one));
+        cnt          = _mm_andnot_si128(eq_s, cnt);
+        __m128i flip = _mm_cmpeq_epi8(_mm_max_epu8(cnt, vwin), cnt);
+        _mm_storeu_si128((__m128i *)(stable + i), _mm_or_si128(_mm_and_si128(flip, vx), _mm_andnot_si128(flip, vs)));
+        _mm_storeu_si128((__m128i *)(counter + i), _mm_andnot_si128(flip, cnt));
+        _mm_storeu_si128((__m128i *)(pending + i), vx);
+    }
+#endif
+    for (; i < size; ++i) {
+        int cnt = 0;
+        if (x[i] != stable[i]) {
+            cnt = x[i] == pending[i] ? std::min(counter[i] + 1, 255) : 1;
+        }
+        if (cnt >= window) {
+            stable[i] = x[i];
+            cnt       = 0;
+        }
+        counter[i] = cnt;
+        pending[i] = x[i];
+    }
+}
+
+void QuantizeKernel(const float *conf, uint8_t *dst, size_t size, bool invert) {
+    const float scale = invert ? -255.0f : 255.0f;
+    const float bias  = invert ? 255.5f : 0.5f;
+    size_t i = 0;
+#if defined(TNN_USE_NEON)
+    const float32x4_t vscale = vdupq_n_f32(scale);
+    const float32x4_t vbias  = vdupq_n_f32(bias);
+    const float32x4_t vzero  = vdupq_n_f32(0.0f);
+    for (; i + 8 <= size; i += 8) {
+        float32x4_t a = vmaxq_f32(vmlaq_f32(vbias, vld1q_f32(conf + i), vscale), vzero);
+        float32x4_t b = vmaxq_f32(vmlaq_f32(vbias, vld1q_f32(conf + i + 4), vscale), vzero);
+        uint16x8_t ab = vcombine_u16(vqmovn_u32(vcvtq_u32_f32(a)), vqmovn_u32(vcvtq_u32_f32(b)));
+        vst1_u8(dst + i, vqmovn_u16(ab));
+    }
+#elif defined(__SSE2__)
+    const __m128 vscale = _mm_set1_ps(scale);
+    const __m128 vbias  = _mm_set1_ps(bias - 0.5f);
+    for (; i + 16 <= size; i += 16) {
+        __m128i a = _mm_cvtps_epi32(_mm_add_ps(_mm_mul_ps(_mm_loadu_ps(conf + i), vscale), vbias));
+        __m128i b = _mm_cvtps_epi32(_mm_add_ps(_mm_mul_ps(_mm_loadu_ps(conf + i + 4), vscale), vbias));
+        __m128i c = _mm_cvtps_epi32(_mm_add_ps(_mm_mul_ps(_mm_loadu_ps(conf + i + 8), vscale), vbias));
+        __m128i d = _mm_cvtps_epi32(_mm_add_ps(_mm_mul_ps(_mm_loadu_ps(conf + i + 12), vscale), vbias));
+        _mm_storeu_si128((__m128i *)(dst + i), _mm_packus_epi16(_mm_packs_epi32(a, b), _mm_packs_epi32(c, d)));
+    }
+#endif
+    for (; i < size; ++i) {
+        float v = conf[i] * scale + bias;
+        dst[i]  = v <= 0 ? 0 : (v >= 255 ? 255 : static_cast<uint8_t>(v));
+    }
+}
+
+/*
+ * average += (x - average) * alpha / 128
+ * mask = mask ? average >= low : average >= high
+ */
+size_t EmaHysteresisKernel(const uint8_t *x, uint8_t *average, uint8_t *mask, size_t size, int alpha,
+                           uint8_t low, uint8_t high) {
+    size_t foreground = 0;
+    size_t i = 0;
+#if defined(TNN_USE_NEON)
+    const int16x8_t valpha = vdupq_n_s16(alpha);
+    const uint8x16_t vlow  = vdupq_n_u8(low);
+    const uint8x16_t vhigh = vdupq_n_u8(high);
+    uint32x4_t vcount      = vdupq_n_u32(0);
+    for (; i + 16 <= size; i += 16) {
+        uint8x16_t vx = vld1q_u8(x + i);
+        uint8x16_t ve = vld1q_u8(average + i);
+        uint8x16_t vm = vld1q_u8(mask + i);
+        int16x8_t dlo = vsubq_s16(vreinterpretq_s16_u16(vmovl_u8(vget_low_u8(vx))),
+                                  vreinterpretq_s16_u16(vmovl_u8(vget_low_u8(ve))));
+        int16x8_t dhi = vsubq_s16(vreinterpretq_s16_u16(vmovl_u8(vget_high_u8(vx))),
+                                  vreinterpretq_s16_u16(vmovl_u8(vget_high_u8(ve))));
+        int16x8_t elo = vaddq_s16(vreinterpretq_s16_u16(vmovl_u8(vget_low_u8(ve))),
+                                  vrshrq_n_s16(vmulq_s16(dlo, valpha), 7));
+        int16x8_t ehi = vaddq_s16(vreinterpretq_s16_u16(vmovl_u8(vget_high_u8(ve))),
+                                  vrshrq_n_s16(vmulq_s16(dhi, valpha), 7));
+        ve = vcombine_u8(vqmovun_s16(elo), vqmovun_s16(ehi));
+        vm = vbslq_u8(vm, vcgeq_u8(ve, vlow), vcgeq_u8(ve, vhigh));
+        vst1q_u8(average + i, ve);
+        vst1q_u8(mask + i, vm);
+        vcount = vpadalq_u16(vcount, vpaddlq_u8(vshrq_n_u8(vm, 7)));
+    }
+    foreground += vgetq_lane_u32(vcount, 0) + vgetq_lane_u32(vcount, 1) + vgetq_lane_u32(vcount, 2) +
+                  vgetq_lane_u32(vcount, 3);
+#elif defined(__SSE2__)
+    const __m128i valpha = _mm_set1_epi16(alpha);
+    const __m128i vround = _mm_set1_epi16(64);
+    const __m128i vlow   = _mm_set1_epi8((char)low);
+    const __m128i vhigh  = _mm_set1_epi8((char)high);
+    const __m128i vzero  = _mm_setzero_si128();
+    for (; i + 16 <= size; i += 16) {
+        __m128i vx  = _mm_loadu_si128((const __m128i *)(x + i));
+        __m128i ve  = _mm_loadu_si128((const __m128i *)(average + i));
+        __m128i vm  = _mm_loadu_si128((const __m128i *)(mask + i));
+        __m128i elo = _mm_unpacklo_epi8(ve, vzero);
+        __m128i ehi = _mm_unpackhi_epi8(ve, vzero);
+        __m128i dlo = _mm_sub_epi16(_mm_unpacklo_epi8(vx, vzero), elo);
+        __m128i dhi = _mm_sub_epi16(_mm_unpackhi_epi8(vx, vzero), ehi);
+        elo = _mm_add_epi16(elo, _mm_srai_epi16(_mm_add_epi16(_mm_mullo_epi16(dlo, valpha), vround), 7));
+        ehi = _mm_add_epi16(ehi, _mm_srai_epi16(_mm_add_epi16(_mm_mullo_epi16(dhi, valpha), vround), 7));
+        ve  = _mm_packus_epi16(elo, ehi);
+        __m128i ge_low  = _mm_cmpeq_epi8(_mm_max_epu8(ve, vlow), ve);
+        __m128i ge_high = _mm_cmpeq_epi8(_mm_max_epu8(ve, vhigh), ve);
+        vm = _mm_or_si128(_mm_and_si128(vm, ge_low), _mm_andnot_si128(vm, ge_high));
+        _mm_storeu_si128((__m128i *)(average + i), ve);
+        _mm_storeu_si128((__m128i *)(mask + i), vm);
+        foreground += __builtin_popcount(_mm_movemask_epi8(vm));
+    }
+#endif
+    for (; i < size; ++i) {
+        int e      = average[i] + (((x[i] - average[i]) * alpha + 64) >> 7);
+        average[i] = static_cast<uint8_t>(std::min(std::max(e, 0), 255));
+        mask[i]    = (mask[i] ? average[i] >= low : average[i] >= high) ? 0xff : 0;
+        foreground += mask[i] != 0;
+    }
+    return foreground;
+}
+
+}  // namespace
+
+MaskStabilizer::MaskStabilizer() {}
+
+MaskStabilizer::~MaskStabilizer() {}
+
+Status MaskStabilizer::Init(size_t size, TNNMaskStabilizerMode mode, int window) {
+    if (mode == TNNMaskStabilizerMajority && (window < 3 || window > kMaxMajorityWindow || window % 2 == 0)) {
+        return Status(TNNERR_PARAM_ERR, "majority window must be odd and in [3, 15]");
+    }
+    if (mode == TNNMaskStabilizerHysteresis && (window < 1 || window > 255)) {
+        return Status(TNNERR_PARAM_ERR, "hysteresis window must be in [1, 255]");
+    }
+    mode_   = mode;
+    window_ = window;
+    size_   = size;
+
+    int num_frames = mode == TNNMaskStabilizerMajority ? window : 1;
+    frames_.assign(num_frames, std::vector<uint8_t>(size, 0));
+    if (mode == TNNMaskStabilizerHysteresis) {
+        stable_.assign(size, 0);
+        pending_.assign(size, 0);
+        counter_.assign(size, 0);
+    } else {
+        stable_.clear();
+        pending_.clear();
+        counter_.clear();
+    }
+    Reset();
+    return TNN_OK;
+}
+
+void MaskStabilizer::SetEnabled(bool enabled) {
+    enabled_ = enabled;
+    if (!enabled) {
+        Reset();
+    }
+}
+
+void MaskStabilizer::Reset() {
+    count_ = 0;
+    head_  = 0;
+}
+
+uint8_t *MaskStabilizer::GetInputBuffer() {
+    if (frames_.empty()) {
+        return nullptr;
+    }
+    return frames_[head_].data();
+}
+
+const uint8_t *MaskStabilizer::Process() {
+    if (frames_.empty()) {
+        return nullptr;
+    }
+    if (!enabled_) {
+        return frames_[head_].data();
+    }
+    if (mode_ == TNNMaskStabilizerHysteresis) {
+        return ProcessHysteresis();
+    }
+    return ProcessMajority();
+}
+
+const uint8_t *MaskStabilizer::ProcessMajority() {
+    const int newest = head_;
+    head_            = (head_ + 1) % window_;
+    // not enough history yet, pass the newest mask through
+    if (++count_ < window_) {
+        return frames_[newest].data();
+    }
+    count_ = window_;
+
+    // in temporal order, oldest first. the centre frame is filtered in place so that the
+    // filtered result is what later windows see, exactly like the old OFD
+    const uint8_t *ordered[kMaxMajorityWindow];
+    for (int k = 0; k < window_; ++k) {
+        ordered[k] = frames_[(newest + 1 + k) % window_].data();
+    }
+    const int center = window_ / 2;
+    if (window_ == 3) {
+        MajorityKernel3(ordered[0], const_cast<uint8_t *>(ordered[1]), ordered[2], size_);
+    } else {
+        MajorityKernelN(ordered, window_, center, size_);
+    }
+    return ordered[center];
+}
+
+const uint8_t *MaskStabilizer::ProcessHysteresis() {
+    const uint8_t *x = frames_[0].data();
+    if (count_ == 0) {
+        memcpy(stable_.data(), x, size_);
+        memcpy(pending_.data(), x, size_);
+        memset(counter_.data(), 0, size_);
+        count_ = 1;
+        return stable_.data();
+    }
+    HysteresisKernel(x, stable_.data(), pending_.data(), counter_.data(), size_, window_);
+    return stable_.data();
+}
+
+ConfidenceStabilizer::ConfidenceStabilizer() {}
+
+ConfidenceStabilizer::~ConfidenceStabilizer() {}
+
+Status ConfidenceStabilizer::Init(size_t size, float alpha, float threshold, float band) {
+    if (alpha <= 0 || alpha > 1) {
+        return Status(TNNERR_PARAM_ERR, "confidence stabilizer alpha must be in (0, 1]");
+    }
+    auto status = SetThreshold(threshold, band);
+    if (status != TNN_OK) {
+        return status;
+    }
+    size_  = size;
+    alpha_ = std::max(1, std::min(128, static_cast<int>(alpha * 128 + 0.5f)));
+    input_.assign(size, 0);
+    average_.assign(size, 0);
+    mask_.assign(size, 0);
+    Reset();
+    return TNN_OK;
+}
+
+Status ConfidenceStabilizer::SetThreshold(float threshold, float band) {
+    if (threshold < 0 || threshold > 1 || band < 0) {
+        return Status(TNNERR_PARAM_ERR, "confidence stabilizer threshold must be in [0, 1]");
+    }
+    auto quantize = [](float v) -> uint8_t {
+        return static_cast<uint8_t>(std::min(std::max(v, 0.0f), 1.0f) * 255.0f + 0.5f);
+    };
+    threshold_ = std::max(quantize(threshold), static_cast<uint8_t>(1));
+    low_       = quantize(threshold - band);
+    high_      = std::max(quantize(threshold + band), threshold_);
+    return TNN_OK;
+}
+
+void ConfidenceStabilizer::SetEnabled(bool enabled) {
+    enabled_ = enabled;
+    if (!enabled) {
+        Reset();
+    }
+}
+
+void ConfidenceStabilizer::Reset() {
+    primed_ = false;
+}
+
+void ConfidenceStabilizer::Quantize(const float *conf, bool invert) {
+    QuantizeKernel(conf, input_.data(), size_, invert);
+}
+
+uint8_t *ConfidenceStabilizer::GetInputBuffer() {
+    return input_.data();
+}
+
+const uint8_t *ConfidenceStabilizer::Process(size_t *foreground) {
+    size_t count = 0;
+    if (!enabled_ || !primed_) {
+        // start the average from the current frame, plain threshold without history
+        memcpy(average_.data(), input_.data(), size_);
+        count = ThresholdToMask(input_.data(), size_, threshold_, mask_.data());
+        primed_ = enabled_;
+    } else {
+        count = EmaHysteresisKernel(input_.data(), average_.data(), mask_.data(), size_, alpha_, low_, high_);
+    }
+    if (foreground) {
+        *foreground = count;
+    }
+    return mask_.data();
+}
+
+}  // namespace TNN_NS
@@ -0,0 +1,311 @@
+// Tencent is pleased to support the open source community by making TNN available.
+//
+// Copyright (C) 2020 THL A29 Limited, a Tencent company. All rights reserved.
+//
+// Licensed under the BSD 3-Clause License (the "License"); you may not use this file except
+// in compliance with the License. You may obtain a copy of the License at
+//
+// https://opensource.org/licenses/BSD-3-Clause
+//
+// Unless required by applicable law or agreed to in writing, software distributed
+// under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+// CONDITIONS OF ANY KIND, either express or implied. See the License for the
+// specific language governing permissions and limitations under the License.
+
+#include "mask_upsampler.h"
+#include <algorithm>
+#include <cmath>
+#include <functional>
+#include <thread>
+
+#if defined(TNN_USE_NEON)
+#include <arm_neon.h>
+#endif
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+namespace TNN_NS {
+
+namespace {
+
+const int kWeightBits = 7;
+const int kWeightOne  = 1 << kWeightBits;
+// below this many output rows per thread the thread start costs more than it saves
+const int kMinRowsPerThread = 64;
+
+void BuildTable(int src_size, int dst_size, float scale, float offset, std::vector<int> &i0, std::vector<int> &i1,
+                std::vector<int16_t> &w) {
+    i0.resize(dst_size);
+    i1.resize(dst_size);
+    w.resize(dst_size);
+    for (int d = 0; d < dst_size; ++d) {
+        float f = (d + 0.5f) * scale + offset - 0.5f;
+        int s   = static_cast<int>(std::floor(f));
+        float t = f - s;
+        if (s < 0) {
+            s = 0;
+            t = 0;
+        }
+        if (s >= src_size - 1) {
+            s = src_size - 1;
+            t = 0;
+        }
+        i0[d] = s;
+        i1[d] = std::min(s + 1, src_size - 1);
+        w[d]  = static_cast<int16_t>(std::lround(t * kWeightOne));
+    }
+}
+
+// row[x] = src[x0] * (1 - w) + src[x1] * w, at most 255 << 7 so it fits in 16 bit
+void HorizontalPass(const uint8_t *src, const int *x0, const int *x1, const int16_t *wx, int16_t *row, int width) {
+    for (int x = 0; x < width; ++x) {
+        row[x] = static_cast<int16_t>(src[x0[x]] * (kWeightOne - wx[x]) + src[x1[x]] * wx[x]);
+    }
+}
+
+// dst[x] = (r0[x] * (1 - w) + r1[x] * w) >> 14, rounded
+void VerticalPassGray(const int16_t *r0, const int16_t *r1, int wy, uint8_t *dst, int width) {
+    const int c0 = kWeightOne - wy;
+    const int c1 = wy;
+    int x        = 0;
+#if defined(TNN_USE_NEON)
+    for (; x + 8 <= width; x += 8) {
+        uint16x8_t h0 = vreinterpretq_u16_s16(vld1q_s16(r0 + x));
+        uint16x8_t h1 = vreinterpretq_u16_s16(vld1q_s16(r1 + x));
+        uint32x4_t lo = vmlal_n_u16(vmull_n_u16(vget_low_u16(h0), c0), vget_low_u16(h1), c1);
+        uint32x4_t hi = vmlal_n_u16(vmull_n_u16(vget_high_u16(h0), c0), vget_high_u16(h1), c1);
+        uint16x8_t v  = vcombine_u16(vrshrn_n_u32(lo, 2 * kWeightBits), vrshrn_n_u32(hi, 2 * kWeightBits));
+        vst1_u8(dst + x, vmovn_u16(v));
+    }
+#elif defined(__SSE2__)
+    const __m128i coef  = _mm_set1_epi32((c1 << 16) | c0);
+    const __m128i round = _mm_set1_epi32(1 << (2 * kWeightBits - 1));
+    for (; x + 8 <= width; x += 8) {
+        __m128i h0 = _mm_loadu_si128((const __m128i *)(r0 + x));
+        __m128i h1 = _mm_loadu_si128((const __m128i *)(r1 + x));
+        __m128i lo = _mm_madd_epi16(_mm_unpacklo_epi16(h0, h1), coef);
+        __m128i hi = _mm_madd_epi16(_mm_unpackhi_epi16(h0, h1), coef);
+        lo         = _mm_srai_epi32(_mm_add_epi32(lo, round), 2 * kWeightBits);
+        hi         = _mm_srai_epi32(_mm_add_epi32(hi, round), 2 * kWeightBits);
+        __m128i v  = _mm_packs_epi32(lo, hi);
+        _mm_storel_epi64((__m128i *)(dst + x), _mm_packus_epi16(v, v));
+    }
+#endif
+    for (; x < width; ++x) {
+        dst[x] = static_cast<uint8_t>((r0[x] * c0 + r1[x] * c1 + (1 << (2 * kWeightBits - 1))) >> (2 * kWeightBits));
+    }
+}
+
+// same as VerticalPassGray, the result goes into the alpha byte of an ARGB pixel
+void VerticalPassARGB(const int16_t *r0, const int16_t *r1, int wy, uint32_t rgb, uint32_t *dst, int width) {
+    const int c0 = kWeightOne - wy;
+    const int c1 = wy;
+    int x        = 0;
+#if defined(TNN_USE_NEON)
+    const uint32x4_t vrgb = vdupq_n_u32(rgb);
+    for (; x + 8 <= width; x += 8) {
+        uint16x8_t h0 = vreinterpretq_u16_s16(vld1q_s16(r0 + x));
+        uint16x8_t h1 = vreinterpretq_u16_s16(vld1q_s16(r1 + x));
+        uint32x4_t lo = vmlal_n_u16(vmull_n_u16(vget_low_u16(h0), c0), vget_low_u16(h1), c1);
+        uint32x4_t hi = vmlal_n_u16(vmull_n_u16(vget_high_u16(h0), c0), vget_high_u16(h1), c1);
+        lo            = vrshrq_n_u32(lo, 2 * kWeightBits);
+        hi            = vrshrq_n_u32(hi, 2 * kWeightBits);
+        vst1q_u32(dst + x, vorrq_u32(vshlq_n_u32(lo, 24), vrgb));
+        vst1q_u32(dst + x + 4, vorrq_u32(vshlq_n_u32(hi, 24), vrgb));
+    }
+#elif defined(__SSE2__)
+    const __m128i coef  = _mm_set1_epi32((c1 << 16) | c0);
+    const __m128i round = _mm_set1_epi32(1 << (2 * kWeightBits - 1));
+    const __m128i vrgb  = _mm_set1_epi32(static_cast<int>(rgb));
+    for (; x + 8 <= width; x += 8) {
+        __m128i h0 = _mm_loadu_si128((const __m128i *)(r0 + x));
+        __m128i h1 = _mm_loadu_si128((const __m128i *)(r1 + x));
+        __m128i lo = _mm_madd_epi16(_mm_unpacklo_epi16(h0, h1), coef);
+        __m128i hi = _mm_madd_epi16(_mm_unpackhi_epi16(h0, h1), coef);
+        lo         = _mm_srli_epi32(_mm_add_epi32(lo, round), 2 * kWeightBits);
+        hi         = _mm_srli_epi32(_mm_add_epi32(hi, round), 2 * kWeightBits);
+        _mm_storeu_si128((__m128i *)(dst + x), _mm_or_si128(_mm_slli_epi32(lo, 24), vrgb));
+        _mm_storeu_si128((__m128i *)(dst + x + 4), _mm_or_si128(_mm_slli_epi32(hi, 24), vrgb));
+    }
+#endif
+    for (; x < width; ++x) {
+        uint32_t a = (r0[x] * c0 + r1[x] * c1 + (1 << (2 * kWeightBits - 1))) >> (2 * kWeightBits);
+        dst[x]     = (a << 24) | rgb;
+    }
+}
+
+}  // namespace
+
+MaskUpsampler::MaskUpsampler() {}
+
+MaskUpsampler::~MaskUpsampler() {}
+
+Status MaskUpsampler::Init(int src_width, int src_height, int dst_width, int dst_height) {
+    if (dst_width <= 0 || dst_height <= 0) {
+        return Status(TNNERR_PARAM_ERR, "mask upsampler size must be positive");
+    }
+    return InitMapped(src_width, src_height, dst_width, dst_height, static_cast<float>(src_width) / dst_width, 0,
+                      static_cast<float>(src_height) / dst_height, 0);
+}
+
+Status MaskUpsampler::InitMapped(int src_width, int src_height, int dst_width, int dst_height, float scale_x,
+                                 float offset_x, float scale_y, float offset_y) {
+    if (src_width <= 0 || src_height <= 0 || dst_width <= 0 || dst_height <= 0) {
+        return Status(TNNERR_PARAM_ERR, "mask upsampler size must be positive");
+    }
+    if (src_width != src_width_ || dst_width != dst_width_ || scale_x != scale_x_ || offset_x != offset_x_) {
+        BuildTable(src_width, dst_width, scale_x, offset_x, x0_, x1_, wx_);
+    }
+    if (src_height != src_height_ || dst_height != dst_height_ || scale_y != scale_y_ || offset_y != offset_y_) {
+        BuildTable(src_height, dst_height, scale_y, offset_y, y0_, y1_, wy_);
+    }
+    src_width_  = src_width;
+    src_height_ = src_height;
+    dst_width_  = dst_width;
+    dst_height_ = dst_height;
+    scale_x_    = scale_x;
+    offset_x_   = offset_x;
+    scale_y_    = scale_y;
+    offset_y_   = offset_y;
+    return TNN_OK;
+}
+
+void MaskUpsampler::SetNumThreads(int num_threads) {
+    num_threads_ = std::max(num_threads, 1);
+}
+
+struct MaskUpsampler::Target {
+    // the plain outputs write straight into dst, a mask buffer goes through WriteAlphaRegion
+    enum { kGray, kARGB, kMask } kind = kGray;
+    void *dst  = nullptr;
+    int stride = 0;
+    uint32_t rgb = 0;
+
+    const MaskBuffer *buffer = nullptr;
+    int left = 0;
+    int top  = 0;
+    TNNMaskBlend blend = TNNMaskBlendReplace;
+    uint8_t class_id   = 1;
+    uint8_t threshold  = 128;
+};
+
+Status MaskUpsampler::Upsample(const uint8_t *src, uint8_t *dst, int dst_stride) const {
+    Target target;
+    target.kind   = Target::kGray;
+    target.dst    = dst;
+    target.stride = dst_stride;
+    return Run(src, target);
+}
+
+Status MaskUpsampler::UpsampleToARGB(const uint8_t *src, uint32_t *dst, int dst_stride, uint32_t rgb) const {
+    Target target;
+    target.kind   = Target::kARGB;
+    target.dst    = dst;
+    target.stride = dst_stride;
+    target.rgb    = rgb & 0xffffff;
+    return Run(src, target);
+}
+
+Status MaskUpsampler::UpsampleToMask(const uint8_t *src, const MaskBuffer &dst, int left, int top, uint32_t rgb,
+                                     TNNMaskBlend blend, uint8_t class_id, uint8_t threshold) const {
+    Status status = dst.Validate(dst.width, dst.height);
+    if (status != TNN_OK) {
+        return status;
+    }
+    if (left < 0 || top < 0 || left + dst_width_ > dst.width || top + dst_height_ > dst.height) {
+        return Status(TNNERR_PARAM_ERR, "mask upsampler roi is out of the mask buffer");
+    }
+    Target target;
+    target.rgb = rgb & 0xffffff;
+    if (blend == TNNMaskBlendReplace && dst.format == TNNMaskFormatA8) {
+        target.kind   = Target::kGray;
+        target.dst    = dst.Row(top) + left;
+        target.stride = dst.GetStride();
+    } else if (blend == TNNMaskBlendReplace && dst.format == TNNMaskFormatARGB8888) {
+        target.kind   = Target::kARGB;
+        target.dst    = reinterpret_cast<uint32_t *>(dst.Row(top)) + left;
+        target.stride = dst.GetStride() / 4;
+    } else {
+        target.kind      = Target::kMask;
+        target.buffer    = &dst;
+        target.left      = left;
+        target.top       = top;
+        target.blend     = blend;
+        target.class_id  = class_id;
+        target.threshold = threshold;
+    }
+    return Run(src, target);
+}
+
+Status MaskUpsampler::Run(const uint8_t *src, const Target &target) const {
+    if (dst_width_ <= 0) {
+        return Status(TNNERR_PARAM_ERR, "mask upsampler is not initialized");
+    }
+    if (!src || (target.kind != Target::kMask && (!target.dst || target.stride < dst_width_))) {
+        return Status(TNNERR_PARAM_ERR, "mask upsampler got an invalid buffer");
+    }
+
+    int num_threads = std::min(num_threads_, std::max(dst_height_ / kMinRowsPerThread, 1));
+    if (num_threads <= 1) {
+        ProcessRows(src, target, 0, dst_height_);
+        return TNN_OK;
+    }
+    std::vector<std::thread> workers;
+    const int band = (dst_height_ + num_threads - 1) / num_threads;
+    for (int t = 1; t < num_threads; ++t) {
+        int y_begin = t * band;
+        int y_end   = std::min(y_begin + band, dst_height_);
+        if (y_begin < y_end) {
+            workers.emplace_back(&MaskUpsampler::ProcessRows, this, src, std::cref(target), y_begin, y_end);
+        }
+    }
+    ProcessRows(src, target, 0, std::min(band, dst_height_));
+    for (auto &worker : workers) {
+        worker.join();
+    }
+    return TNN_OK;
+}
+
+void MaskUpsampler::ProcessRows(const uint8_t *src, const Target &target, int y_begin, int y_end) const {
+    // two horizontally resampled source rows, reused while consecutive output rows share them
+    std::vector<int16_t> rows[2] = {std::vector<int16_t>(dst_width_), std::vector<int16_t>(dst_width_)};
+    int row_index[2]             = {-1, -1};
+    auto get_row = [&](int sy, int keep) -> const int16_t * {
+        for (int k = 0; k < 2; ++k) {
+            if (row_index[k] == sy) {
+                return rows[k].data();
+            }
+        }
+        int slot = row_index[0] == keep ? 1 : 0;
+        HorizontalPass(src + sy * src_width_, x0_.data(), x1_.data(), wx_.data(), rows[slot].data(), dst_width_);
+        row_index[slot] = sy;
+        return rows[slot].data();
+    };
+    std::vector<uint8_t> line(target.kind == Target::kMask ? dst_width_ : 0);
+
+    for (int y = y_begin; y < y_end; ++y) {
+        const int16_t *r0 = get_row(y0_[y], y1_[y]);
+        const int16_t *r1 = get_row(y1_[y], y0_[y]);
+        switch (target.kind) {
+            case Target::kARGB:
+                VerticalPassARGB(r0, r1, wy_[y], target.rgb,
+                                 static_cast<uint32_t *>(target.dst) + static_cast<size_t>(y) * target.stride,
+                                 dst_width_);
+                break;
+            case Target::kGray:
+                VerticalPassGray(r0, r1, wy_[y],
+                                 static_cast<uint8_t *>(target.dst) + static_cast<size_t>(y) * target.stride,
+                                 dst_width_);
+                break;
+            case Target::kMask:
+                // rows of a band never share bytes of a Bit1 row with another band
+                VerticalPassGray(r0, r1, wy_[y], line.data(), dst_width_);
+                WriteAlphaRegion(*target.buffer, target.left, target.top + y, line.data(), dst_width_, 1, dst_width_,
+                                 target.rgb, target.blend, target.class_id, target.threshold);
+                break;
+        }
+    }
+}
+
+}  // namespace TNN_NS
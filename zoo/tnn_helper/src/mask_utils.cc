@@ -0,0 +1,432 @@
+// Tencent is pleased to support the open source community by making TNN available.
+//
+// Copyright (C) 2020 THL A29 Limited, a Tencent company. All rights reserved.
+//
+// Licensed under the BSD 3-Clause License (the "License"); you may not use this file except
+// in compliance with the License. You may obtain a copy of the License at
+//
+// https://opensource.org/licenses/BSD-3-Clause
+//
+// Unless required by applicable law or agreed to in writing, software distributed
+// under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+// CONDITIONS OF ANY KIND, either express or implied. See the License for the
+// specific language governing permissions and limitations under the License.
+
+#include "mask_utils.h"
+#include <algorithm>
+#include <climits>
+#include <cstring>
+#include <vector>
+#include "tnn/utils/half_utils.h"
+
+#if defined(TNN_USE_NEON)
+#include <arm_neon.h>
+#endif
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+namespace TNN_NS {
+
+namespace {
+
+#if defined(TNN_USE_NEON)
+const uint8_t kBitWeights[16] = {1, 2, 4, 8, 16, 32, 64, 128, 1, 2, 4, 8, 16, 32, 64, 128};
+
+// 0 / 0xff lanes to two bytes, lane i is bit i % 8
+inline void StoreBits16(uint8x16_t m, uint8_t *dst) {
+    uint8x16_t w = vandq_u8(m, vld1q_u8(kBitWeights));
+    uint64x2_t s = vpaddlq_u32(vpaddlq_u16(vpaddlq_u8(w)));
+    dst[0]       = static_cast<uint8_t>(vgetq_lane_u64(s, 0));
+    dst[1]       = static_cast<uint8_t>(vgetq_lane_u64(s, 1));
+}
+
+template <bool Below>
+inline uint8x16_t Compare16(const float *src, float32x4_t vt) {
+    uint32x4_t m0, m1, m2, m3;
+    if (Below) {
+        m0 = vcltq_f32(vld1q_f32(src), vt);
+        m1 = vcltq_f32(vld1q_f32(src + 4), vt);
+        m2 = vcltq_f32(vld1q_f32(src + 8), vt);
+        m3 = vcltq_f32(vld1q_f32(src + 12), vt);
+    } else {
+        m0 = vcgtq_f32(vld1q_f32(src), vt);
+        m1 = vcgtq_f32(vld1q_f32(src + 4), vt);
+        m2 = vcgtq_f32(vld1q_f32(src + 8), vt);
+        m3 = vcgtq_f32(vld1q_f32(src + 12), vt);
+    }
+    uint16x8_t lo = vcombine_u16(vmovn_u32(m0), vmovn_u32(m1));
+    uint16x8_t hi = vcombine_u16(vmovn_u32(m2), vmovn_u32(m3));
+    return vcombine_u8(vmovn_u16(lo), vmovn_u16(hi));
+}
+#elif defined(__SSE2__)
+template <bool Below>
+inline __m128i Compare16(const float *src, __m128 vt) {
+    __m128 m0, m1, m2, m3;
+    if (Below) {
+        m0 = _mm_cmplt_ps(_mm_loadu_ps(src), vt);
+        m1 = _mm_cmplt_ps(_mm_loadu_ps(src + 4), vt);
+        m2 = _mm_cmplt_ps(_mm_loadu_ps(src + 8), vt);
+        m3 = _mm_cmplt_ps(_mm_loadu_ps(src + 12), vt);
+    } else {
+        m0 = _mm_cmpgt_ps(_mm_loadu_ps(src), vt);
+        m1 = _mm_cmpgt_ps(_mm_loadu_ps(src + 4), vt);
+        m2 = _mm_cmpgt_ps(_mm_loadu_ps(src + 8), vt);
+        m3 = _mm_cmpgt_ps(_mm_loadu_ps(src + 12), vt);
+    }
+    // all ones lanes stay all ones through the signed saturating packs
+    __m128i lo = _mm_packs_epi32(_mm_castps_si128(m0), _mm_castps_si128(m1));
+    __m128i hi = _mm_packs_epi32(_mm_castps_si128(m2), _mm_castps_si128(m3));
+    return _mm_packs_epi16(lo, hi);
+}
+#endif
+
+template <bool Below>
+inline bool IsForeground(float v, float threshold) {
+    return Below ? v < threshold : v > threshold;
+}
+
+template <bool Below>
+size_t ThresholdKernel(const float *src, size_t size, float threshold, uint8_t *dst) {
+    size_t i     = 0;
+    size_t count = 0;
+#if defined(TNN_USE_NEON)
+    const float32x4_t vt = vdupq_n_f32(threshold);
+    uint32x4_t vcount    = vdupq_n_u32(0);
+    for (; i + 16 <= size; i += 16) {
+        uint8x16_t m = Compare16<Below>(src + i, vt);
+        vst1q_u8(dst + i, m);
+        vcount = vpadalq_u16(vcount, vpaddlq_u8(vshrq_n_u8(m, 7)));
+    }
+    count += vgetq_lane_u32(vcount, 0) + vgetq_lane_u32(vcount, 1) + vgetq_lane_u32(vcount, 2) +
+             vgetq_lane_u32(vcount, 3);
+#elif defined(__SSE2__)
+    const __m128 vt = _mm_set1_ps(threshold);
+    for (; i + 16 <= size; i += 16) {
+        __m128i m = Compare16<Below>(src + i, vt);
+        _mm_storeu_si128((__m128i *)(dst + i), m);
+        count += __builtin_popcount(_mm_movemask_epi8(m));
+    }
+#endif
+    for (; i < size; ++i) {
+        bool fg = IsForeground<Below>(src[i], threshold);
+        dst[i]  = fg ? 0xff : 0;
+        count += fg;
+    }
+    return count;
+}
+
+template <bool Below>
+size_t ThresholdBitKernel(const float *src, size_t size, float threshold, uint8_t *bits) {
+    size_t i     = 0;
+    size_t count = 0;
+#if defined(TNN_USE_NEON)
+    const float32x4_t vt = vdupq_n_f32(threshold);
+    uint32x4_t vcount    = vdupq_n_u32(0);
+    for (; i + 16 <= size; i += 16) {
+        uint8x16_t m = Compare16<Below>(src + i, vt);
+        StoreBits16(m, bits + i / 8);
+        vcount = vpadalq_u16(vcount, vpaddlq_u8(vshrq_n_u8(m, 7)));
+    }
+    count += vgetq_lane_u32(vcount, 0) + vgetq_lane_u32(vcount, 1) + vgetq_lane_u32(vcount, 2) +
+             vgetq_lane_u32(vcount, 3);
+#elif defined(__SSE2__)
+    const __m128 vt = _mm_set1_ps(threshold);
+    for (; i + 16 <= size; i += 16) {
+        int m           = _mm_movemask_epi8(Compare16<Below>(src + i, vt));
+        bits[i / 8]     = static_cast<uint8_t>(m);
+        bits[i / 8 + 1] = static_cast<uint8_t>(m >> 8);
+        count += __builtin_popcount(m);
+    }
+#endif
+    // i is a multiple of 16 here, the tail starts on a byte boundary
+    memset(bits + i / 8, 0, BitMaskBytes(size) - i / 8);
+    for (; i < size; ++i) {
+        if (IsForeground<Below>(src[i], threshold)) {
+            bits[i / 8] |= 1 << (i % 8);
+            count++;
+        }
+    }
+    return count;
+}
+
+}  // namespace
+
+size_t ThresholdToMask(const float *src, size_t size, float threshold, bool below, uint8_t *dst) {
+    return below ? ThresholdKernel<true>(src, size, threshold, dst)
+                 : ThresholdKernel<false>(src, size, threshold, dst);
+}
+
+size_t ThresholdToMask(const uint8_t *src, size_t size, uint8_t threshold, uint8_t *dst) {
+    size_t i     = 0;
+    size_t count = 0;
+#if defined(TNN_USE_NEON)
+    const uint8x16_t vt = vdupq_n_u8(threshold);
+    uint32x4_t vcount   = vdupq_n_u32(0);
+    for (; i + 16 <= size; i += 16) {
+        uint8x16_t m = vcgeq_u8(vld1q_u8(src + i), vt);
+        vst1q_u8(dst + i, m);
+        vcount = vpadalq_u16(vcount, vpaddlq_u8(vshrq_n_u8(m, 7)));
+    }
+    count += vgetq_lane_u32(vcount, 0) + vgetq_lane_u32(vcount, 1) + vgetq_lane_u32(vcount, 2) +
+             vgetq_lane_u32(vcount, 3);
+#elif defined(__SSE2__)
+    const __m128i vt = _mm_set1_epi8((char)threshold);
+    for (; i + 16 <= size; i += 16) {
+        __m128i v = _mm_loadu_si128((const __m128i *)(src + i));
+        __m128i m = _mm_cmpeq_epi8(_mm_max_epu8(v, vt), v);
+        _mm_storeu_si128((__m128i *)(dst + i), m);
+        count += __builtin_popcount(_mm_movemask_epi8(m));
+    }
+#endif
+    for (; i < size; ++i) {
+        dst[i] = src[i] >= threshold ? 0xff : 0;
+        count += dst[i] != 0;
+    }
+    return count;
+}
+
+size_t ThresholdToBitMask(const float *src, size_t size, float threshold, bool below, uint8_t *dst) {
+    return below ? ThresholdBitKernel<true>(src, size, threshold, dst)
+                 : ThresholdBitKernel<false>(src, size, threshold, dst);
+}
+
+void UnpackBitMask(const uint8_t *bits, size_t size, uint8_t *dst) {
+    size_t i = 0;
+#if defined(TNN_USE_NEON)
+    const uint8x16_t weights = vld1q_u8(kBitWeights);
+    for (; i + 16 <= size; i += 16) {
+        uint8x16_t b = vcombine_u8(vdup_n_u8(bits[i / 8]), vdup_n_u8(bits[i / 8 + 1]));
+        vst1q_u8(dst + i, vtstq_u8(b, weights));
+    }
+#elif defined(__SSE2__)
+    const __m128i weights = _mm_set_epi8((char)128, 64, 32, 16, 8, 4, 2, 1, (char)128, 64, 32, 16, 8, 4, 2, 1);
+    const uint64_t splat  = 0x0101010101010101ULL;
+    for (; i + 16 <= size; i += 16) {
+        __m128i b = _mm_set_epi64x(static_cast<long long>(bits[i / 8 + 1] * splat),
+                                   static_cast<long long>(bits[i / 8] * splat));
+        _mm_storeu_si128((__m128i *)(dst + i), _mm_cmpeq_epi8(_mm_and_si128(b, weights), weights));
+    }
+#endif
+    for (; i < size; ++i) {
+        dst[i] = (bits[i / 8] >> (i % 8)) & 1 ? 0xff : 0;
+    }
+}
+
+size_t PackBitMask(const uint8_t *mask, size_t size, uint8_t *bits, uint8_t threshold) {
+    size_t i     = 0;
+    size_t count = 0;
+#if defined(TNN_USE_NEON)
+    const uint8x16_t vthreshold = vdupq_n_u8(threshold);
+    for (; i + 16 <= size; i += 16) {
+        uint8x16_t v = vld1q_u8(mask + i);
+        uint8x16_t m = vcgeq_u8(v, vthreshold);
+        StoreBits16(m, bits + i / 8);
+        count += __builtin_popcount(bits[i / 8]) + __builtin_popcount(bits[i / 8 + 1]);
+    }
+#elif defined(__SSE2__)
+    // unsigned v >= t is max(v, t) == v
+    const __m128i vthreshold = _mm_set1_epi8(static_cast<char>(threshold));
+    for (; i + 16 <= size; i += 16) {
+        __m128i v       = _mm_loadu_si128((const __m128i *)(mask + i));
+        int m           = _mm_movemask_epi8(_mm_cmpeq_epi8(_mm_max_epu8(v, vthreshold), v));
+        bits[i / 8]     = static_cast<uint8_t>(m);
+        bits[i / 8 + 1] = static_cast<uint8_t>(m >> 8);
+        count += __builtin_popcount(m);
+    }
+#endif
+    memset(bits + i / 8, 0, BitMaskBytes(size) - i / 8);
+    for (; i < size; ++i) {
+        if (mask[i] >= threshold) {
+            bits[i / 8] |= 1 << (i % 8);
+            count++;
+        }
+    }
+    return count;
+}
+
+bool MaskBoundingBox(const uint8_t *mask, int width, int height, int stride, int &x1, int &y1, int &x2, int &y2) {
+    // or every row into a column footprint, a row is hit if it has any non zero byte
+    std::vector<uint8_t> columns(width, 0);
+    int top = -1, bottom = -1;
+    for (int y = 0; y < height; ++y) {
+        const uint8_t *row = mask + static_cast<size_t>(y) * stride;
+        uint8_t *col       = columns.data();
+        uint8_t any        = 0;
+        int x              = 0;
+#if defined(TNN_USE_NEON)
+        uint8x16_t vany = vdupq_n_u8(0);
+        for (; x + 16 <= width; x += 16) {
+            uint8x16_t v = vld1q_u8(row + x);
+            vst1q_u8(col + x, vorrq_u8(vld1q_u8(col + x), v));
+            vany = vorrq_u8(vany, v);
+        }
+        uint8x8_t vany8 = vorr_u8(vget_low_u8(vany), vget_high_u8(vany));
+        any |= vget_lane_u64(vreinterpret_u64_u8(vany8), 0) != 0;
+#elif defined(__SSE2__)
+        __m128i vany = _mm_setzero_si128();
+        for (; x + 16 <= width; x += 16) {
+            __m128i v = _mm_loadu_si128((const __m128i *)(row + x));
+            _mm_storeu_si128((__m128i *)(col + x), _mm_or_si128(_mm_loadu_si128((const __m128i *)(col + x)), v));
+            vany = _mm_or_si128(vany, v);
+        }
+        any |= _mm_movemask_epi8(_mm_cmpeq_epi8(vany, _mm_setzero_si128())) != 0xffff;
+#endif
+        for (; x < width; ++x) {
+            col[x] |= row[x];
+            any |= row[x];
+        }
+        if (any) {
+            top    = top < 0 ? y : top;
+            bottom = y;
+        }
+    }
+    if (top < 0) {
+        return false;
+    }
+    int left = 0, right = width - 1;
+    while (!columns[left]) {
+        left++;
+    }
+    while (!columns[right]) {
+        right--;
+    }
+    x1 = left;
+    y1 = top;
+    x2 = right + 1;
+    y2 = bottom + 1;
+    return true;
+}
+
+namespace {
+
+// class ids of one row, the planes point at the row
+void ArgmaxRow(const float *const *rows, int num_classes, int width, uint8_t *ids) {
+    int x = 0;
+#if defined(TNN_USE_NEON)
+    for (; x + 8 <= width; x += 8) {
+        float32x4_t best0 = vld1q_f32(rows[0] + x), best1 = vld1q_f32(rows[0] + x + 4);
+        uint32x4_t id0 = vdupq_n_u32(0), id1 = vdupq_n_u32(0);
+        for (int c = 1; c < num_classes; ++c) {
+            float32x4_t v0 = vld1q_f32(rows[c] + x), v1 = vld1q_f32(rows[c] + x + 4);
+            uint32x4_t m0 = vcgtq_f32(v0, best0), m1 = vcgtq_f32(v1, best1);
+            uint32x4_t vc = vdupq_n_u32(c);
+            best0 = vbslq_f32(m0, v0, best0);
+            best1 = vbslq_f32(m1, v1, best1);
+            id0   = vbslq_u32(m0, vc, id0);
+            id1   = vbslq_u32(m1, vc, id1);
+        }
+        vst1_u8(ids + x, vmovn_u16(vcombine_u16(vmovn_u32(id0), vmovn_u32(id1))));
+    }
+#elif defined(__SSE2__)
+    for (; x + 8 <= width; x += 8) {
+        __m128 best0 = _mm_loadu_ps(rows[0] + x), best1 = _mm_loadu_ps(rows[0] + x + 4);
+        __m128i id0 = _mm_setzero_si128(), id1 = _mm_setzero_si128();
+        for (int c = 1; c < num_classes; ++c) {
+            __m128 v0 = _mm_loadu_ps(rows[c] + x), v1 = _mm_loadu_ps(rows[c] + x + 4);
+            __m128 m0 = _mm_cmpgt_ps(v0, best0), m1 = _mm_cmpgt_ps(v1, best1);
+            __m128i vc = _mm_set1_epi32(c);
+            // blend without sse4.1: (m & new) | (~m & old)
+            best0 = _mm_or_ps(_mm_and_ps(m0, v0), _mm_andnot_ps(m0, best0));
+            best1 = _mm_or_ps(_mm_and_ps(m1, v1), _mm_andnot_ps(m1, best1));
+            id0   = _mm_or_si128(_mm_and_si128(_mm_castps_si128(m0), vc), _mm_andnot_si128(_mm_castps_si128(m0), id0));
+            id1   = _mm_or_si128(_mm_and_si128(_mm_castps_si128(m1), vc), _mm_andnot_si128(_mm_castps_si128(m1), id1));
+        }
+        __m128i packed = _mm_packs_epi32(id0, id1);
+        _mm_storel_epi64((__m128i *)(ids + x), _mm_packus_epi16(packed, packed));
+    }
+#endif
+    for (; x < width; ++x) {
+        float best = rows[0][x];
+        int id     = 0;
+        for (int c = 1; c < num_classes; ++c) {
+            if (rows[c][x] > best) {
+                best = rows[c][x];
+                id   = c;
+            }
+        }
+        ids[x] = static_cast<uint8_t>(id);
+    }
+}
+
+// counts, boxes and codes of one row of class ids, x_min / x_max are scratch of num_classes
+void FinishRow(uint8_t *row, int width, int y, int num_classes, const uint8_t *codes, MaskClassStat *stats,
+               int *x_min, int *x_max) {
+    if (stats) {
+        std::fill(x_min, x_min + num_classes, INT_MAX);
+        std::fill(x_max, x_max + num_classes, -1);
+        for (int x = 0; x < width; ++x) {
+            const int c = row[x];
+            stats[c].count++;
+            x_min[c] = std::min(x_min[c], x);
+            x_max[c] = x;
+        }
+        for (int c = 0; c < num_classes; ++c) {
+            if (x_max[c] < 0) {
+                continue;
+            }
+            auto &stat = stats[c];
+            if (stat.x2 == 0) {
+                stat.x1 = x_min[c];
+                stat.y1 = y;
+            }
+            stat.x1 = std::min(stat.x1, x_min[c]);
+            stat.x2 = std::max(stat.x2, x_max[c] + 1);
+            stat.y2 = y + 1;
+        }
+    }
+    if (codes) {
+        for (int x = 0; x < width; ++x) {
+            row[x] = codes[row[x]];
+        }
+    }
+}
+
+}  // namespace
+
+void ArgmaxClasses(const float *const *planes, int num_classes, int width, int height, uint8_t *dst,
+                   const uint8_t *codes, MaskClassStat *stats) {
+    if (!planes || !dst || num_classes <= 0 || num_classes > 255 || width <= 0 || height <= 0) {
+        return;
+    }
+    if (stats) {
+        std::fill(stats, stats + num_classes, MaskClassStat());
+    }
+    std::vector<const float *> rows(num_classes);
+    std::vector<int> x_min(num_classes), x_max(num_classes);
+    for (int y = 0; y < height; ++y) {
+        for (int c = 0; c < num_classes; ++c) {
+            rows[c] = planes[c] + static_cast<size_t>(y) * width;
+        }
+        uint8_t *row = dst + static_cast<size_t>(y) * width;
+        ArgmaxRow(rows.data(), num_classes, width, row);
+        FinishRow(row, width, y, num_classes, codes, stats, x_min.data(), x_max.data());
+    }
+}
+
+void ArgmaxClasses(const uint16_t *const *planes, int num_classes, int width, int height, uint8_t *dst,
+                   const uint8_t *codes, MaskClassStat *stats) {
+    if (!planes || !dst || num_classes <= 0 || num_classes > 255 || width <= 0 || height <= 0) {
+        return;
+    }
+    if (stats) {
+        std::fill(stats, stats + num_classes, MaskClassStat());
+    }
+    std::vector<float> scratch(static_cast<size_t>(num_classes) * width);
+    std::vector<const float *> rows(num_classes);
+    std::vector<int> x_min(num_classes), x_max(num_classes);
+    for (int c = 0; c < num_classes; ++c) {
+        rows[c] = scratch.data() + static_cast<size_t>(c) * width;
+    }
+    for (int y = 0; y < height; ++y) {
+        for (int c = 0; c < num_classes; ++c) {
+            ConvertFromHalfToFloat((void *)(planes[c] + static_cast<size_t>(y) * width),
+                                   scratch.data() + static_cast<size_t>(c) * width, width);
+        }
+        uint8_t *row = dst + static_cast<size_t>(y) * width;
+        ArgmaxRow(rows.data(), num_classes, width, row);
+        FinishRow(row, width, y, num_classes, codes, stats, x_min.data(), x_max.data());
+    }
+}
+
+}  // namespace TNN_NS
@@ -0,0 +1,256 @@
+// Tencent is pleased to support the open source community by making TNN available.
+//
+// Copyright (C) 2020 THL A29 Limited, a Tencent company. All rights reserved.
+//
+// Licensed under the BSD 3-Clause License (the "License"); you may not use this file except
+// in compliance with the License. You may obtain a copy of the License at
+//
+// https://opensource.org/licenses/BSD-3-Clause
+//
+// Unless required by applicable law or agreed to in writing, software distributed
+// under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+// CONDITIONS OF ANY KIND, either express or implied. See the License for the
+// specific language governing permissions and limitations under the License.
+
+
+#include "motion_estimator.h"
+#include <algorithm>
+#include <climits>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+
+#if defined(TNN_USE_NEON)
+#include <arm_neon.h>
+#endif
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+namespace TNN_NS {
+
+uint32_t BlockSad(const uint8_t *a, int a_stride, const uint8_t *b, int b_stride, int width, int height) {
+    uint32_t sad = 0;
+    for (int y = 0; y < height; ++y) {
+        const uint8_t *ra = a + static_cast<size_t>(y) * a_stride;
+        const uint8_t *rb = b + static_cast<size_t>(y) * b_stride;
+        int x = 0;
+#if defined(TNN_USE_NEON)
+        uint16x8_t acc = vdupq_n_u16(0);
+        for (; x + 16 <= width; x += 16) {
+            uint8x16_t va = vld1q_u8(ra + x), vb = vld1q_u8(rb + x);
+            acc = vabal_u8(acc, vget_low_u8(va), vget_low_u8(vb));
+            acc = vabal_u8(acc, vget_high_u8(va), vget_high_u8(vb));
+        }
+        for (; x + 8 <= width; x += 8) {
+            acc = vabal_u8(acc, vld1_u8(ra + x), vld1_u8(rb + x));
+        }
+        uint64x2_t sum = vpaddlq_u32(vpaddlq_u16(acc));
+        sad += static_cast<uint32_t>(vgetq_lane_u64(sum, 0) + vgetq_lane_u64(sum, 1));
+#elif defined(__SSE2__)
+        __m128i acc = _mm_setzero_si128();
+        for (; x + 16 <= width; x += 16) {
+            acc = _mm_add_epi64(acc, _mm_sad_epu8(_mm_loadu_si128((const __m128i *)(ra + x)),
+                                                  _mm_loadu_si128((const __m128i *)(rb + x))));
+        }
+        for (; x + 8 <= width; x += 8) {
+            acc = _mm_add_epi64(acc, _mm_sad_epu8(_mm_loadl_epi64((const __m128i *)(ra + x)),
+                                                  _mm_loadl_epi64((const __m128i *)(rb + x))));
+        }
+        sad += static_cast<uint32_t>(_mm_cvtsi128_si32(acc) + _mm_cvtsi128_si32(_mm_srli_si128(acc, 8)));
+#endif
+        for (; x < width; ++x) {
+            sad += std::abs(ra[x] - rb[x]);
+        }
+    }
+    return sad;
+}
+
+Status DownsampleLuma(std::shared_ptr<Mat> frame, int factor, std::vector<uint8_t> &luma, int &width, int &height) {
+    if (!frame || !(frame->GetMatType() == N8UC3 || IsYUV420sp(frame)) || factor < 1) {
+        return Status(TNNERR_PARAM_ERR, "luma downsampling needs N8UC3 or NV21/NV12 frames");
+    }
+    const int w = frame->GetWidth(), h = frame->GetHeight();
+    width  = w / factor;
+    height = h / factor;
+    if (width <= 0 || height <= 0) {
+        return Status(TNNERR_PARAM_ERR, "luma downsampling got an empty frame");
+    }
+    luma.resize(static_cast<size_t>(width) * height);
+
+    // average of the 2x2 frame pixels at the centre of every luma pixel
+    const uint8_t *data = (const uint8_t *)frame->GetData();
+    const bool bgr      = frame->GetMatType() == N8UC3;
+    const int pitch     = bgr ? w * 3 : w;
+    const int half      = (factor - 1) / 2;
+    const int next      = factor > 1 ? 1 : 0;
+    for (int y = 0; y < height; ++y) {
+        const uint8_t *r0 = data + static_cast<size_t>(y * factor + half) * pitch;
+        const uint8_t *r1 = r0 + next * pitch;
+        uint8_t *dst      = luma.data() + static_cast<size_t>(y) * width;
+        for (int x = 0; x < width; ++x) {
+            const int sx = x * factor + half;
+            if (bgr) {
+                const uint8_t *p00 = r0 + sx * 3, *p01 = p00 + next * 3;
+                const uint8_t *p10 = r1 + sx * 3, *p11 = p10 + next * 3;
+                // channel order agnostic approximation of the luma
+                int sum = p00[0] + 2 * p00[1] + p00[2] + p01[0] + 2 * p01[1] + p01[2] + p10[0] + 2 * p10[1] +
+                          p10[2] + p11[0] + 2 * p11[1] + p11[2];
+                dst[x] = static_cast<uint8_t>(sum >> 4);
+            } else {
+                dst[x] = static_cast<uint8_t>((r0[sx] + r0[sx + next] + r1[sx] + r1[sx + next] + 2) >> 2);
+            }
+        }
+    }
+    return TNN_OK;
+}
+
+MotionEstimator::MotionEstimator(MotionEstimatorOption option) {
+    SetOption(option);
+}
+
+void MotionEstimator::SetOption(MotionEstimatorOption option) {
+    option.width        = std::max(option.width, 16);
+    option.block        = std::max(option.block, 4);
+    // vectors are stored as int8
+    option.global_range = std::min(std::max(option.global_range, 0), 64);
+    option.range        = std::min(std::max(option.range, 0), 32);
+    option_             = option;
+    Reset();
+}
+
+void MotionEstimator::Reset() {
+    has_frame_ = false;
+    has_prev_  = false;
+    estimated_ = false;
+}
+
+Status MotionEstimator::AddFrame(std::shared_ptr<Mat> frame) {
+    if (!frame) {
+        return Status(TNNERR_PARAM_ERR, "motion estimator got an empty frame");
+    }
+    const int w = frame->GetWidth(), h = frame->GetHeight();
+    if (w != frame_width_ || h != frame_height_) {
+        frame_width_  = w;
+        frame_height_ = h;
+        factor_       = std::max(1, w / option_.width);
+        Reset();
+    }
+    luma_.swap(prev_luma_);
+    auto status = DownsampleLuma(frame, factor_, luma_, width_, height_);
+    if (status != TNN_OK) {
+        Reset();
+        return status;
+    }
+    has_prev_  = has_frame_;
+    has_frame_ = true;
+    estimated_ = false;
+    return TNN_OK;
+}
+
+Status MotionEstimator::Estimate() {
+    if (!has_prev_) {
+        return Status(TNNERR_NO_RESULT, "motion estimator needs two frames of the same size");
+    }
+    const uint8_t *cur  = luma_.data();
+    const uint8_t *prev = prev_luma_.data();
+
+    // global: the interior of the current plane against the shifted previous one, ties keep 0
+    const int g = std::min(option_.global_range, std::min(width_, height_) / 4);
+    const int iw = width_ - 2 * g, ih = height_ - 2 * g;
+    global_x_ = global_y_ = 0;
+    if (g > 0 && iw > 0 && ih > 0) {
+        const uint8_t *origin = cur + g * width_ + g;
+        uint32_t best = BlockSad(origin, width_, prev + g * width_ + g, width_, iw, ih);
+        for (int dy = -g; dy <= g; ++dy) {
+            for (int dx = -g; dx <= g; ++dx) {
+                uint32_t sad = BlockSad(origin, width_, prev + (g + dy) * width_ + g + dx, width_, iw, ih);
+                if (sad < best) {
+                    best      = sad;
+                    global_x_ = dx;
+                    global_y_ = dy;
+                }
+            }
+        }
+    }
+
+    // blocks: refine around the global vector, keep it unless the gain is clear
+    const int b = option_.block;
+    blocks_x_   = (width_ + b - 1) / b;
+    blocks_y_   = (height_ + b - 1) / b;
+    block_x_.assign(static_cast<size_t>(blocks_x_) * blocks_y_, static_cast<int8_t>(global_x_));
+    block_y_.assign(static_cast<size_t>(blocks_x_) * blocks_y_, static_cast<int8_t>(global_y_));
+    for (int by = 0; by < blocks_y_; ++by) {
+        for (int bx = 0; bx < blocks_x_; ++bx) {
+            const int x0 = bx * b, y0 = by * b;
+            const int bw = std::min(b, width_ - x0), bh = std::min(b, height_ - y0);
+            const uint8_t *block = cur + y0 * width_ + x0;
+            auto sad_at = [&](int dx, int dy) {
+                if (x0 + dx < 0 || y0 + dy < 0 || x0 + dx + bw > width_ || y0 + dy + bh > height_) {
+                    return static_cast<uint32_t>(UINT_MAX);
+                }
+                return BlockSad(block, width_, prev + (y0 + dy) * width_ + x0 + dx, width_, bw, bh);
+            };
+            const uint32_t global_sad = sad_at(global_x_, global_y_);
+            uint32_t best = UINT_MAX;
+            int best_x = global_x_, best_y = global_y_;
+            for (int dy = global_y_ - option_.range; dy <= global_y_ + option_.range; ++dy) {
+                for (int dx = global_x_ - option_.range; dx <= global_x_ + option_.range; ++dx) {
+                    uint32_t sad = sad_at(dx, dy);
+                    if (sad < best) {
+                        best   = sad;
+                        best_x = dx;
+                        best_y = dy;
+                    }
+                }
+            }
+            if (global_sad == UINT_MAX ||
+                (best != UINT_MAX && best + static_cast<uint32_t>(option_.block_gain * bw * bh) < global_sad)) {
+                block_x_[by * blocks_x_ + bx] = static_cast<int8_t>(best_x);
+                block_y_[by * blocks_x_ + bx] = static_cast<int8_t>(best_y);
+            }
+        }
+    }
+    estimated_ = true;
+    return TNN_OK;
+}
+
+Status MotionEstimator::WarpMask(const uint8_t *src, int mask_width, int mask_height, const MatROI &roi,
+                                 uint8_t *dst) const {
+    if (!src || !dst || mask_width <= 0 || mask_height <= 0 || roi.width <= 0 || roi.height <= 0) {
+        return Status(TNNERR_PARAM_ERR, "motion estimator got an invalid mask");
+    }
+    if (!estimated_) {
+        memcpy(dst, src, static_cast<size_t>(mask_width) * mask_height);
+        return TNN_OK;
+    }
+    const float sx = static_cast<float>(roi.width) / mask_width;
+    const float sy = static_cast<float>(roi.height) / mask_height;
+    const int b    = option_.block * factor_;
+
+    // the frame position and block column of every mask column
+    std::vector<float> fx(mask_width);
+    std::vector<int> block_col(mask_width);
+    for (int x = 0; x < mask_width; ++x) {
+        fx[x]        = roi.left + (x + 0.5f) * sx;
+        block_col[x] = std::min(std::max(static_cast<int>(fx[x]) / b, 0), blocks_x_ - 1);
+    }
+    for (int y = 0; y < mask_height; ++y) {
+        const float fy      = roi.top + (y + 0.5f) * sy;
+        const int block_row = std::min(std::max(static_cast<int>(fy) / b, 0), blocks_y_ - 1);
+        const int8_t *vx    = block_x_.data() + block_row * blocks_x_;
+        const int8_t *vy    = block_y_.data() + block_row * blocks_x_;
+        uint8_t *out        = dst + static_cast<size_t>(y) * mask_width;
+        for (int x = 0; x < mask_width; ++x) {
+            const int c  = block_col[x];
+            const int mx = static_cast<int>(std::floor((fx[x] + vx[c] * factor_ - roi.left) / sx));
+            const int my = static_cast<int>(std::floor((fy + vy[c] * factor_ - roi.top) / sy));
+            out[x] = (mx < 0 || my < 0 || mx >= mask_width || my >= mask_height)
+                         ? 0
+                         : src[static_cast<size_t>(my) * mask_width + mx];
+        }
+    }
+    return TNN_OK;
+}
+
+}  // namespace TNN_NS
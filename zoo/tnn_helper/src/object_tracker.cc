@@ -0,0 +1,213 @@
+// Tencent is pleased to support the open source community by making TNN available.
+//
+// Copyright (C) 2020 THL A29 Limited, a Tencent company. All rights reserved.
+//
+// Licensed under the BSD 3-Clause License (the "License"); you may not use this file except
+// in compliance with the License. You may obtain a copy of the License at
+//
+// https://opensource.org/licenses/BSD-3-Clause
+//
+// Unless required by applicable law or agreed to in writing, software distributed
+// under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+// CONDITIONS OF ANY KIND, either express or implied. See the License for the
+// specific language governing permissions and limitations under the License.
+
+#include "object_tracker.h"
+#include <algorithm>
+#include <cmath>
+
+namespace TNN_NS {
+
+ObjectInfo ObjectTrack::ToObjectInfo() const {
+    ObjectInfo info;
+    info.x1           = cx - w / 2;
+    info.y1           = cy - h / 2;
+    info.x2           = cx + w / 2;
+    info.y2           = cy + h / 2;
+    info.score        = confidence;
+    info.class_id     = class_id;
+    info.image_width  = image_width;
+    info.image_height = image_height;
+    return info;
+}
+
+ObjectTracker::ObjectTracker(ObjectTrackerOption option) : option_(option) {}
+
+void ObjectTracker::SetOption(ObjectTrackerOption option) {
+    option_ = option;
+}
+
+void ObjectTracker::Reset() {
+    tracks_.clear();
+    frames_since_update_ = 0;
+}
+
+std::vector<ObjectInfo> ObjectTracker::Predict() {
+    for (auto &track : tracks_) {
+        track.cx += track.vx;
+        track.cy += track.vy;
+        track.w   = std::max(track.w + track.vw, 1.0f);
+        track.h   = std::max(track.h + track.vh, 1.0f);
+        track.age++;
+        track.confidence *= option_.confidence_decay;
+    }
+    frames_since_update_++;
+    return GetObjects();
+}
+
+/*
+ * same math as ObjectInfo::IntersectionRatio, laid out as a dense [tracks x detections] matrix
+ */
+void ObjectTracker::ComputeIoUMatrix(const std::vector<ObjectInfo> &detections, std::vector<float> &ious) const {
+    const int num_tracks = static_cast<int>(tracks_.size());
+    const int num_dets   = static_cast<int>(detections.size());
+    ious.assign(num_tracks * num_dets, 0.0f);
+
+    std::vector<float> det_area(num_dets);
+    for (int d = 0; d < num_dets; d++) {
+        const auto &det = detections[d];
+        det_area[d]     = std::abs((det.x2 - det.x1) * (det.y2 - det.y1));
+    }
+
+    for (int t = 0; t < num_tracks; t++) {
+        const auto &track = tracks_[t];
+        const float tx1 = track.cx - track.w / 2, tx2 = track.cx + track.w / 2;
+        const float ty1 = track.cy - track.h / 2, ty2 = track.cy + track.h / 2;
+        const float track_area = track.w * track.h;
+        float *row = ious.data() + t * num_dets;
+        for (int d = 0; d < num_dets; d++) {
+            const auto &det = detections[d];
+            float x1 = std::max(det.x1, tx1);
+            float x2 = std::min(det.x2, tx2);
+            float y1 = std::max(det.y1, ty1);
+            float y2 = std::min(det.y2, ty2);
+            float area = (x2 > x1 && y2 > y1) ? (x2 - x1) * (y2 - y1) : 0;
+            float denom = track_area + det_area[d] - area;
+            row[d] = denom > 0 ? area / denom : 0;
+        }
+    }
+}
+
+std::vector<ObjectInfo> ObjectTracker::Update(const std::vector<ObjectInfo> &detections) {
+    const int num_tracks = static_cast<int>(tracks_.size());
+    const int num_dets   = static_cast<int>(detections.size());
+
+    std::vector<float> ious;
+    ComputeIoUMatrix(detections, ious);
+
+    // greedy assignment, best IoU pairs first
+    std::vector<std::pair<float, int>> candidates;
+    for (int i = 0; i < num_tracks * num_dets; i++) {
+        if (ious[i] >= option_.iou_threshold) {
+            candidates.emplace_back(ious[i], i);
+        }
+    }
+    std::sort(candidates.begin(), candidates.end(),
+              [](const std::pair<float, int> &a, const std::pair<float, int> &b) { return a.first > b.first; });
+
+    std::vector<int> track_matched(num_tracks, 0);
+    std::vector<int> det_matched(num_dets, 0);
+    for (const auto &candidate : candidates) {
+        int t = candidate.second / num_dets;
+        int d = candidate.second % num_dets;
+        if (track_matched[t] || det_matched[d]) {
+            continue;
+        }
+        track_matched[t] = 1;
+        det_matched[d]   = 1;
+
+        auto &track     = tracks_[t];
+        const auto &det = detections[d];
+        // residual against the prediction, spread over the frames since the last update
+        float rx = (det.x1 + det.x2) / 2 - track.cx;
+        float ry = (det.y1 + det.y2) / 2 - track.cy;
+        float rw = (det.x2 - det.x1) - track.w;
+        float rh = (det.y2 - det.y1) - track.h;
+        float steps = static_cast<float>(std::max(track.age, 1));
+
+        track.cx += option_.position_gain * rx;
+        track.cy += option_.position_gain * ry;
+        track.w  += option_.position_gain * rw;
+        track.h  += option_.position_gain * rh;
+        track.vx += option_.velocity_gain * rx / steps;
+        track.vy += option_.velocity_gain * ry / steps;
+        track.vw += option_.velocity_gain * rw / steps;
+        track.vh += option_.velocity_gain * rh / steps;
+
+        track.confidence   = det.score;
+        track.class_id     = det.class_id;
+        track.image_width  = det.image_width;
+        track.image_height = det.image_height;
+        track.hits++;
+        track.age = 0;
+    }
+
+    tracks_.erase(std::remove_if(tracks_.begin(), tracks_.end(),
+                                 [&](const ObjectTrack &track) { return track.age > option_.max_age; }),
+                  tracks_.end());
+
+    for (int d = 0; d < num_dets; d++) {
+        if (det_matched[d]) {
+            continue;
+        }
+        const auto &det = detections[d];
+        ObjectTrack track;
+        track.id           = next_id_++;
+        track.cx           = (det.x1 + det.x2) / 2;
+        track.cy           = (det.y1 + det.y2) / 2;
+        track.w            = det.x2 - det.x1;
+        track.h            = det.y2 - det.y1;
+        track.confidence   = det.score;
+        track.class_id     = det.class_id;
+        track.image_width  = det.image_width;
+        track.image_height = det.image_height;
+        track.hits         = 1;
+        tracks_.push_back(track);
+    }
+
+    frames_since_update_ = 0;
+    return GetConfirmedObjects();
+}
+
+std::vector<ObjectInfo> ObjectTracker::GetObjects() const {
+    std::vector<ObjectInfo> objects;
+    objects.reserve(tracks_.size());
+    for (const auto &track : tracks_) {
+        objects.push_back(track.ToObjectInfo());
+    }
+    return objects;
+}
+
+std::vector<ObjectInfo> ObjectTracker::GetConfirmedObjects() const {
+    std::vector<ObjectInfo> objects;
+    for (const auto &track : tracks_) {
+        if (IsConfirmed(track)) {
+            objects.push_back(track.ToObjectInfo());
+        }
+    }
+    return objects;
+}
+
+bool ObjectTracker::IsEmpty() const {
+    return tracks_.empty();
+}
+
+float ObjectTracker::GetConfidence() const {
+    // unmatched tracks only linger for max_age and must not force the detector to run
+    float confidence = 0;
+    bool found = false;
+    for (const auto &track : tracks_) {
+        if (IsConfirmed(track)) {
+            confidence = found ? std::min(confidence, track.confidence) : track.confidence;
+            found = true;
+        }
+    }
+    return confidence;
+}
+
+bool ObjectTracker::IsConfirmed(const ObjectTrack &track) const {
+    // a track matched by the last update has aged exactly once per prediction since
+    return track.age <= frames_since_update_;
+}
+
+}  // namespace TNN_NS
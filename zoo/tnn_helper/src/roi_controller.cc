@@ -0,0 +1,139 @@
+// Tencent is pleased to support the open source community by making TNN available.
+//
+// Copyright (C) 2020 THL A29 Limited, a Tencent company. All rights reserved.
+//
+// Licensed under the BSD 3-Clause License (the "License"); you may not use this file except
+// in compliance with the License. You may obtain a copy of the License at
+//
+// https://opensource.org/licenses/BSD-3-Clause
+//
+// Unless required by applicable law or agreed to in writing, software distributed
+// under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+// CONDITIONS OF ANY KIND, either express or implied. See the License for the
+// specific language governing permissions and limitations under the License.
+
+#include "roi_controller.h"
+#include <algorithm>
+#include <cmath>
+
+namespace TNN_NS {
+
+RoiController::RoiController(RoiControllerOption option) : option_(option) {}
+
+void RoiController::SetOption(RoiControllerOption option) {
+    option_ = option;
+}
+
+void RoiController::SetFrameSize(int width, int height) {
+    if (width != frame_width_ || height != frame_height_) {
+        frame_width_  = width;
+        frame_height_ = height;
+        valid_        = false;
+        lost_         = 0;
+    }
+}
+
+void RoiController::SetSnapSize(int width, int height) {
+    snap_width_  = width;
+    snap_height_ = height;
+}
+
+void RoiController::Reset() {
+    valid_ = false;
+    lost_  = 0;
+    stat_  = RoiStat();
+}
+
+void RoiController::Update(const std::vector<ObjectInfo> &targets) {
+    if (targets.empty() || frame_width_ <= 0 || frame_height_ <= 0) {
+        Lost();
+        return;
+    }
+    float x1 = targets[0].x1, y1 = targets[0].y1, x2 = targets[0].x2, y2 = targets[0].y2;
+    for (const auto &target : targets) {
+        x1 = std::min(x1, target.x1);
+        y1 = std::min(y1, target.y1);
+        x2 = std::max(x2, target.x2);
+        y2 = std::max(y2, target.y2);
+    }
+    const float mx = (x2 - x1) * option_.margin;
+    const float my = (y2 - y1) * option_.margin;
+    x1 = std::max(x1 - mx, 0.0f);
+    y1 = std::max(y1 - my, 0.0f);
+    x2 = std::min(x2 + mx, static_cast<float>(frame_width_));
+    y2 = std::min(y2 + my, static_cast<float>(frame_height_));
+    if (x2 <= x1 || y2 <= y1) {
+        Lost();
+        return;
+    }
+
+    if (!valid_) {
+        x1_ = x1;
+        y1_ = y1;
+        x2_ = x2;
+        y2_ = y2;
+    } else {
+        // expand at once, shrink with the ema
+        const float a = option_.smoothing;
+        x1_ = x1 < x1_ ? x1 : x1_ + (x1 - x1_) * a;
+        y1_ = y1 < y1_ ? y1 : y1_ + (y1 - y1_) * a;
+        x2_ = x2 > x2_ ? x2 : x2_ + (x2 - x2_) * a;
+        y2_ = y2 > y2_ ? y2 : y2_ + (y2 - y2_) * a;
+    }
+    valid_ = true;
+    lost_  = 0;
+}
+
+void RoiController::Lost() {
+    if (++lost_ > option_.max_lost) {
+        valid_ = false;
+    }
+}
+
+bool RoiController::IsFullFrame() const {
+    return !valid_;
+}
+
+void RoiController::Snap(int &left, int &top, int &width, int &height) const {
+    const int align = std::max(option_.align, 1);
+    const float cx  = (x1_ + x2_) / 2;
+    const float cy  = (y1_ + y2_) / 2;
+    width  = (static_cast<int>(std::ceil(x2_ - x1_)) + align - 1) / align * align;
+    height = (static_cast<int>(std::ceil(y2_ - y1_)) + align - 1) / align * align;
+
+    // the exact network size when close enough and not smaller than the target
+    if (snap_width_ > 0 && snap_height_ > 0 && snap_width_ <= frame_width_ && snap_height_ <= frame_height_) {
+        const float tw = snap_width_ * (1 + option_.snap_tolerance);
+        const float th = snap_height_ * (1 + option_.snap_tolerance);
+        if (width <= tw && height <= th && x2_ - x1_ <= snap_width_ && y2_ - y1_ <= snap_height_) {
+            width  = snap_width_;
+            height = snap_height_;
+        }
+    }
+    width  = std::min(width, frame_width_);
+    height = std::min(height, frame_height_);
+    left   = std::min(std::max(static_cast<int>(std::lround(cx - width / 2.0f)), 0), frame_width_ - width);
+    top    = std::min(std::max(static_cast<int>(std::lround(cy - height / 2.0f)), 0), frame_height_ - height);
+}
+
+void RoiController::GetRoi(int &left, int &top, int &width, int &height) {
+    left   = 0;
+    top    = 0;
+    width  = frame_width_;
+    height = frame_height_;
+    if (valid_) {
+        int l, t, w, h;
+        Snap(l, t, w, h);
+        if (static_cast<float>(w) * h < option_.full_frame_ratio * frame_width_ * frame_height_) {
+            left   = l;
+            top    = t;
+            width  = w;
+            height = h;
+        }
+    }
+    stat_.frames++;
+    stat_.pixels_processed += static_cast<int64_t>(width) * height;
+    stat_.pixels_full += static_cast<int64_t>(frame_width_) * frame_height_;
+}
+
+}  // namespace TNN_NS
@@ -14,10 +14,15 @@
 
 #include "tnn_sdk_sample.h"
 #include "tnn/utils/dims_vector_utils.h"
+#include "frame_pyramid.h"
+#include "yuv_utils.h"
 #include <algorithm>
 #include <cstring>
 #include <sys/time.h>
 #include <float.h>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
 #include <thread>
 
 #if defined(__APPLE__)
@@ -373,6 +378,12 @@ Status TNNSDKSample::GetCommandQueue(void **command_queue) {
 
 Status TNNSDKSample::Resize(std::shared_ptr<TNN_NS::Mat> src, std::shared_ptr<TNN_NS::Mat> dst, TNNInterpType interp_type) {
     Status status = TNN_OK;
+    if (IsYUV420sp(src)) {
+        MatROI roi;
+        roi.width = src->GetWidth();
+        roi.height = src->GetHeight();
+        return CropAndResize(src, dst, roi, interp_type);
+    }
     
     void * command_queue = nullptr;
     status = GetCommandQueue(&command_queue);
@@ -406,6 +417,14 @@ Status TNNSDKSample::Resize(std::shared_ptr<TNN_NS::Mat> src, std::shared_ptr<TN
 
 Status TNNSDKSample::Crop(std::shared_ptr<TNN_NS::Mat> src, std::shared_ptr<TNN_NS::Mat> dst, int start_x, int start_y) {
     Status status = TNN_OK;
+    if (IsYUV420sp(src)) {
+        MatROI roi;
+        roi.left = start_x;
+        roi.top = start_y;
+        roi.width = dst->GetWidth();
+        roi.height = dst->GetHeight();
+        return CropAndResize(src, dst, roi, TNNInterpLinear);
+    }
     
     void *command_queue = nullptr;
     status = GetCommandQueue(&command_queue);
@@ -431,6 +450,14 @@ Status TNNSDKSample::Crop(std::shared_ptr<TNN_NS::Mat> src, std::shared_ptr<TNN_
 
 Status TNNSDKSample::ResizeAndMakeBorder(std::shared_ptr<TNN_NS::Mat> src, std::shared_ptr<TNN_NS::Mat> dst) {
     Status status = TNN_OK;
+    if (IsYUV420sp(src)) {
+        MatROI roi;
+        roi.width = src->GetWidth();
+        roi.height = src->GetHeight();
+        float scale = 1;
+        int dx = 0, dy = 0;
+        return CropAndLetterbox(src, dst, roi, scale, dx, dy);
+    }
 
     void *command_queue = nullptr;
     status = GetCommandQueue(&command_queue);
@@ -487,8 +514,123 @@ Status TNNSDKSample::ResizeAndMakeBorder(std::shared_ptr<TNN_NS::Mat> src, std::
     return status;
 }
 
+Status TNNSDKSample::CropAndResize(std::shared_ptr<TNN_NS::Mat> src, std::shared_ptr<TNN_NS::Mat> dst, const MatROI &roi, TNNInterpType interp_type) {
+    if (roi.width <= 0 || roi.height <= 0) {
+        return Status(TNNERR_PARAM_ERR, "crop roi is empty");
+    }
+    auto dst_dims = dst->GetDims();
+    // Mat has no row stride, so the roi is the source window of a warp. pixel centres are
+    // aligned like Resize: dst + 0.5 = (src - roi + 0.5) * scale
+    float scale_x = dst_dims[3] / static_cast<float>(roi.width);
+    float scale_y = dst_dims[2] / static_cast<float>(roi.height);
+    float trans_mat[2][3] = {{scale_x, 0, (0.5f - roi.left) * scale_x - 0.5f},
+                             {0, scale_y, (0.5f - roi.top) * scale_y - 0.5f}};
+    return WarpAffine(src, dst, interp_type, TNNBorderConstant, trans_mat);
+}
+
+Status TNNSDKSample::CropAndLetterbox(std::shared_ptr<TNN_NS::Mat> src, std::shared_ptr<TNN_NS::Mat> dst, const MatROI &roi, float &scale, int &dx, int &dy) {
+    if (roi.width <= 0 || roi.height <= 0) {
+        return Status(TNNERR_PARAM_ERR, "crop roi is empty");
+    }
+    // same geometry as ResizeAndMakeBorder
+    auto dst_dims = dst->GetDims();
+    int ow = dst_dims[3];
+    int oh = dst_dims[2];
+    int nw = ow;
+    int nh = nw * roi.height / roi.width;
+    scale = ow * 1.0f / roi.width;
+    if (nh > oh) {
+        nh = oh;
+        nw = nh * roi.width / roi.height;
+        scale = oh * 1.0f / roi.height;
+    }
+    dx = (ow - nw) / 2;
+    dy = (oh - nh) / 2;
+
+    float scale_x = nw / static_cast<float>(roi.width);
+    float scale_y = nh / static_cast<float>(roi.height);
+    float trans_mat[2][3] = {{scale_x, 0, (0.5f - roi.left) * scale_x - 0.5f + dx},
+                             {0, scale_y, (0.5f - roi.top) * scale_y - 0.5f + dy}};
+    auto status = WarpAffine(src, dst, TNNInterpLinear, TNNBorderConstant, trans_mat);
+    RETURN_ON_NEQ(status, TNN_OK);
+
+    // the warp sees the image around the roi, the bands beside it must be border like in ResizeAndMakeBorder
+    auto mat_type = dst->GetMatType();
+    if ((nw < ow || nh < oh) && (mat_type == N8UC3 || mat_type == N8UC4 || mat_type == NGRAY)) {
+        const int pixel = mat_type == N8UC3 ? 3 : (mat_type == N8UC4 ? 4 : 1);
+        uint8_t *data = (uint8_t *)dst->GetData();
+        const size_t row = (size_t)ow * pixel;
+        memset(data, 0, dy * row);
+        memset(data + (dy + nh) * row, 0, (oh - dy - nh) * row);
+        for (int y = dy; y < dy + nh; ++y) {
+            memset(data + y * row, 0, dx * pixel);
+            memset(data + y * row + (dx + nw) * pixel, 0, (ow - dx - nw) * pixel);
+        }
+    }
+    return status;
+}
+
+void TNNSDKSample::SetFramePyramid(std::shared_ptr<FramePyramid> pyramid) {
+    pyramid_ = pyramid;
+}
+
+std::shared_ptr<Mat> TNNSDKSample::ResizeFromFrame(std::shared_ptr<Mat> src, const MatROI &roi, DimsVector dims) {
+    std::shared_ptr<Mat> dst = nullptr;
+    Status status = TNN_OK;
+    if (pyramid_ && pyramid_->IsFrame(src)) {
+        status = pyramid_->GetResized(*this, roi, dims[3], dims[2], dst);
+    } else {
+        dst = std::make_shared<TNN_NS::Mat>(src->GetDeviceType(), IsYUV420sp(src) ? N8UC3 : src->GetMatType(), dims);
+        bool whole = roi.left == 0 && roi.top == 0 && roi.width == src->GetWidth() && roi.height == src->GetHeight();
+        status = whole ? Resize(src, dst, TNNInterpLinear) : CropAndResize(src, dst, roi, TNNInterpLinear);
+    }
+    if (status != TNN_OK) {
+        LOGE("resize from frame failed with:%s\n", status.description().c_str());
+        return nullptr;
+    }
+    return dst;
+}
+
+std::shared_ptr<Mat> TNNSDKSample::LetterboxFromFrame(std::shared_ptr<Mat> src, const MatROI &roi, DimsVector dims, float &scale, int &dx, int &dy) {
+    std::shared_ptr<Mat> dst = nullptr;
+    Status status = TNN_OK;
+    if (pyramid_ && pyramid_->IsFrame(src)) {
+        status = pyramid_->GetLetterboxed(*this, roi, dims[3], dims[2], dst, scale, dx, dy);
+    } else {
+        dst = std::make_shared<TNN_NS::Mat>(src->GetDeviceType(), IsYUV420sp(src) ? N8UC3 : src->GetMatType(), dims);
+        status = CropAndLetterbox(src, dst, roi, scale, dx, dy);
+    }
+    if (status != TNN_OK) {
+        LOGE("letterbox from frame failed with:%s\n", status.description().c_str());
+        return nullptr;
+    }
+    return dst;
+}
+
+Status TNNSDKSample::SetInstanceInput(std::shared_ptr<Mat> mat, MatConvertParam param, std::string name) {
+    auto normalized = pyramid_ ? pyramid_->GetNormalized(mat, param) : nullptr;
+    if (normalized) {
+        mat = normalized;
+        param = MatConvertParam();
+    }
+    return instance_->SetInputMat(mat, param, name);
+}
+
 Status TNNSDKSample::WarpAffine(std::shared_ptr<TNN_NS::Mat> src, std::shared_ptr<TNN_NS::Mat> dst, TNNInterpType interp_type, TNNBorderType border_type, float trans_mat[2][3]) {
     Status status = TNN_OK;
+    if (IsYUV420sp(src)) {
+        // scale + translate from a camera frame, converted only where it is sampled
+        RETURN_VALUE_ON_NEQ(dst->GetMatType() != N8UC3 || trans_mat[0][1] != 0 || trans_mat[1][0] != 0 ||
+                            trans_mat[0][0] <= 0 || trans_mat[1][1] <= 0, false,
+                            Status(TNNERR_PARAM_ERR, "yuv frames only warp to N8UC3 by scale and translation"));
+        // dst = s * src + t, so src = (dst + 0.5) / s + 0.5 - (t + 0.5) / s - 0.5
+        float sx = trans_mat[0][0];
+        float sy = trans_mat[1][1];
+        return YUV420spToBGRMapped((const uint8_t *)src->GetData(), src->GetWidth(), src->GetHeight(),
+                                   src->GetMatType() == NNV21, (uint8_t *)dst->GetData(), dst->GetWidth(),
+                                   dst->GetHeight(), dst->GetWidth() * 3, 1.0f / sx, 0.5f - (trans_mat[0][2] + 0.5f) / sx,
+                                   1.0f / sy, 0.5f - (trans_mat[1][2] + 0.5f) / sy);
+    }
     
     void * command_queue = nullptr;
     status = GetCommandQueue(&command_queue);
@@ -552,6 +694,7 @@ void TNNSDKSample::setNpuModelPath(std::string stored_path)
 
 TNN_NS::Status TNNSDKSample::Init(std::shared_ptr<TNNSDKOption> option) {
     option_ = option;
+    frame_gate_.SetOption(option->frame_gate);
     //网络初始化
     TNN_NS::Status status;
     if (!net_) {
@@ -729,6 +872,19 @@ TNN_NS::Status TNNSDKSample::Predict(std::shared_ptr<TNNSDKInput> input, std::sh
         LOGE("input image is empty ,please check!\n");
         return status;
     }
+
+    if (option_ && option_->frame_gate.enabled && GetInputNames().size() == 1) {
+        auto decision = frame_gate_.Check(input->GetMat());
+        if (decision == TNNFrameGateReuse) {
+            status = ReuseLastOutput(output);
+            if (status == TNN_OK || status == TNNERR_NO_RESULT) {
+                return status;
+            }
+            frame_gate_.Reject();
+        } else if (decision == TNNFrameGateSceneChange) {
+            ResetTemporalState();
+        }
+    }
     
 #if TNN_SDK_ENABLE_BENCHMARK
     bench_result_.Reset();
@@ -743,14 +899,14 @@ TNN_NS::Status TNNSDKSample::Predict(std::shared_ptr<TNNSDKInput> input, std::sh
             auto input_mat = input->GetMat();
             input_mat = ProcessSDKInputMat(input_mat);
             auto input_convert_param = GetConvertParamForInput();
-            auto status = instance_->SetInputMat(input_mat, input_convert_param);
+            auto status = SetInstanceInput(input_mat, input_convert_param);
             RETURN_ON_NEQ(status, TNN_NS::TNN_OK);
         } else {
             for (auto name : input_names) {
                 auto input_mat = input->GetMat(name);
                 input_mat = ProcessSDKInputMat(input_mat, name);
                 auto input_convert_param = GetConvertParamForInput(name);
-                auto status = instance_->SetInputMat(input_mat, input_convert_param, name);
+                auto status = SetInstanceInput(input_mat, input_convert_param, name);
                 RETURN_ON_NEQ(status, TNN_NS::TNN_OK);
             }
         }
@@ -797,10 +953,17 @@ TNN_NS::Status TNNSDKSample::Predict(std::shared_ptr<TNNSDKInput> input, std::sh
     return status;
 }
 
+Status TNNSDKSample::ReuseLastOutput(std::shared_ptr<TNNSDKOutput> &output) {
+    return Status(TNNERR_COMMON_ERROR, "the sample can not reuse its output");
+}
+
+void TNNSDKSample::ResetTemporalState() {}
+
 #pragma mark - TNNSDKComposeSample
 TNNSDKComposeSample::TNNSDKComposeSample() {}
 
 TNNSDKComposeSample::~TNNSDKComposeSample() {
+    StopWorkers();
     sdks_ = {};
 }
 
@@ -833,10 +996,192 @@ DimsVector TNNSDKComposeSample::GetInputShape(std::string name) {
 
 TNN_NS::Status TNNSDKComposeSample::Predict(std::shared_ptr<TNNSDKInput> input,
                                             std::shared_ptr<TNNSDKOutput> &output) {
+    if (!stages_.empty()) {
+        return RunStages(input);
+    }
     LOGE("subclass of TNNSDKComposeSample must implement this interface\n");
     return Status(TNNERR_NO_RESULT, "subclass of TNNSDKComposeSample must implement this interface");
 }
 
+Status TNNSDKComposeSample::AddStage(const TNNSDKStage &stage) {
+    if (stage.name.empty() || !stage.run) {
+        return Status(TNNERR_PARAM_ERR, "compose stage needs a name and a run function");
+    }
+    auto known = [&](const std::string &name) {
+        return std::any_of(stages_.begin(), stages_.end(), [&](const TNNSDKStage &s) { return s.name == name; });
+    };
+    if (known(stage.name)) {
+        return Status(TNNERR_PARAM_ERR, "compose stage " + stage.name + " is added twice");
+    }
+    for (const auto &dep : stage.inputs) {
+        if (!known(dep)) {
+            return Status(TNNERR_PARAM_ERR, "compose stage " + stage.name + " depends on unknown stage " + dep);
+        }
+    }
+    for (const auto &dep : stage.after) {
+        if (!known(dep)) {
+            return Status(TNNERR_PARAM_ERR, "compose stage " + stage.name + " depends on unknown stage " + dep);
+        }
+    }
+    stages_.push_back(stage);
+    return TNN_OK;
+}
+
+// the dependency graph and progress of one RunStages, guarded by stage_mutex_
+struct TNNSDKComposeSample::StageRun {
+    std::shared_ptr<TNNSDKInput> input;
+    // gates are the inputs, waits are inputs and after
+    std::vector<std::vector<int>> gates;
+    std::vector<std::vector<int>> waits;
+    std::vector<std::vector<int>> dependants;
+    std::vector<int> pending;
+    std::vector<Status> results;
+    std::deque<int> ready;
+    int finished = 0;
+    std::chrono::steady_clock::time_point begin;
+};
+
+void TNNSDKComposeSample::SetNumThreads(int num_threads) {
+    StopWorkers();
+    num_threads_ = std::max(num_threads, 1);
+    for (int t = 1; t < num_threads_; ++t) {
+        workers_.emplace_back(&TNNSDKComposeSample::WorkerLoop, this);
+    }
+}
+
+void TNNSDKComposeSample::StopWorkers() {
+    {
+        std::lock_guard<std::mutex> lock(stage_mutex_);
+        stop_workers_ = true;
+    }
+    stage_cond_.notify_all();
+    for (auto &worker : workers_) {
+        worker.join();
+    }
+    workers_.clear();
+    stop_workers_ = false;
+}
+
+void TNNSDKComposeSample::WorkerLoop() {
+    std::unique_lock<std::mutex> lock(stage_mutex_);
+    while (true) {
+        stage_cond_.wait(lock, [&]() { return stop_workers_ || (stage_run_ && !stage_run_->ready.empty()); });
+        if (stop_workers_) {
+            return;
+        }
+        RunReadyStages(lock);
+    }
+}
+
+void TNNSDKComposeSample::RunReadyStages(std::unique_lock<std::mutex> &lock) {
+    while (stage_run_ && !stage_run_->ready.empty()) {
+        StageRun &run = *stage_run_;
+        int i = run.ready.front();
+        run.ready.pop_front();
+        bool skip = false;
+        for (int gate : run.gates[i]) {
+            skip = skip || stage_stats_[gate].skipped || run.results[gate] != TNN_OK;
+        }
+        lock.unlock();
+
+        auto t1 = std::chrono::steady_clock::now();
+        Status status = skip ? Status(TNNERR_NO_RESULT, "skipped") : stages_[i].run(run.input);
+        auto t2 = std::chrono::steady_clock::now();
+
+        lock.lock();
+        run.results[i] = status;
+        stage_stats_[i].skipped = skip;
+        stage_stats_[i].start = std::chrono::duration<float, std::milli>(t1 - run.begin).count();
+        stage_stats_[i].time = std::chrono::duration<float, std::milli>(t2 - t1).count();
+        run.finished++;
+        for (int dependant : run.dependants[i]) {
+            if (--run.pending[dependant] == 0) {
+                run.ready.push_back(dependant);
+            }
+        }
+        stage_cond_.notify_all();
+    }
+}
+
+Status TNNSDKComposeSample::RunStages(std::shared_ptr<TNNSDKInput> input) {
+    const int count = static_cast<int>(stages_.size());
+    auto index_of = [&](const std::string &name) {
+        for (int i = 0; i < count; ++i) {
+            if (stages_[i].name == name) {
+                return i;
+            }
+        }
+        return -1;
+    };
+    StageRun run;
+    run.input = input;
+    run.gates.resize(count);
+    run.waits.resize(count);
+    run.dependants.resize(count);
+    run.pending.assign(count, 0);
+    run.results.assign(count, TNN_OK);
+    for (int i = 0; i < count; ++i) {
+        for (const auto &dep : stages_[i].inputs) {
+            run.gates[i].push_back(index_of(dep));
+            run.waits[i].push_back(index_of(dep));
+        }
+        for (const auto &dep : stages_[i].after) {
+            run.waits[i].push_back(index_of(dep));
+        }
+        for (int dep : run.waits[i]) {
+            run.dependants[dep].push_back(i);
+            run.pending[i]++;
+        }
+    }
+
+    stage_stats_.assign(count, TNNSDKStageStat());
+    for (int i = 0; i < count; ++i) {
+        stage_stats_[i].name = stages_[i].name;
+        if (run.pending[i] == 0) {
+            run.ready.push_back(i);
+        }
+    }
+
+    // the calling thread runs stages too, the workers pick up whatever is ready next to it
+    {
+        std::unique_lock<std::mutex> lock(stage_mutex_);
+        run.begin = std::chrono::steady_clock::now();
+        stage_run_ = &run;
+        stage_cond_.notify_all();
+        while (run.finished < count) {
+            RunReadyStages(lock);
+            stage_cond_.wait(lock, [&]() { return run.finished == count || !run.ready.empty(); });
+        }
+        stage_run_ = nullptr;
+    }
+
+    // walk back from the last stage to finish through the dependency that finished last
+    auto end_of = [&](int i) { return stage_stats_[i].start + stage_stats_[i].time; };
+    int last = -1;
+    for (int i = 0; i < count; ++i) {
+        if (last < 0 || end_of(i) > end_of(last)) {
+            last = i;
+        }
+    }
+    while (last >= 0) {
+        stage_stats_[last].critical = true;
+        int prev = -1;
+        for (int dep : run.waits[last]) {
+            if (prev < 0 || end_of(dep) > end_of(prev)) {
+                prev = dep;
+            }
+        }
+        last = prev;
+    }
+
+    for (auto &result : run.results) {
+        if (result != TNN_OK && result != TNNERR_NO_RESULT) {
+            return result;
+        }
+    }
+    return TNN_OK;
+}
+
 /*
 * NMS, supporting hard-nms and blending-nms
 */
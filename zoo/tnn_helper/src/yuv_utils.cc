@@ -0,0 +1,114 @@
+// Tencent is pleased to support the open source community by making TNN available.
+//
+// Copyright (C) 2020 THL A29 Limited, a Tencent company. All rights reserved.
+//
+// Licensed under the BSD 3-Clause License (the "License"); you may not use this file except
+// in compliance with the License. You may obtain a copy of the License at
+//
+// https://opensource.org/licenses/BSD-3-Clause
+//
+// Unless required by applicable law or agreed to in writing, software distributed
+// under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+// CONDITIONS OF ANY KIND, either express or implied. See the License for the
+// specific language governing permissions and limitations under the License.
+
+#include "yuv_utils.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <vector>
+
+namespace TNN_NS {
+
+namespace {
+
+const int kWeightBits = 7;
+const int kWeightOne  = 1 << kWeightBits;
+// the bilinear luma carries 14 fraction bits, the colour conversion wants Y << 6 like the asm path
+const int kLumaShift = 2 * kWeightBits - 6;
+
+struct Tap {
+    int i0      = 0;
+    int i1      = 0;
+    int weight  = 0;
+    int chroma  = 0;
+    bool inside = false;
+};
+
+void BuildTaps(int src_size, int dst_size, float scale, float offset, std::vector<Tap> &taps) {
+    taps.resize(dst_size);
+    for (int d = 0; d < dst_size; ++d) {
+        float f  = (d + 0.5f) * scale + offset - 0.5f;
+        Tap &tap = taps[d];
+        tap.inside = f >= -0.5f && f <= src_size - 0.5f;
+        int s   = static_cast<int>(std::floor(f));
+        float t = f - s;
+        if (s < 0) {
+            s = 0;
+            t = 0;
+        }
+        if (s >= src_size - 1) {
+            s = src_size - 1;
+            t = 0;
+        }
+        tap.i0     = s;
+        tap.i1     = std::min(s + 1, src_size - 1);
+        tap.weight = static_cast<int>(std::lround(t * kWeightOne));
+        int n      = std::min(std::max(static_cast<int>(std::floor(f + 0.5f)), 0), src_size - 1);
+        tap.chroma = n >> 1;
+    }
+}
+
+inline uint8_t Saturate(int v) {
+    return static_cast<uint8_t>(std::min(std::max(v >> 6, 0), 255));
+}
+
+}  // namespace
+
+Status YUV420spToBGRMapped(const uint8_t *yuv, int width, int height, bool nv21, uint8_t *bgr, int dst_width,
+                           int dst_height, int dst_stride, float scale_x, float offset_x, float scale_y,
+                           float offset_y) {
+    if (!yuv || !bgr || width < 2 || height < 2 || dst_width <= 0 || dst_height <= 0 || dst_stride < dst_width * 3) {
+        return Status(TNNERR_PARAM_ERR, "yuv resample got an invalid image");
+    }
+    std::vector<Tap> xs, ys;
+    BuildTaps(width, dst_width, scale_x, offset_x, xs);
+    BuildTaps(height, dst_height, scale_y, offset_y, ys);
+
+    const uint8_t *chroma = yuv + static_cast<size_t>(width) * height;
+    const int v_index     = nv21 ? 0 : 1;
+    const int u_index     = 1 - v_index;
+    for (int y = 0; y < dst_height; ++y) {
+        const Tap &ty = ys[y];
+        uint8_t *out  = bgr + static_cast<size_t>(y) * dst_stride;
+        if (!ty.inside) {
+            memset(out, 0, dst_width * 3);
+            continue;
+        }
+        const uint8_t *r0 = yuv + static_cast<size_t>(ty.i0) * width;
+        const uint8_t *r1 = yuv + static_cast<size_t>(ty.i1) * width;
+        const uint8_t *uv = chroma + static_cast<size_t>(ty.chroma) * ((width + 1) & ~1);
+        const int wy1     = ty.weight;
+        const int wy0     = kWeightOne - wy1;
+        for (int x = 0; x < dst_width; ++x, out += 3) {
+            const Tap &tx = xs[x];
+            if (!tx.inside) {
+                out[0] = out[1] = out[2] = 0;
+                continue;
+            }
+            const int wx1 = tx.weight;
+            const int wx0 = kWeightOne - wx1;
+            int top       = r0[tx.i0] * wx0 + r0[tx.i1] * wx1;
+            int bottom    = r1[tx.i0] * wx0 + r1[tx.i1] * wx1;
+            int yy = (top * wy0 + bottom * wy1 + (1 << (kLumaShift - 1))) >> kLumaShift;
+            int v  = uv[tx.chroma * 2 + v_index] - 128;
+            int u  = uv[tx.chroma * 2 + u_index] - 128;
+            out[0] = Saturate(yy + 113 * u);
+            out[1] = Saturate(yy - 46 * v - 22 * u);
+            out[2] = Saturate(yy + 90 * v);
+        }
+    }
+    return TNN_OK;
+}
+
+}  // namespace TNN_NS